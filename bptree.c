@@ -0,0 +1,291 @@
+/*
+	bptree.c
+	B+tree which maps 64bit keys to pointers
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bptree.h"
+
+// the first index whose key is not less than 'key'
+static int lower_pos(const uint64_t* keys, int n, uint64_t key){
+	int lo = 0, hi = n, mid = 0;
+
+	while( lo < hi ){
+		mid = (lo + hi) / 2;
+		if( keys[mid] < key )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+// the first index whose key is bigger than 'key'
+static int upper_pos(const uint64_t* keys, int n, uint64_t key){
+	int lo = 0, hi = n, mid = 0;
+
+	while( lo < hi ){
+		mid = (lo + hi) / 2;
+		if( keys[mid] <= key )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static struct bpt_leaf* alloc_leaf(void){
+	struct bpt_leaf* leaf = (struct bpt_leaf*)malloc(sizeof(struct bpt_leaf));
+	if( leaf == NULL )
+		return NULL;
+
+	leaf->nkeys = 0;
+	leaf->next = NULL;
+	return leaf;
+}
+
+void bpt_init(struct bptree* ptree){
+	memset(ptree, 0, sizeof(struct bptree));
+}
+
+static void __bpt_destroy(void* node, int height){
+	int i = 0;
+	struct bpt_inner* pin = NULL;
+
+	if( height > 0 ){
+		pin = (struct bpt_inner*)node;
+		for(i=0; i<=pin->nkeys; i++)
+			__bpt_destroy(pin->child[i], height-1);
+	}
+	free(node);
+}
+
+void bpt_destroy(struct bptree* ptree){
+	if( ptree->root != NULL )
+		__bpt_destroy(ptree->root, ptree->height);
+	bpt_init(ptree);
+}
+
+static struct bpt_leaf* find_leaf(struct bptree* ptree, uint64_t key){
+	void* node = ptree->root;
+	int h = 0;
+
+	for(h=ptree->height; h>0; h--){
+		struct bpt_inner* pin = (struct bpt_inner*)node;
+		node = pin->child[upper_pos(pin->keys, pin->nkeys, key)];
+	}
+	return (struct bpt_leaf*)node;
+}
+
+void* bpt_search(struct bptree* ptree, uint64_t key){
+	struct bpt_leaf* leaf = NULL;
+	int pos = 0;
+
+	if( ptree->root == NULL )
+		return NULL;
+
+	leaf = find_leaf(ptree, key);
+	pos = lower_pos(leaf->keys, leaf->nkeys, key);
+	if( pos < leaf->nkeys && leaf->keys[pos] == key )
+		return leaf->vals[pos];
+	return NULL;
+}
+
+// insert 'key' at 'pos' of the leaf, splitting it when it is full.
+// the new right leaf is returned through 'psplit'
+static void** leaf_put(struct bpt_leaf* leaf, int pos, uint64_t key, struct bpt_leaf** psplit){
+	uint64_t keys[BPT_NODE_KEYS+1];
+	void* vals[BPT_NODE_KEYS+1];
+	struct bpt_leaf* right = NULL;
+	int n = leaf->nkeys, lcnt = 0;
+
+	*psplit = NULL;
+	if( n < BPT_NODE_KEYS ){
+		memmove(&leaf->keys[pos+1], &leaf->keys[pos], sizeof(uint64_t) * (n - pos));
+		memmove(&leaf->vals[pos+1], &leaf->vals[pos], sizeof(void*) * (n - pos));
+		leaf->keys[pos] = key;
+		leaf->vals[pos] = NULL;
+		leaf->nkeys++;
+		return &leaf->vals[pos];
+	}
+
+	right = alloc_leaf();
+	if( right == NULL )
+		return NULL;
+
+	memcpy(keys, leaf->keys, sizeof(uint64_t) * pos);
+	memcpy(vals, leaf->vals, sizeof(void*) * pos);
+	keys[pos] = key;
+	vals[pos] = NULL;
+	memcpy(&keys[pos+1], &leaf->keys[pos], sizeof(uint64_t) * (n - pos));
+	memcpy(&vals[pos+1], &leaf->vals[pos], sizeof(void*) * (n - pos));
+
+	//left keeps the first half
+	lcnt = (n + 1) / 2;
+	leaf->nkeys = lcnt;
+	memcpy(leaf->keys, keys, sizeof(uint64_t) * lcnt);
+	memcpy(leaf->vals, vals, sizeof(void*) * lcnt);
+
+	right->nkeys = n + 1 - lcnt;
+	memcpy(right->keys, &keys[lcnt], sizeof(uint64_t) * right->nkeys);
+	memcpy(right->vals, &vals[lcnt], sizeof(void*) * right->nkeys);
+
+	right->next = leaf->next;
+	leaf->next = right;
+	*psplit = right;
+
+	if( pos < lcnt )
+		return &leaf->vals[pos];
+	return &right->vals[pos-lcnt];
+}
+
+// insert ('key', 'child') at 'pos' of the inner node, splitting it when it is full.
+// the new right node and the key pushed up are returned through 'psplit', 'psplit_key'
+static int inner_put(struct bpt_inner* pin, int pos, uint64_t key, void* child,
+			struct bpt_inner** psplit, uint64_t* psplit_key){
+	uint64_t keys[BPT_NODE_KEYS+1];
+	void* childs[BPT_NODE_KEYS+2];
+	struct bpt_inner* right = NULL;
+	int n = pin->nkeys, lcnt = 0;
+
+	*psplit = NULL;
+	if( n < BPT_NODE_KEYS ){
+		memmove(&pin->keys[pos+1], &pin->keys[pos], sizeof(uint64_t) * (n - pos));
+		memmove(&pin->child[pos+2], &pin->child[pos+1], sizeof(void*) * (n - pos));
+		pin->keys[pos] = key;
+		pin->child[pos+1] = child;
+		pin->nkeys++;
+		return 0;
+	}
+
+	right = (struct bpt_inner*)malloc(sizeof(struct bpt_inner));
+	if( right == NULL )
+		return -1;
+
+	memcpy(keys, pin->keys, sizeof(uint64_t) * pos);
+	keys[pos] = key;
+	memcpy(&keys[pos+1], &pin->keys[pos], sizeof(uint64_t) * (n - pos));
+	memcpy(childs, pin->child, sizeof(void*) * (pos + 1));
+	childs[pos+1] = child;
+	memcpy(&childs[pos+2], &pin->child[pos+1], sizeof(void*) * (n - pos));
+
+	//keys[lcnt] goes up, the others are shared by left and right
+	lcnt = (n + 1) / 2;
+	pin->nkeys = lcnt;
+	memcpy(pin->keys, keys, sizeof(uint64_t) * lcnt);
+	memcpy(pin->child, childs, sizeof(void*) * (lcnt + 1));
+
+	right->nkeys = n - lcnt;
+	memcpy(right->keys, &keys[lcnt+1], sizeof(uint64_t) * right->nkeys);
+	memcpy(right->child, &childs[lcnt+1], sizeof(void*) * (right->nkeys + 1));
+
+	*psplit = right;
+	*psplit_key = keys[lcnt];
+	return 0;
+}
+
+static void** __bpt_insert(struct bptree* ptree, void* node, int height, uint64_t key,
+				void** psplit, uint64_t* psplit_key){
+	void** slot = NULL;
+	void* csplit = NULL;
+	uint64_t ckey = 0;
+	int pos = 0;
+
+	*psplit = NULL;
+	if( height == 0 ){
+		struct bpt_leaf* leaf = (struct bpt_leaf*)node;
+		struct bpt_leaf* right = NULL;
+
+		pos = lower_pos(leaf->keys, leaf->nkeys, key);
+		if( pos < leaf->nkeys && leaf->keys[pos] == key )
+			return &leaf->vals[pos];
+
+		slot = leaf_put(leaf, pos, key, &right);
+		if( slot == NULL )
+			return NULL;
+
+		ptree->cnt++;
+		if( right != NULL ){
+			*psplit = right;
+			*psplit_key = right->keys[0];
+		}
+		return slot;
+	}
+
+	struct bpt_inner* pin = (struct bpt_inner*)node;
+	struct bpt_inner* right = NULL;
+
+	pos = upper_pos(pin->keys, pin->nkeys, key);
+	slot = __bpt_insert(ptree, pin->child[pos], height-1, key, &csplit, &ckey);
+	if( slot == NULL || csplit == NULL )
+		return slot;
+
+	if( inner_put(pin, pos, ckey, csplit, &right, psplit_key) < 0 )
+		return NULL;
+	*psplit = right;
+	return slot;
+}
+
+void** bpt_insert(struct bptree* ptree, uint64_t key){
+	struct bpt_inner* newroot = NULL;
+	void* split = NULL;
+	uint64_t split_key = 0;
+	void** slot = NULL;
+	int rootkeys = 0;
+
+	if( ptree->root == NULL ){
+		ptree->first = alloc_leaf();
+		if( ptree->first == NULL )
+			return NULL;
+		ptree->root = ptree->first;
+		ptree->height = 0;
+	}
+
+	//only a full root can be split, so get the new root in advance
+	if( ptree->height == 0 )
+		rootkeys = ((struct bpt_leaf*)ptree->root)->nkeys;
+	else
+		rootkeys = ((struct bpt_inner*)ptree->root)->nkeys;
+	if( rootkeys == BPT_NODE_KEYS ){
+		newroot = (struct bpt_inner*)malloc(sizeof(struct bpt_inner));
+		if( newroot == NULL )
+			return NULL;
+	}
+
+	slot = __bpt_insert(ptree, ptree->root, ptree->height, key, &split, &split_key);
+	if( split == NULL ){
+		free(newroot);
+		return slot;
+	}
+
+	newroot->nkeys = 1;
+	newroot->keys[0] = split_key;
+	newroot->child[0] = ptree->root;
+	newroot->child[1] = split;
+	ptree->root = newroot;
+	ptree->height++;
+	return slot;
+}
+
+void bpt_first(struct bptree* ptree, struct bpt_iter* pitr){
+	pitr->leaf = ptree->first;
+	pitr->idx = 0;
+	if( pitr->leaf != NULL && pitr->leaf->nkeys == 0 )
+		pitr->leaf = NULL;
+}
+
+void bpt_lower_bound(struct bptree* ptree, uint64_t key, struct bpt_iter* pitr){
+	pitr->leaf = NULL;
+	pitr->idx = 0;
+	if( ptree->root == NULL )
+		return;
+
+	pitr->leaf = find_leaf(ptree, key);
+	pitr->idx = lower_pos(pitr->leaf->keys, pitr->leaf->nkeys, key);
+	if( pitr->idx >= pitr->leaf->nkeys ){
+		pitr->leaf = pitr->leaf->next;
+		pitr->idx = 0;
+	}
+}
@@ -0,0 +1,81 @@
+/*
+	bptree.h
+	B+tree which maps 64bit keys to pointers
+
+	Nodes are wide and leaves are linked in key order, so a traversal
+	or a range scan reads leaves one after another instead of chasing
+	a pointer per key like rbtree does.
+	There is no deletion. The tree only grows until it is destroyed.
+*/
+
+#ifndef BPTREE_H
+#define BPTREE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BPT_NODE_KEYS	64	//max keys in a node
+
+struct bpt_leaf{
+	int nkeys;
+	uint64_t keys[BPT_NODE_KEYS];
+	void* vals[BPT_NODE_KEYS];
+	struct bpt_leaf* next;	//leaf of next bigger keys
+};
+
+struct bpt_inner{
+	int nkeys;
+	uint64_t keys[BPT_NODE_KEYS];	//keys[i] is the smallest key of child[i+1]
+	void* child[BPT_NODE_KEYS+1];
+};
+
+struct bptree{
+	void* root;	//leaf if height is 0, else inner
+	int height;
+	struct bpt_leaf* first;
+	size_t cnt;	//number of keys
+};
+
+// iterator of the linked leaves
+struct bpt_iter{
+	struct bpt_leaf* leaf;
+	int idx;
+};
+
+void bpt_init(struct bptree* ptree);
+void bpt_destroy(struct bptree* ptree);
+
+// return the value of 'key' or NULL if there isn't
+void* bpt_search(struct bptree* ptree, uint64_t key);
+
+// return the value slot of 'key'.
+// if 'key' is new, it is inserted and its slot is NULL for the caller to fill.
+// NULL is returned only when memory allocation is failed
+void** bpt_insert(struct bptree* ptree, uint64_t key);
+
+// set iterator at the first key, or at the first key which is not less than 'key'
+void bpt_first(struct bptree* ptree, struct bpt_iter* pitr);
+void bpt_lower_bound(struct bptree* ptree, uint64_t key, struct bpt_iter* pitr);
+
+static inline int bpt_iter_valid(struct bpt_iter* pitr){
+	return pitr->leaf != NULL;
+}
+
+static inline uint64_t bpt_iter_key(struct bpt_iter* pitr){
+	return pitr->leaf->keys[pitr->idx];
+}
+
+static inline void* bpt_iter_val(struct bpt_iter* pitr){
+	return pitr->leaf->vals[pitr->idx];
+}
+
+static inline void bpt_iter_next(struct bpt_iter* pitr){
+	if( ++pitr->idx < pitr->leaf->nkeys )
+		return;
+
+	//leaves are never empty, except a root leaf of empty tree
+	pitr->leaf = pitr->leaf->next;
+	pitr->idx = 0;
+}
+
+#endif
@@ -0,0 +1,269 @@
+/*
+	dio_cache.c
+	cache simulation over a stream of block references
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dio_cache.h"
+#include "dio_sketch.h"
+
+#define NO_POS	((size_t)(-1))
+
+bool shards_sampled(uint64_t block, double rate){
+	return (sketch_hash(block) % SHARDS_MODULUS) < (uint64_t)(rate * SHARDS_MODULUS);
+}
+
+// the blocks are renamed through an open addressing table of twice the references
+bool cache_trace_init(struct cache_trace* pct, const uint64_t* blocks, const uint8_t* reads, size_t cnt){
+	size_t slot_cnt = 16, s = 0, i = 0;
+	uint32_t* slots = NULL;
+
+	memset(pct, 0, sizeof(struct cache_trace));
+	while( slot_cnt < cnt * 2 )
+		slot_cnt *= 2;
+	slots = (uint32_t*)malloc(sizeof(uint32_t) * slot_cnt);
+	pct->ids = (uint32_t*)malloc(sizeof(uint32_t) * (cnt + 1));
+	pct->reads = (uint8_t*)malloc(cnt + 1);
+	if( slots == NULL || pct->ids == NULL || pct->reads == NULL ){
+		free(slots);
+		cache_trace_free(pct);
+		return false;
+	}
+
+	//a slot has the index of the first reference of its block, plus 1
+	memset(slots, 0, sizeof(uint32_t) * slot_cnt);
+	for(i=0; i<cnt; i++){
+		s = sketch_hash(blocks[i]) & (slot_cnt - 1);
+		while( slots[s] != 0 && blocks[slots[s] - 1] != blocks[i] )
+			s = (s + 1) & (slot_cnt - 1);
+		if( slots[s] == 0 ){
+			slots[s] = i + 1;
+			pct->ids[i] = pct->block_cnt++;
+		}
+		else
+			pct->ids[i] = pct->ids[slots[s] - 1];
+	}
+	memcpy(pct->reads, reads, cnt);
+	pct->cnt = cnt;
+	free(slots);
+	return true;
+}
+
+void cache_trace_free(struct cache_trace* pct){
+	free(pct->ids);
+	free(pct->reads);
+	memset(pct, 0, sizeof(struct cache_trace));
+}
+
+//------------------- lru ------------------------------//
+// a fenwick tree marks the positions which are the last reference of
+// their block, so the distinct blocks between two positions are a sum
+static void fenwick_add(int32_t* tree, size_t n, size_t pos, int32_t v){
+	for(pos++; pos <= n; pos += pos & (-pos))
+		tree[pos] += v;
+}
+
+// marks in [0, pos)
+static uint64_t fenwick_sum(const int32_t* tree, size_t pos){
+	uint64_t sum = 0;
+
+	for(; pos > 0; pos -= pos & (-pos))
+		sum += tree[pos];
+	return sum;
+}
+
+bool cache_lru_misses(const struct cache_trace* pct, const uint64_t* sizes, int size_cnt,
+		uint64_t* misses, uint64_t* read_misses){
+	int32_t* tree = (int32_t*)calloc(pct->cnt + 1, sizeof(int32_t));
+	size_t* last = (size_t*)malloc(sizeof(size_t) * (pct->block_cnt + 1));
+	uint64_t* hist = (uint64_t*)calloc((size_cnt + 1) * 2, sizeof(uint64_t));
+	uint64_t dist = 0;
+	size_t i = 0;
+	int lo = 0, hi = 0, mid = 0;
+
+	if( tree == NULL || last == NULL || hist == NULL ){
+		free(tree);
+		free(last);
+		free(hist);
+		return false;
+	}
+	for(i=0; i<pct->block_cnt; i++)
+		last[i] = NO_POS;
+
+	//hist[k] counts the references which miss the caches smaller than sizes[k]
+	for(i=0; i<pct->cnt; i++){
+		lo = size_cnt;
+		if( last[pct->ids[i]] != NO_POS ){
+			dist = fenwick_sum(tree, i) - fenwick_sum(tree, last[pct->ids[i]] + 1);
+			fenwick_add(tree, pct->cnt, last[pct->ids[i]], -1);
+
+			//the number of sizes which are not over the distance
+			lo = 0;
+			hi = size_cnt;
+			while( lo < hi ){
+				mid = (lo + hi) / 2;
+				if( sizes[mid] <= dist )
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+		}
+		fenwick_add(tree, pct->cnt, i, 1);
+		last[pct->ids[i]] = i;
+		hist[lo * 2 + pct->reads[i]]++;
+	}
+
+	for(lo=size_cnt-1; lo>=0; lo--){
+		misses[lo] = hist[(lo + 1) * 2] + hist[(lo + 1) * 2 + 1];
+		read_misses[lo] = hist[(lo + 1) * 2 + 1];
+		if( lo + 1 < size_cnt ){
+			misses[lo] += misses[lo + 1];
+			read_misses[lo] += read_misses[lo + 1];
+		}
+	}
+
+	free(tree);
+	free(last);
+	free(hist);
+	return true;
+}
+
+//------------------- arc ------------------------------//
+// lists of ARC (Megiddo and Modha). T1 and T2 are in the cache, B1 and B2
+// remember the blocks evicted from them. heads are the most recent
+enum { ARC_NONE, ARC_T1, ARC_T2, ARC_B1, ARC_B2, ARC_LIST_CNT };
+
+struct arc_list{
+	uint32_t head;
+	uint32_t tail;
+	uint64_t len;
+};
+
+struct arc_cache{
+	struct arc_list lists[ARC_LIST_CNT];
+	uint32_t* prev;
+	uint32_t* next;
+	uint8_t* where;
+	uint64_t size;
+	double p;		//target size of T1
+};
+
+#define ARC_NIL	((uint32_t)(-1))
+
+static void arc_unlink(struct arc_cache* pac, uint32_t id){
+	struct arc_list* pl = &pac->lists[pac->where[id]];
+
+	if( pac->prev[id] != ARC_NIL )
+		pac->next[pac->prev[id]] = pac->next[id];
+	else
+		pl->head = pac->next[id];
+	if( pac->next[id] != ARC_NIL )
+		pac->prev[pac->next[id]] = pac->prev[id];
+	else
+		pl->tail = pac->prev[id];
+	pl->len--;
+	pac->where[id] = ARC_NONE;
+}
+
+static void arc_push(struct arc_cache* pac, uint32_t id, int list){
+	struct arc_list* pl = &pac->lists[list];
+
+	if( pac->where[id] != ARC_NONE )
+		arc_unlink(pac, id);
+	pac->prev[id] = ARC_NIL;
+	pac->next[id] = pl->head;
+	if( pl->head != ARC_NIL )
+		pac->prev[pl->head] = id;
+	else
+		pl->tail = id;
+	pl->head = id;
+	pl->len++;
+	pac->where[id] = list;
+}
+
+// the least recent block of T1 or T2 goes to B1 or B2
+static void arc_replace(struct arc_cache* pac, bool in_b2){
+	uint64_t t1 = pac->lists[ARC_T1].len;
+
+	if( t1 > 0 && ((in_b2 && t1 == (uint64_t)pac->p) || t1 > pac->p || pac->lists[ARC_T2].len == 0) )
+		arc_push(pac, pac->lists[ARC_T1].tail, ARC_B1);
+	else
+		arc_push(pac, pac->lists[ARC_T2].tail, ARC_B2);
+}
+
+static bool arc_access(struct arc_cache* pac, uint32_t id){
+	struct arc_list* pls = pac->lists;
+	double delta = 0;
+	uint64_t c = pac->size;
+
+	switch( pac->where[id] ){
+	case ARC_T1:
+	case ARC_T2:
+		arc_push(pac, id, ARC_T2);
+		return true;
+	case ARC_B1:
+		delta = pls[ARC_B2].len > pls[ARC_B1].len ? (double)pls[ARC_B2].len / pls[ARC_B1].len : 1;
+		pac->p = pac->p + delta > c ? c : pac->p + delta;
+		arc_replace(pac, false);
+		arc_push(pac, id, ARC_T2);
+		return false;
+	case ARC_B2:
+		delta = pls[ARC_B1].len > pls[ARC_B2].len ? (double)pls[ARC_B1].len / pls[ARC_B2].len : 1;
+		pac->p = pac->p - delta < 0 ? 0 : pac->p - delta;
+		arc_replace(pac, true);
+		arc_push(pac, id, ARC_T2);
+		return false;
+	}
+
+	//a block which is not remembered
+	if( pls[ARC_T1].len + pls[ARC_B1].len == c ){
+		if( pls[ARC_T1].len < c ){
+			arc_unlink(pac, pls[ARC_B1].tail);
+			arc_replace(pac, false);
+		}
+		else
+			arc_unlink(pac, pls[ARC_T1].tail);
+	}
+	else if( pls[ARC_T1].len + pls[ARC_T2].len + pls[ARC_B1].len + pls[ARC_B2].len >= c ){
+		if( pls[ARC_T1].len + pls[ARC_T2].len + pls[ARC_B1].len + pls[ARC_B2].len == 2 * c )
+			arc_unlink(pac, pls[ARC_B2].tail);
+		arc_replace(pac, false);
+	}
+	arc_push(pac, id, ARC_T1);
+	return false;
+}
+
+bool cache_arc_misses(const struct cache_trace* pct, uint64_t size, uint64_t* misses, uint64_t* read_misses){
+	struct arc_cache ac;
+	size_t i = 0;
+	int l = 0;
+
+	memset(&ac, 0, sizeof(ac));
+	ac.size = size;
+	ac.prev = (uint32_t*)malloc(sizeof(uint32_t) * (pct->block_cnt + 1));
+	ac.next = (uint32_t*)malloc(sizeof(uint32_t) * (pct->block_cnt + 1));
+	ac.where = (uint8_t*)calloc(pct->block_cnt + 1, 1);
+	if( ac.prev == NULL || ac.next == NULL || ac.where == NULL ){
+		free(ac.prev);
+		free(ac.next);
+		free(ac.where);
+		return false;
+	}
+	for(l=0; l<ARC_LIST_CNT; l++)
+		ac.lists[l].head = ac.lists[l].tail = ARC_NIL;
+
+	*misses = *read_misses = 0;
+	for(i=0; i<pct->cnt; i++){
+		if( arc_access(&ac, pct->ids[i]) )
+			continue;
+		(*misses)++;
+		*read_misses += pct->reads[i];
+	}
+
+	free(ac.prev);
+	free(ac.next);
+	free(ac.where);
+	return true;
+}
@@ -0,0 +1,45 @@
+/*
+	dio_cache.h
+	cache simulation over a stream of block references
+
+	LRU caches of all sizes are simulated in one pass by the reuse
+	distance of each reference, the number of distinct blocks since the
+	last reference of the same block: the reference hits a cache of c
+	blocks if the distance is less than c. ARC has no such stack
+	property, so a cache of each size is simulated on its own.
+	With SHARDS, only the blocks whose hash is under a threshold are
+	referenced, and a cache of c blocks is simulated as c * rate blocks
+	of the sample, so the cost shrinks with the rate.
+*/
+
+#ifndef DIO_CACHE_H
+#define DIO_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define SHARDS_MODULUS	(1 << 24)
+
+// references with the blocks renamed to 0, 1, 2, ... in order of their first reference
+struct cache_trace{
+	uint32_t* ids;
+	uint8_t* reads;		//1 for a read, 0 for a write
+	size_t cnt;
+	size_t block_cnt;
+};
+
+// a block is in the sample of 'rate' if its hash is under the threshold
+bool shards_sampled(uint64_t block, double rate);
+
+bool cache_trace_init(struct cache_trace* pct, const uint64_t* blocks, const uint8_t* reads, size_t cnt);
+void cache_trace_free(struct cache_trace* pct);
+
+// misses of LRU caches of 'sizes' blocks in ascending order
+bool cache_lru_misses(const struct cache_trace* pct, const uint64_t* sizes, int size_cnt,
+		uint64_t* misses, uint64_t* read_misses);
+
+// misses of an ARC cache of 'size' blocks
+bool cache_arc_misses(const struct cache_trace* pct, uint64_t size, uint64_t* misses, uint64_t* read_misses);
+
+#endif
@@ -0,0 +1,252 @@
+/*
+	dio_chart.c
+	standalone SVG charts of the statistics
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "dio_chart.h"
+
+#define CHART_WIDTH	960
+#define CHART_HEIGHT	540
+#define PLOT_LEFT	90
+#define PLOT_RIGHT	(CHART_WIDTH - 170)
+#define PLOT_TOP	50
+#define PLOT_BOTTOM	(CHART_HEIGHT - 100)
+#define PLOT_W		(PLOT_RIGHT - PLOT_LEFT)
+#define PLOT_H		(PLOT_BOTTOM - PLOT_TOP)
+#define MAX_XLABELS	60	//labels of categories shown at most
+#define AXIS_TICKS	5
+
+static void put_text(FILE* fp, const char* s){
+	for(; *s; s++){
+		if( *s == '<' )
+			fputs("&lt;", fp);
+		else if( *s == '>' )
+			fputs("&gt;", fp);
+		else if( *s == '&' )
+			fputs("&amp;", fp);
+		else
+			fputc(*s, fp);
+	}
+}
+
+static FILE* open_svg(const char* path, const char* title, const char* xlabel, const char* ylabel){
+	FILE* fp = fopen(path, "w");
+
+	if( fp == NULL )
+		return NULL;
+
+	fprintf(fp, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\" "
+		"font-family=\"sans-serif\" font-size=\"12\">\n", CHART_WIDTH, CHART_HEIGHT, CHART_WIDTH, CHART_HEIGHT);
+	fprintf(fp, "<rect width=\"100%%\" height=\"100%%\" fill=\"white\"/>\n");
+	fprintf(fp, "<text x=\"%d\" y=\"28\" text-anchor=\"middle\" font-size=\"16\">", CHART_WIDTH / 2);
+	put_text(fp, title);
+	fprintf(fp, "</text>\n");
+
+	fprintf(fp, "<text x=\"%d\" y=\"%d\" text-anchor=\"middle\">", PLOT_LEFT + PLOT_W / 2, CHART_HEIGHT - 12);
+	put_text(fp, xlabel);
+	fprintf(fp, "</text>\n");
+	fprintf(fp, "<text x=\"18\" y=\"%d\" text-anchor=\"middle\" transform=\"rotate(-90 18 %d)\">",
+		PLOT_TOP + PLOT_H / 2, PLOT_TOP + PLOT_H / 2);
+	put_text(fp, ylabel);
+	fprintf(fp, "</text>\n");
+	return fp;
+}
+
+static bool close_svg(FILE* fp){
+	bool ok = false;
+
+	fprintf(fp, "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" fill=\"none\" stroke=\"black\"/>\n",
+		PLOT_LEFT, PLOT_TOP, PLOT_W, PLOT_H);
+	fprintf(fp, "</svg>\n");
+	ok = !ferror(fp);
+	if( fclose(fp) != 0 )
+		ok = false;
+	return ok;
+}
+
+// 1, 2 or 5 times a power of 10 which is not less than 'v'
+static double nice_ceil(double v){
+	double p = 0;
+
+	if( !(v > 0) )
+		return 1;
+	p = pow(10, floor(log10(v)));
+	if( v <= p )
+		return p;
+	if( v <= 2 * p )
+		return 2 * p;
+	if( v <= 5 * p )
+		return 5 * p;
+	return 10 * p;
+}
+
+static void draw_yaxis(FILE* fp, double ymax){
+	double y = 0;
+	int i = 0;
+
+	for(i=0; i<=AXIS_TICKS; i++){
+		y = PLOT_BOTTOM - (double)PLOT_H * i / AXIS_TICKS;
+		fprintf(fp, "<line x1=\"%d\" y1=\"%.1f\" x2=\"%d\" y2=\"%.1f\" stroke=\"#ddd\"/>\n",
+			PLOT_LEFT, y, PLOT_RIGHT, y);
+		fprintf(fp, "<text x=\"%d\" y=\"%.1f\" text-anchor=\"end\">%g</text>\n",
+			PLOT_LEFT - 6, y + 4, ymax * i / AXIS_TICKS);
+	}
+}
+
+static void draw_xticks(FILE* fp, double xmin, double xmax){
+	double x = 0;
+	int i = 0;
+
+	for(i=0; i<=AXIS_TICKS; i++){
+		x = PLOT_LEFT + (double)PLOT_W * i / AXIS_TICKS;
+		fprintf(fp, "<text x=\"%.1f\" y=\"%d\" text-anchor=\"middle\">%g</text>\n",
+			x, PLOT_BOTTOM + 18, xmin + (xmax - xmin) * i / AXIS_TICKS);
+	}
+}
+
+static void draw_legend(FILE* fp, const struct chart_series* series, int series_cnt){
+	int i = 0;
+
+	for(i=0; i<series_cnt; i++){
+		fprintf(fp, "<rect x=\"%d\" y=\"%d\" width=\"12\" height=\"12\" fill=\"%s\"/>\n",
+			PLOT_RIGHT + 16, PLOT_TOP + i * 20, series[i].color);
+		fprintf(fp, "<text x=\"%d\" y=\"%d\">", PLOT_RIGHT + 34, PLOT_TOP + i * 20 + 11);
+		put_text(fp, series[i].name);
+		fprintf(fp, "</text>\n");
+	}
+}
+
+bool chart_bars(const char* path, const char* title, const char* xlabel, const char* ylabel,
+		const char* const* labels, size_t n, const struct chart_series* series, int series_cnt){
+	FILE* fp = NULL;
+	double ymax = 0, sum = 0, bw = 0, x = 0, y = 0, h = 0;
+	size_t i = 0, step = 0;
+	int s = 0;
+
+	fp = open_svg(path, title, xlabel, ylabel);
+	if( fp == NULL )
+		return false;
+
+	for(i=0; i<n; i++){
+		sum = 0;
+		for(s=0; s<series_cnt; s++)
+			sum += series[s].vals[i];
+		if( sum > ymax )
+			ymax = sum;
+	}
+	ymax = nice_ceil(ymax);
+	draw_yaxis(fp, ymax);
+
+	bw = n > 0 ? (double)PLOT_W / n : 0;
+	step = (n + MAX_XLABELS - 1) / MAX_XLABELS;
+	for(i=0; i<n; i++){
+		x = PLOT_LEFT + bw * i + bw * 0.125;
+		y = PLOT_BOTTOM;
+		for(s=0; s<series_cnt; s++){
+			h = series[s].vals[i] / ymax * PLOT_H;
+			y -= h;
+			fprintf(fp, "<rect x=\"%.2f\" y=\"%.2f\" width=\"%.2f\" height=\"%.2f\" fill=\"%s\"><title>",
+				x, y, bw * 0.75, h, series[s].color);
+			put_text(fp, labels[i]);
+			fprintf(fp, " %s: %g</title></rect>\n", series[s].name, series[s].vals[i]);
+		}
+
+		//too many labels are thinned out
+		if( i % step == 0 ){
+			x = PLOT_LEFT + bw * (i + 0.5);
+			fprintf(fp, "<text x=\"%.1f\" y=\"%d\" font-size=\"9\" text-anchor=\"end\" "
+				"transform=\"rotate(-45 %.1f %d)\">", x, PLOT_BOTTOM + 12, x, PLOT_BOTTOM + 12);
+			put_text(fp, labels[i]);
+			fprintf(fp, "</text>\n");
+		}
+	}
+
+	draw_legend(fp, series, series_cnt);
+	return close_svg(fp);
+}
+
+bool chart_lines(const char* path, const char* title, const char* xlabel, const char* ylabel,
+		const double* x, size_t n, const struct chart_series* series, int series_cnt){
+	FILE* fp = NULL;
+	double xmin = 0, xmax = 0, ymax = 0;
+	size_t i = 0;
+	int s = 0;
+
+	fp = open_svg(path, title, xlabel, ylabel);
+	if( fp == NULL )
+		return false;
+
+	if( n > 0 ){
+		xmin = x[0];
+		xmax = x[n-1];
+	}
+	if( xmax <= xmin )
+		xmax = xmin + 1;
+	for(s=0; s<series_cnt; s++){
+		for(i=0; i<n; i++){
+			if( series[s].vals[i] > ymax )
+				ymax = series[s].vals[i];
+		}
+	}
+	ymax = nice_ceil(ymax);
+	draw_yaxis(fp, ymax);
+	draw_xticks(fp, xmin, xmax);
+
+	for(s=0; s<series_cnt; s++){
+		fprintf(fp, "<polyline fill=\"none\" stroke=\"%s\" stroke-width=\"1.5\" points=\"", series[s].color);
+		for(i=0; i<n; i++){
+			fprintf(fp, "%.2f,%.2f ", PLOT_LEFT + (x[i] - xmin) / (xmax - xmin) * PLOT_W,
+				PLOT_BOTTOM - series[s].vals[i] / ymax * PLOT_H);
+		}
+		fprintf(fp, "\"/>\n");
+	}
+
+	draw_legend(fp, series, series_cnt);
+	return close_svg(fp);
+}
+
+bool chart_heatmap(const char* path, const char* title, const char* xlabel, const char* ylabel,
+		const double* cells, size_t cols, size_t rows, double x0, double xstep,
+		const char* const* row_labels){
+	FILE* fp = NULL;
+	double cmax = 0, cw = 0, ch = 0, t = 0;
+	size_t c = 0, r = 0;
+
+	fp = open_svg(path, title, xlabel, ylabel);
+	if( fp == NULL )
+		return false;
+
+	for(c=0; c<cols*rows; c++){
+		if( cells[c] > cmax )
+			cmax = cells[c];
+	}
+	cw = cols > 0 ? (double)PLOT_W / cols : 0;
+	ch = rows > 0 ? (double)PLOT_H / rows : 0;
+
+	//counts are shaded in log scale from white to dark blue
+	for(c=0; c<cols; c++){
+		for(r=0; r<rows; r++){
+			if( cells[c * rows + r] <= 0 )
+				continue;
+			t = log1p(cells[c * rows + r]) / log1p(cmax);
+			fprintf(fp, "<rect x=\"%.2f\" y=\"%.2f\" width=\"%.2f\" height=\"%.2f\" fill=\"rgb(%d,%d,%d)\">"
+				"<title>%g</title></rect>\n",
+				PLOT_LEFT + cw * c, PLOT_BOTTOM - ch * (r + 1), cw + 0.05, ch + 0.05,
+				(int)(255 - t * 247), (int)(255 - t * 207), (int)(255 - t * 148), cells[c * rows + r]);
+		}
+	}
+
+	for(r=0; r<rows; r++){
+		fprintf(fp, "<text x=\"%d\" y=\"%.1f\" font-size=\"9\" text-anchor=\"end\">", PLOT_LEFT - 6,
+			PLOT_BOTTOM - ch * r - ch / 2 + 3);
+		put_text(fp, row_labels[r]);
+		fprintf(fp, "</text>\n");
+	}
+	draw_xticks(fp, x0, x0 + xstep * cols);
+	return close_svg(fp);
+}
@@ -0,0 +1,37 @@
+/*
+	dio_chart.h
+	standalone SVG charts of the statistics
+
+	Charts are written as SVG files which any browser opens, so a
+	graphical report needs no plotting program and works without
+	a display.
+*/
+
+#ifndef DIO_CHART_H
+#define DIO_CHART_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// a series of values, one for each category or point
+struct chart_series{
+	const char* name;
+	const char* color;
+	const double* vals;
+};
+
+// stacked bars of the series for 'n' categories
+bool chart_bars(const char* path, const char* title, const char* xlabel, const char* ylabel,
+		const char* const* labels, size_t n, const struct chart_series* series, int series_cnt);
+
+// lines of the series over 'x' of 'n' points
+bool chart_lines(const char* path, const char* title, const char* xlabel, const char* ylabel,
+		const double* x, size_t n, const struct chart_series* series, int series_cnt);
+
+// 'cols' x 'rows' cells of counts. cells[col * rows + row], row 0 at the bottom.
+// column i is at x0 + i * xstep and the rows are named by 'row_labels'
+bool chart_heatmap(const char* path, const char* title, const char* xlabel, const char* ylabel,
+		const double* cells, size_t cols, size_t rows, double x0, double xstep,
+		const char* const* row_labels);
+
+#endif
@@ -0,0 +1,141 @@
+/*
+	dio_column.c
+	columnar trace file converted from the raw result of dio-shark
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dio_column.h"
+
+static inline uint64_t zigzag(int64_t v){
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v){
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline size_t put_varint(uint8_t* p, uint64_t v){
+	size_t n = 0;
+
+	while( v >= 0x80 ){
+		p[n++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	p[n++] = (uint8_t)v;
+	return n;
+}
+
+static inline uint64_t field_of(struct blk_io_trace* pbit, int col){
+	switch( col ){
+	case COL_TIME:		return pbit->time;
+	case COL_SECTOR:	return pbit->sector;
+	case COL_BYTES:		return pbit->bytes;
+	case COL_ACTION:	return pbit->action;
+	case COL_PID:		return pbit->pid;
+	case COL_DEVICE:	return pbit->device;
+	case COL_CPU:		return pbit->cpu;
+	default:		return pbit->error;
+	}
+}
+
+bool col_writer_open(struct col_writer* pwr, const char* path){
+	memset(pwr, 0, sizeof(struct col_writer));
+	pwr->rows = (struct blk_io_trace*)malloc(sizeof(struct blk_io_trace) * COL_GROUP_ROWS);
+	pwr->buf = (uint8_t*)malloc(COL_MAX_VARINT * COL_GROUP_ROWS * COL_CNT);
+	pwr->fp = fopen(path, "wb");
+	if( pwr->rows == NULL || pwr->buf == NULL || pwr->fp == NULL ||
+		fwrite(DIO_COLUMN_MAGIC, 8, 1, pwr->fp) != 1 ){
+		if( pwr->fp != NULL )
+			fclose(pwr->fp);
+		free(pwr->rows);
+		free(pwr->buf);
+		return false;
+	}
+	pwr->off = 8;
+	return true;
+}
+
+static bool flush_group(struct col_writer* pwr){
+	struct col_group_header hdr;
+	uint64_t prev = 0, v = 0;
+	size_t len = 0, start = 0, i = 0;
+	int col = 0;
+
+	if( pwr->cnt == 0 )
+		return true;
+
+	memset(&hdr, 0, sizeof(hdr));
+	zone_init(&hdr.zone, pwr->off + sizeof(hdr), 0);
+	for(i=0; i<pwr->cnt; i++)
+		zone_add(&hdr.zone, &pwr->rows[i]);
+
+	//each column is the deltas from the previous row
+	for(col=0; col<COL_CNT; col++){
+		start = len;
+		prev = 0;
+		for(i=0; i<pwr->cnt; i++){
+			v = field_of(&pwr->rows[i], col);
+			len += put_varint(pwr->buf + len, zigzag((int64_t)(v - prev)));
+			prev = v;
+		}
+		hdr.col_len[col] = len - start;
+	}
+	hdr.zone.len = len;
+
+	if( fwrite(&hdr, sizeof(hdr), 1, pwr->fp) != 1 || fwrite(pwr->buf, 1, len, pwr->fp) != len )
+		return false;
+	pwr->off += sizeof(hdr) + len;
+	pwr->cnt = 0;
+	return true;
+}
+
+bool col_writer_add(struct col_writer* pwr, struct blk_io_trace* pbit){
+	pwr->rows[pwr->cnt++] = *pbit;
+	if( pwr->cnt == COL_GROUP_ROWS )
+		return flush_group(pwr);
+	return true;
+}
+
+bool col_writer_close(struct col_writer* pwr){
+	bool ok = flush_group(pwr);
+
+	if( fclose(pwr->fp) != 0 )
+		ok = false;
+	free(pwr->rows);
+	free(pwr->buf);
+	return ok;
+}
+
+size_t col_offset(struct col_group_header* phdr, int col){
+	size_t off = 0;
+	int i = 0;
+
+	for(i=0; i<col; i++)
+		off += phdr->col_len[i];
+	return off;
+}
+
+bool col_decode(struct col_group_header* phdr, const uint8_t* body, int col, uint64_t* vals){
+	const uint8_t* p = body + col_offset(phdr, col);
+	const uint8_t* end = p + phdr->col_len[col];
+	uint64_t prev = 0, v = 0;
+	size_t i = 0;
+	int shift = 0;
+
+	for(i=0; i<phdr->zone.cnt; i++){
+		v = 0;
+		shift = 0;
+		do{
+			if( p == end || shift > 63 )
+				return false;
+			v |= (uint64_t)(*p & 0x7f) << shift;
+			shift += 7;
+		}while( *p++ & 0x80 );
+
+		prev += (uint64_t)unzigzag(v);
+		vals[i] = prev;
+	}
+	return p == end;
+}
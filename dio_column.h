@@ -0,0 +1,67 @@
+/*
+	dio_column.h
+	columnar trace file converted from the raw result of dio-shark
+
+	Bits are stored in row groups. Each field of the bits is a column of
+	zigzag delta varints, so sorted or repeated values take a byte or
+	two, and a reader decodes only the columns it needs. A group starts
+	with its zone (ranges of time and sector and pids) and the length
+	of each column, so a filtered reader skips groups without decoding.
+	Notify bits and pdus are not stored.
+*/
+
+#ifndef DIO_COLUMN_H
+#define DIO_COLUMN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "blktrace_api.h"
+#include "dio_index.h"
+
+#define DIO_COLUMN_MAGIC	"DIOCOL01"
+#define COL_GROUP_ROWS		65536
+#define COL_MAX_VARINT		10
+
+enum{
+	COL_TIME,
+	COL_SECTOR,
+	COL_BYTES,
+	COL_ACTION,
+	COL_PID,
+	COL_DEVICE,
+	COL_CPU,
+	COL_ERROR,
+	COL_CNT
+};
+
+// zone.len is the length of the columns after the header
+struct col_group_header{
+	struct dio_zone zone;
+	uint32_t col_len[COL_CNT];
+};
+
+struct col_writer{
+	FILE* fp;
+	struct blk_io_trace* rows;
+	size_t cnt;
+	uint8_t* buf;
+	uint64_t off;
+};
+
+bool col_writer_open(struct col_writer* pwr, const char* path);
+bool col_writer_add(struct col_writer* pwr, struct blk_io_trace* pbit);
+
+// flush the last group and close the file
+bool col_writer_close(struct col_writer* pwr);
+
+// offset of the column 'col' in the body of the group
+size_t col_offset(struct col_group_header* phdr, int col);
+
+// decode the column 'col' of the group into 'vals' (zone.cnt values).
+// false is returned if the column is broken
+bool col_decode(struct col_group_header* phdr, const uint8_t* body, int col, uint64_t* vals);
+
+#endif
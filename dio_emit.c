@@ -0,0 +1,219 @@
+/*
+	dio_emit.c
+	streaming emitter of the machine readable results
+*/
+
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "dio_emit.h"
+
+int emit_parse_format(const char* name){
+	if( !strcmp(name, "text") )
+		return EMIT_TEXT;
+	if( !strcmp(name, "json") )
+		return EMIT_JSON;
+	if( !strcmp(name, "csv") )
+		return EMIT_CSV;
+	if( !strcmp(name, "bin") )
+		return EMIT_BIN;
+	return -1;
+}
+
+static void put_le(FILE* fp, uint64_t v, int len){
+	unsigned char b[8];
+	int i = 0;
+
+	for(i=0; i<len; i++)
+		b[i] = (unsigned char)(v >> (i * 8));
+	fwrite(b, 1, len, fp);
+}
+
+static void put_bin_str(FILE* fp, const char* s){
+	size_t len = strlen(s);
+
+	if( len > 0xffff )
+		len = 0xffff;
+	put_le(fp, len, 2);
+	fwrite(s, 1, len, fp);
+}
+
+static void put_json_str(FILE* fp, const char* s){
+	fputc('"', fp);
+	for(; *s; s++){
+		if( *s == '"' || *s == '\\' )
+			fprintf(fp, "\\%c", *s);
+		else if( (unsigned char)*s < 0x20 )
+			fprintf(fp, "\\u%04x", (unsigned char)*s);
+		else
+			fputc(*s, fp);
+	}
+	fputc('"', fp);
+}
+
+static void put_csv_str(FILE* fp, const char* s){
+	if( strpbrk(s, ",\"\r\n") == NULL ){
+		fputs(s, fp);
+		return;
+	}
+
+	fputc('"', fp);
+	for(; *s; s++){
+		if( *s == '"' )
+			fputc('"', fp);
+		fputc(*s, fp);
+	}
+	fputc('"', fp);
+}
+
+static void end_table(struct dio_emitter* pe){
+	if( pe->table == NULL )
+		return;
+	if( pe->format == EMIT_JSON )
+		fprintf(pe->fp, "%s]", pe->row_cnt > 0 ? "\n" : "");
+	pe->table = NULL;
+}
+
+void emit_begin(struct dio_emitter* pe, FILE* fp, enum emit_format format){
+	memset(pe, 0, sizeof(struct dio_emitter));
+	pe->fp = fp;
+	pe->format = format;
+
+	if( format == EMIT_JSON )
+		fputc('{', fp);
+	else if( format == EMIT_BIN )
+		fwrite(DIO_SUMMARY_MAGIC, 1, strlen(DIO_SUMMARY_MAGIC), fp);
+}
+
+void emit_end(struct dio_emitter* pe){
+	end_table(pe);
+	if( pe->format == EMIT_JSON )
+		fprintf(pe->fp, "%s}\n", pe->table_cnt > 0 ? "\n" : "");
+	else if( pe->format == EMIT_BIN )
+		fputc('E', pe->fp);
+	fflush(pe->fp);
+}
+
+void emit_table(struct dio_emitter* pe, const char* name, const struct emit_col* cols, int col_cnt){
+	int i = 0;
+
+	if( pe->format == EMIT_TEXT )
+		return;
+
+	end_table(pe);
+	pe->table = name;
+	pe->cols = cols;
+	pe->col_cnt = col_cnt;
+	pe->row_cnt = 0;
+
+	switch( pe->format ){
+	case EMIT_JSON:
+		fprintf(pe->fp, "%s\n", pe->table_cnt > 0 ? "," : "");
+		put_json_str(pe->fp, name);
+		fputs(":[", pe->fp);
+		break;
+	case EMIT_CSV:
+		if( pe->table_cnt > 0 )
+			fputc('\n', pe->fp);
+		fputs("table", pe->fp);
+		for(i=0; i<col_cnt; i++){
+			fputc(',', pe->fp);
+			put_csv_str(pe->fp, cols[i].name);
+		}
+		fputc('\n', pe->fp);
+		break;
+	case EMIT_BIN:
+		fputc('T', pe->fp);
+		put_bin_str(pe->fp, name);
+		put_le(pe->fp, col_cnt, 1);
+		for(i=0; i<col_cnt; i++){
+			put_le(pe->fp, cols[i].type, 1);
+			put_bin_str(pe->fp, cols[i].name);
+		}
+		break;
+	default:
+		break;
+	}
+	pe->table_cnt++;
+}
+
+void emit_row(struct dio_emitter* pe){
+	pe->col = 0;
+	switch( pe->format ){
+	case EMIT_JSON:
+		fprintf(pe->fp, "%s\n{", pe->row_cnt > 0 ? "," : "");
+		break;
+	case EMIT_CSV:
+		put_csv_str(pe->fp, pe->table);
+		break;
+	case EMIT_BIN:
+		fputc('R', pe->fp);
+		break;
+	default:
+		break;
+	}
+}
+
+// separator and name of the next value in text formats
+static void next_col(struct dio_emitter* pe){
+	if( pe->format == EMIT_JSON ){
+		if( pe->col > 0 )
+			fputc(',', pe->fp);
+		put_json_str(pe->fp, pe->col < pe->col_cnt ? pe->cols[pe->col].name : "");
+		fputc(':', pe->fp);
+	}
+	else if( pe->format == EMIT_CSV )
+		fputc(',', pe->fp);
+	pe->col++;
+}
+
+void emit_u64(struct dio_emitter* pe, uint64_t v){
+	if( pe->format == EMIT_TEXT )
+		return;
+	if( pe->format == EMIT_BIN ){
+		put_le(pe->fp, v, 8);
+		return;
+	}
+	next_col(pe);
+	fprintf(pe->fp, "%"PRIu64, v);
+}
+
+void emit_f64(struct dio_emitter* pe, double v){
+	uint64_t bits = 0;
+
+	if( pe->format == EMIT_TEXT )
+		return;
+	if( pe->format == EMIT_BIN ){
+		memcpy(&bits, &v, sizeof(bits));
+		put_le(pe->fp, bits, 8);
+		return;
+	}
+	next_col(pe);
+	if( isfinite(v) )
+		fprintf(pe->fp, "%.9g", v);
+	else if( pe->format == EMIT_JSON )
+		fputs("null", pe->fp);
+}
+
+void emit_str(struct dio_emitter* pe, const char* s){
+	if( pe->format == EMIT_TEXT )
+		return;
+	if( pe->format == EMIT_BIN ){
+		put_bin_str(pe->fp, s);
+		return;
+	}
+	next_col(pe);
+	if( pe->format == EMIT_JSON )
+		put_json_str(pe->fp, s);
+	else
+		put_csv_str(pe->fp, s);
+}
+
+void emit_row_end(struct dio_emitter* pe){
+	if( pe->format == EMIT_JSON )
+		fputc('}', pe->fp);
+	else if( pe->format == EMIT_CSV )
+		fputc('\n', pe->fp);
+	pe->row_cnt++;
+}
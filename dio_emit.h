@@ -0,0 +1,71 @@
+/*
+	dio_emit.h
+	streaming emitter of the machine readable results
+
+	Every result is a table of named columns, and its rows are written
+	field by field as they are made, so nothing is kept but the columns
+	of the current table.
+	  json : {"<table>":[{"<column>":<value>,...},...],...}
+	  csv  : a line "table,<columns>" before the rows "<table>,<values>",
+	         and an empty line between the tables
+	  bin  : DIOSUM01, then records in little endian.
+	         'T' u16 name_len, name, u8 col_cnt, (u8 type, u16 name_len, name) * col_cnt
+	         'R' values of the columns. u64 and f64 in 8 bytes, str as u16 len and bytes
+	         'E' at the end
+*/
+
+#ifndef DIO_EMIT_H
+#define DIO_EMIT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DIO_SUMMARY_MAGIC	"DIOSUM01"
+
+enum emit_format{
+	EMIT_TEXT,	//the statistics print their own text, nothing is emitted
+	EMIT_JSON,
+	EMIT_CSV,
+	EMIT_BIN
+};
+
+enum emit_type{
+	EMIT_U64,
+	EMIT_F64,
+	EMIT_STR
+};
+
+struct emit_col{
+	const char* name;
+	enum emit_type type;
+};
+
+struct dio_emitter{
+	FILE* fp;
+	enum emit_format format;
+	const char* table;
+	const struct emit_col* cols;
+	int col_cnt;
+	int col;		//column of the next value
+	uint64_t table_cnt;
+	uint64_t row_cnt;	//rows of the current table
+};
+
+// return the format of the name, or -1 for an unknown name
+int emit_parse_format(const char* name);
+
+void emit_begin(struct dio_emitter* pe, FILE* fp, enum emit_format format);
+void emit_end(struct dio_emitter* pe);
+
+// start a table. 'cols' must live until the next table
+void emit_table(struct dio_emitter* pe, const char* name, const struct emit_col* cols, int col_cnt);
+
+// a row is the values of all columns in order between emit_row and emit_row_end
+void emit_row(struct dio_emitter* pe);
+void emit_u64(struct dio_emitter* pe, uint64_t v);
+void emit_f64(struct dio_emitter* pe, double v);
+void emit_str(struct dio_emitter* pe, const char* s);
+void emit_row_end(struct dio_emitter* pe);
+
+#endif
@@ -0,0 +1,534 @@
+/*
+	dio_expr.c
+	filter expression of bits
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "dio_expr.h"
+
+#define EXPR_ACTION_STRING	"QMFGSRDCPUTIXBAad"
+#define EXPR_MAX_STACK		64
+
+enum{
+	FIELD_TIME,
+	FIELD_SECTOR,
+	FIELD_BYTES,
+	FIELD_PID,
+	FIELD_CPU,
+	FIELD_DEVICE,
+	FIELD_ACTION,
+	FIELD_RW,
+	FIELD_CNT
+};
+static const char* field_names[FIELD_CNT] = {
+	"time", "sector", "bytes", "pid", "cpu", "device", "action", "rw"
+};
+
+enum{
+	OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE,
+	OP_SET,		//in (v1, v2, ...)
+	OP_RANGE,	//in [low, high]
+	OP_AND, OP_OR, OP_NOT
+};
+
+// a node of the parsed tree. leaves are comparisons
+struct expr_node{
+	int op;
+	int field;
+	uint64_t low;		//value of the comparison, or low of range
+	uint64_t high;
+	uint64_t* set;		//sorted values of OP_SET
+	size_t set_cnt;
+	struct expr_node* left;
+	struct expr_node* right;
+};
+
+struct expr_inst{
+	int op;
+	int field;
+	uint64_t low;
+	uint64_t high;
+	uint64_t* set;
+	size_t set_cnt;
+};
+
+struct dio_expr{
+	struct expr_inst* insts;
+	size_t inst_cnt;
+	struct expr_node* root;
+};
+
+struct expr_parser{
+	const char* p;
+	char* err;
+	size_t errlen;
+	bool failed;
+	size_t node_cnt;
+};
+
+static void parse_error(struct expr_parser* pps, const char* msg){
+	if( pps->failed )
+		return;
+	pps->failed = true;
+	snprintf(pps->err, pps->errlen, "%s at \"%.20s\"", msg, pps->p);
+}
+
+static void skip_space(struct expr_parser* pps){
+	while( isspace((unsigned char)*pps->p) )
+		pps->p++;
+}
+
+// take 'tok' if it comes next
+static bool accept(struct expr_parser* pps, const char* tok){
+	size_t len = strlen(tok);
+
+	skip_space(pps);
+	if( strncmp(pps->p, tok, len) )
+		return false;
+	//a word must not be a part of longer word
+	if( isalpha((unsigned char)tok[0]) && isalnum((unsigned char)pps->p[len]) )
+		return false;
+	pps->p += len;
+	return true;
+}
+
+// a word of value or field name
+static size_t take_word(struct expr_parser* pps, char* buf, size_t buflen){
+	size_t len = 0;
+
+	skip_space(pps);
+	while( (isalnum((unsigned char)pps->p[len]) || pps->p[len] == '.' || pps->p[len] == ':' ||
+			pps->p[len] == '_') && len + 1 < buflen ){
+		buf[len] = pps->p[len];
+		len++;
+	}
+	buf[len] = '\0';
+	pps->p += len;
+	return len;
+}
+
+static bool parse_value(struct expr_parser* pps, int field, uint64_t* pval){
+	char word[64], *end = NULL;
+	const char* act = NULL;
+	double num = 0;
+	unsigned long major = 0, minor = 0;
+
+	if( take_word(pps, word, sizeof(word)) == 0 ){
+		parse_error(pps, "value is expected");
+		return false;
+	}
+
+	switch( field ){
+	case FIELD_ACTION:
+		act = strchr(EXPR_ACTION_STRING, word[0]);
+		if( word[1] != '\0' || act == NULL )
+			goto wrong;
+		*pval = act - EXPR_ACTION_STRING + 1;
+		return true;
+	case FIELD_RW:
+		if( !strcmp(word, "R") )
+			*pval = BLK_TC_READ;
+		else if( !strcmp(word, "W") )
+			*pval = BLK_TC_WRITE;
+		else
+			goto wrong;
+		return true;
+	case FIELD_DEVICE:
+		if( sscanf(word, "%lu:%lu", &major, &minor) != 2 )
+			goto wrong;
+		*pval = ((uint64_t)major << 20) | minor;
+		return true;
+	default:
+		break;
+	}
+
+	num = strtod(word, &end);
+	if( end == word || num < 0 )
+		goto wrong;
+	if( field == FIELD_TIME ){
+		if( !strcmp(end, "ns") )
+			;
+		else if( !strcmp(end, "us") )
+			num *= 1e3;
+		else if( !strcmp(end, "ms") )
+			num *= 1e6;
+		else if( !strcmp(end, "s") || *end == '\0' )
+			num *= 1e9;
+		else
+			goto wrong;
+	}
+	else if( field == FIELD_BYTES && *end != '\0' ){
+		if( !strcmp(end, "K") || !strcmp(end, "k") )
+			num *= 1024;
+		else if( !strcmp(end, "M") || !strcmp(end, "m") )
+			num *= 1024 * 1024;
+		else if( !strcmp(end, "G") || !strcmp(end, "g") )
+			num *= 1024.0 * 1024 * 1024;
+		else
+			goto wrong;
+	}
+	else if( *end != '\0' )
+		goto wrong;
+	*pval = (uint64_t)(num + 0.5);
+	return true;
+
+wrong:
+	pps->p -= strlen(word);
+	parse_error(pps, "wrong value");
+	return false;
+}
+
+static struct expr_node* new_node(struct expr_parser* pps, int op){
+	struct expr_node* pnode = (struct expr_node*)calloc(1, sizeof(struct expr_node));
+
+	if( pnode == NULL )
+		parse_error(pps, "out of memory");
+	else
+		pps->node_cnt++;
+	if( pnode != NULL )
+		pnode->op = op;
+	return pnode;
+}
+
+static void free_node(struct expr_node* pnode){
+	if( pnode == NULL )
+		return;
+	free_node(pnode->left);
+	free_node(pnode->right);
+	free(pnode->set);
+	free(pnode);
+}
+
+static int cmp_u64(const void* p1, const void* p2){
+	uint64_t v1 = *(const uint64_t*)p1, v2 = *(const uint64_t*)p2;
+
+	return (v1 < v2) ? -1 : (v1 > v2);
+}
+
+static struct expr_node* parse_or(struct expr_parser* pps);
+
+// field op value, field in (...), field in [...]
+static struct expr_node* parse_cmp(struct expr_parser* pps){
+	static const char* ops[] = { "==", "!=", "<=", ">=", "<", ">" };
+	static const int opcodes[] = { OP_EQ, OP_NE, OP_LE, OP_GE, OP_LT, OP_GT };
+	struct expr_node* pnode = NULL;
+	uint64_t* newset = NULL;
+	char word[64];
+	int field = 0, i = 0;
+
+	take_word(pps, word, sizeof(word));
+	for(field=0; field<FIELD_CNT; field++){
+		if( !strcmp(word, field_names[field]) )
+			break;
+	}
+	if( field == FIELD_CNT ){
+		pps->p -= strlen(word);
+		parse_error(pps, "unknown field");
+		return NULL;
+	}
+
+	if( accept(pps, "in") ){
+		if( accept(pps, "[") ){
+			pnode = new_node(pps, OP_RANGE);
+			if( pnode == NULL )
+				return NULL;
+			pnode->field = field;
+			if( !parse_value(pps, field, &pnode->low) )
+				goto err;
+			if( !accept(pps, ",") ){
+				parse_error(pps, "',' is expected");
+				goto err;
+			}
+			if( !parse_value(pps, field, &pnode->high) )
+				goto err;
+			if( !accept(pps, "]") ){
+				parse_error(pps, "']' is expected");
+				goto err;
+			}
+			return pnode;
+		}
+		if( !accept(pps, "(") ){
+			parse_error(pps, "'(' or '[' is expected");
+			return NULL;
+		}
+		pnode = new_node(pps, OP_SET);
+		if( pnode == NULL )
+			return NULL;
+		pnode->field = field;
+		do{
+			newset = (uint64_t*)realloc(pnode->set, sizeof(uint64_t) * (pnode->set_cnt + 1));
+			if( newset == NULL ){
+				parse_error(pps, "out of memory");
+				goto err;
+			}
+			pnode->set = newset;
+			if( !parse_value(pps, field, &pnode->set[pnode->set_cnt]) )
+				goto err;
+			pnode->set_cnt++;
+		}while( accept(pps, ",") );
+		if( !accept(pps, ")") ){
+			parse_error(pps, "')' is expected");
+			goto err;
+		}
+		qsort(pnode->set, pnode->set_cnt, sizeof(uint64_t), cmp_u64);
+		return pnode;
+	}
+
+	for(i=0; i<(int)(sizeof(ops)/sizeof(ops[0])); i++){
+		if( accept(pps, ops[i]) )
+			break;
+	}
+	if( i == (int)(sizeof(ops)/sizeof(ops[0])) ){
+		parse_error(pps, "comparison is expected");
+		return NULL;
+	}
+	if( field == FIELD_RW && opcodes[i] != OP_EQ && opcodes[i] != OP_NE ){
+		parse_error(pps, "rw takes only == and !=");
+		return NULL;
+	}
+
+	pnode = new_node(pps, opcodes[i]);
+	if( pnode == NULL )
+		return NULL;
+	pnode->field = field;
+	if( !parse_value(pps, field, &pnode->low) )
+		goto err;
+	return pnode;
+err:
+	free_node(pnode);
+	return NULL;
+}
+
+static struct expr_node* parse_unary(struct expr_parser* pps){
+	struct expr_node* pnode = NULL;
+
+	if( accept(pps, "!") ){
+		pnode = new_node(pps, OP_NOT);
+		if( pnode != NULL )
+			pnode->left = parse_unary(pps);
+		if( pnode != NULL && pnode->left == NULL ){
+			free_node(pnode);
+			return NULL;
+		}
+		return pnode;
+	}
+	if( accept(pps, "(") ){
+		pnode = parse_or(pps);
+		if( pnode != NULL && !accept(pps, ")") ){
+			parse_error(pps, "')' is expected");
+			free_node(pnode);
+			return NULL;
+		}
+		return pnode;
+	}
+	return parse_cmp(pps);
+}
+
+// a chain of the same logic op
+static struct expr_node* parse_chain(struct expr_parser* pps, const char* tok, int op,
+					struct expr_node* (*parse_sub)(struct expr_parser*)){
+	struct expr_node* pnode = parse_sub(pps);
+	struct expr_node* plogic = NULL;
+
+	while( pnode != NULL && accept(pps, tok) ){
+		plogic = new_node(pps, op);
+		if( plogic == NULL ){
+			free_node(pnode);
+			return NULL;
+		}
+		plogic->left = pnode;
+		plogic->right = parse_sub(pps);
+		pnode = plogic;
+		if( pnode->right == NULL ){
+			free_node(pnode);
+			return NULL;
+		}
+	}
+	return pnode;
+}
+
+static struct expr_node* parse_and(struct expr_parser* pps){
+	return parse_chain(pps, "&&", OP_AND, parse_unary);
+}
+
+static struct expr_node* parse_or(struct expr_parser* pps){
+	return parse_chain(pps, "||", OP_OR, parse_and);
+}
+
+// put the node in postfix order. return the depth of stack it needs
+static int emit(struct dio_expr* pexpr, struct expr_node* pnode){
+	struct expr_inst* pinst = NULL;
+	int ldepth = 0, rdepth = 0;
+
+	if( pnode->left != NULL )
+		ldepth = emit(pexpr, pnode->left);
+	if( pnode->right != NULL )
+		rdepth = emit(pexpr, pnode->right) + 1;
+
+	pinst = &pexpr->insts[pexpr->inst_cnt++];
+	pinst->op = pnode->op;
+	pinst->field = pnode->field;
+	pinst->low = pnode->low;
+	pinst->high = pnode->high;
+	pinst->set = pnode->set;
+	pinst->set_cnt = pnode->set_cnt;
+
+	if( pnode->left == NULL )
+		return 1;
+	return (ldepth > rdepth) ? ldepth : rdepth;
+}
+
+struct dio_expr* expr_compile(const char* str, char* err, size_t errlen){
+	struct expr_parser ps;
+	struct dio_expr* pexpr = NULL;
+	struct expr_node* root = NULL;
+
+	memset(&ps, 0, sizeof(ps));
+	ps.p = str;
+	ps.err = err;
+	ps.errlen = errlen;
+
+	root = parse_or(&ps);
+	skip_space(&ps);
+	if( root != NULL && *ps.p != '\0' )
+		parse_error(&ps, "end of expression is expected");
+	if( ps.failed ){
+		free_node(root);
+		return NULL;
+	}
+
+	pexpr = (struct dio_expr*)calloc(1, sizeof(struct dio_expr));
+	if( pexpr != NULL )
+		pexpr->insts = (struct expr_inst*)malloc(sizeof(struct expr_inst) * ps.node_cnt);
+	if( pexpr == NULL || pexpr->insts == NULL ){
+		snprintf(err, errlen, "out of memory");
+		goto err;
+	}
+	pexpr->root = root;
+	if( emit(pexpr, root) > EXPR_MAX_STACK ){
+		snprintf(err, errlen, "expression is too deep");
+		goto err;
+	}
+	return pexpr;
+err:
+	if( pexpr != NULL )
+		free(pexpr->insts);
+	free(pexpr);
+	free_node(root);
+	return NULL;
+}
+
+void expr_free(struct dio_expr* pexpr){
+	if( pexpr == NULL )
+		return;
+	free_node(pexpr->root);
+	free(pexpr->insts);
+	free(pexpr);
+}
+
+static inline uint64_t field_value(const struct blk_io_trace* pbit, int field){
+	switch( field ){
+	case FIELD_TIME:	return pbit->time;
+	case FIELD_SECTOR:	return pbit->sector;
+	case FIELD_BYTES:	return pbit->bytes;
+	case FIELD_PID:		return pbit->pid;
+	case FIELD_CPU:		return pbit->cpu;
+	case FIELD_DEVICE:	return pbit->device;
+	case FIELD_ACTION:	return pbit->action & 0xffff;
+	default:		return (pbit->action >> BLK_TC_SHIFT) & (BLK_TC_READ | BLK_TC_WRITE);
+	}
+}
+
+static inline bool in_set(const uint64_t* set, size_t cnt, uint64_t v){
+	size_t lo = 0, hi = cnt, mid = 0;
+
+	while( lo < hi ){
+		mid = (lo + hi) / 2;
+		if( set[mid] < v )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo < cnt && set[lo] == v;
+}
+
+bool expr_eval(const struct dio_expr* pexpr, const struct blk_io_trace* pbit){
+	bool stack[EXPR_MAX_STACK];
+	const struct expr_inst* pinst = NULL;
+	uint64_t v = 0;
+	size_t i = 0;
+	int top = -1;
+
+	for(i=0; i<pexpr->inst_cnt; i++){
+		pinst = &pexpr->insts[i];
+		if( pinst->op >= OP_AND ){
+			if( pinst->op == OP_NOT )
+				stack[top] = !stack[top];
+			else if( pinst->op == OP_AND ){
+				stack[top-1] = stack[top-1] && stack[top];
+				top--;
+			}
+			else{
+				stack[top-1] = stack[top-1] || stack[top];
+				top--;
+			}
+			continue;
+		}
+
+		v = field_value(pbit, pinst->field);
+		switch( pinst->op ){
+		case OP_EQ:	stack[++top] = (v == pinst->low); break;
+		case OP_NE:	stack[++top] = (v != pinst->low); break;
+		case OP_LT:	stack[++top] = (v < pinst->low); break;
+		case OP_LE:	stack[++top] = (v <= pinst->low); break;
+		case OP_GT:	stack[++top] = (v > pinst->low); break;
+		case OP_GE:	stack[++top] = (v >= pinst->low); break;
+		case OP_SET:	stack[++top] = in_set(pinst->set, pinst->set_cnt, v); break;
+		default:	stack[++top] = (pinst->low <= v && v <= pinst->high); break;
+		}
+	}
+	return stack[0];
+}
+
+static void narrow(uint64_t* plow, uint64_t* phigh, uint64_t low, uint64_t high){
+	if( low > *plow )
+		*plow = low;
+	if( high < *phigh )
+		*phigh = high;
+}
+
+static void narrow_node(const struct expr_node* pnode, struct dio_filter* pflt){
+	uint64_t low = 0, high = (uint64_t)(-1);
+
+	if( pnode->op == OP_AND ){
+		narrow_node(pnode->left, pflt);
+		narrow_node(pnode->right, pflt);
+		return;
+	}
+
+	switch( pnode->op ){
+	case OP_EQ:	low = high = pnode->low; break;
+	case OP_LT:	if( pnode->low == 0 ) low = 1, high = 0; else high = pnode->low - 1; break;
+	case OP_LE:	high = pnode->low; break;
+	case OP_GT:	if( pnode->low == (uint64_t)(-1) ) low = 1, high = 0; else low = pnode->low + 1; break;
+	case OP_GE:	low = pnode->low; break;
+	case OP_RANGE:	low = pnode->low; high = pnode->high; break;
+	case OP_SET:	low = pnode->set[0]; high = pnode->set[pnode->set_cnt-1]; break;
+	default:	return;
+	}
+
+	if( pnode->field == FIELD_TIME )
+		narrow(&pflt->time_start, &pflt->time_end, low, high);
+	else if( pnode->field == FIELD_SECTOR )
+		narrow(&pflt->sector_start, &pflt->sector_end, low, high);
+	else if( pnode->field == FIELD_PID && low == high && pflt->pid == (uint64_t)(-1) )
+		pflt->pid = low;
+}
+
+void expr_narrow_filter(const struct dio_expr* pexpr, struct dio_filter* pflt){
+	narrow_node(pexpr->root, pflt);
+}
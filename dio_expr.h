@@ -0,0 +1,40 @@
+/*
+	dio_expr.h
+	filter expression of bits
+
+	An expression like
+		pid in (123,456) && bytes >= 64K && rw == W && time in [12.5s, 14s]
+	is parsed once and compiled to a flat program in postfix order,
+	which is run on each bit with a small stack of results.
+
+	fields	: time, sector, bytes, pid, cpu, device, action, rw
+	compare	: ==, !=, <, <=, >, >=, in (v1, v2, ...), in [low, high]
+	logic	: &&, ||, !, ( )
+	values	: time takes ns, us, ms or s (default), bytes takes K, M or G,
+		  device is major:minor, action is one of "QMFGSRDCPUTIXBAad",
+		  rw is R or W
+*/
+
+#ifndef DIO_EXPR_H
+#define DIO_EXPR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "blktrace_api.h"
+#include "dio_filter.h"
+
+struct dio_expr;
+
+// compile 'str'. NULL is returned with the reason in 'err' if it is wrong
+struct dio_expr* expr_compile(const char* str, char* err, size_t errlen);
+void expr_free(struct dio_expr* pexpr);
+
+bool expr_eval(const struct dio_expr* pexpr, const struct blk_io_trace* pbit);
+
+// narrow the ranges of the filter by the time, sector and pid terms
+// which all bits passing the expression must satisfy
+void expr_narrow_filter(const struct dio_expr* pexpr, struct dio_filter* pflt);
+
+#endif
@@ -0,0 +1,198 @@
+/*
+	dio_filter.c
+	filter and decode kernels over batches of bits
+*/
+
+#include <stdbool.h>
+
+#include "dio_filter.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FILTER_X86
+#endif
+
+typedef size_t (*filter_bits_fn)(const struct dio_filter*, const struct blk_io_trace*, size_t, uint32_t*);
+typedef size_t (*filter_cols_fn)(const struct dio_filter*, const uint64_t*, const uint64_t*,
+				const uint64_t*, const uint64_t*, size_t, uint32_t*);
+typedef void (*swap_bits_fn)(struct blk_io_trace*, size_t);
+
+static inline bool pass_one(const struct dio_filter* pflt, uint64_t time, uint64_t sector,
+				uint64_t pid, uint32_t action){
+	if( (pflt->time_start > time || pflt->time_end < time) ||
+		(pflt->sector_start > sector || pflt->sector_end < sector) )
+		return false;
+	if( pflt->pid != (uint64_t)(-1) && pflt->pid != pid )
+		return false;
+	return (action >> BLK_TC_SHIFT) != BLK_TC_NOTIFY;
+}
+
+static size_t filter_bits_scalar(const struct dio_filter* pflt, const struct blk_io_trace* bits,
+				size_t n, uint32_t* sel){
+	size_t i = 0, cnt = 0;
+
+	for(i=0; i<n; i++){
+		if( pass_one(pflt, bits[i].time, bits[i].sector, bits[i].pid, bits[i].action) )
+			sel[cnt++] = i;
+	}
+	return cnt;
+}
+
+static size_t filter_cols_scalar(const struct dio_filter* pflt, const uint64_t* time, const uint64_t* sector,
+				const uint64_t* pid, const uint64_t* action, size_t n, uint32_t* sel){
+	size_t i = 0, cnt = 0;
+
+	for(i=0; i<n; i++){
+		if( pass_one(pflt, time[i], sector[i], pid[i], (uint32_t)action[i]) )
+			sel[cnt++] = i;
+	}
+	return cnt;
+}
+
+static void swap_bits_scalar(struct blk_io_trace* bits, size_t n){
+	struct blk_io_trace* pbit = NULL;
+	size_t i = 0;
+
+	for(i=0; i<n; i++){
+		pbit = &bits[i];
+		pbit->magic = __builtin_bswap32(pbit->magic);
+		pbit->sequence = __builtin_bswap32(pbit->sequence);
+		pbit->time = __builtin_bswap64(pbit->time);
+		pbit->sector = __builtin_bswap64(pbit->sector);
+		pbit->bytes = __builtin_bswap32(pbit->bytes);
+		pbit->action = __builtin_bswap32(pbit->action);
+		pbit->pid = __builtin_bswap32(pbit->pid);
+		pbit->device = __builtin_bswap32(pbit->device);
+		pbit->cpu = __builtin_bswap32(pbit->cpu);
+		pbit->error = __builtin_bswap16(pbit->error);
+		pbit->pdu_len = __builtin_bswap16(pbit->pdu_len);
+	}
+}
+
+#ifdef FILTER_X86
+// a bit is three 16 byte lanes, and each lane has its own shuffle of the fields
+__attribute__((target("ssse3")))
+static void swap_bits_ssse3(struct blk_io_trace* bits, size_t n){
+	const __m128i shuf0 = _mm_setr_epi8(3,2,1,0, 7,6,5,4, 15,14,13,12,11,10,9,8);	//magic, sequence, time
+	const __m128i shuf1 = _mm_setr_epi8(7,6,5,4,3,2,1,0, 11,10,9,8, 15,14,13,12);	//sector, bytes, action
+	const __m128i shuf2 = _mm_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 13,12, 15,14);	//pid, device, cpu, error, pdu_len
+	__m128i* p = NULL;
+	size_t i = 0;
+
+	for(i=0; i<n; i++){
+		p = (__m128i*)&bits[i];
+		_mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), shuf0));
+		_mm_storeu_si128(p+1, _mm_shuffle_epi8(_mm_loadu_si128(p+1), shuf1));
+		_mm_storeu_si128(p+2, _mm_shuffle_epi8(_mm_loadu_si128(p+2), shuf2));
+	}
+}
+
+// 64bit compare is signed, so the sign bits are flipped for unsigned values
+#define AVX2_FLIP(v)	_mm256_xor_si256((v), _mm256_set1_epi64x((long long)0x8000000000000000ULL))
+
+// lanes of 'v' in [lo, hi]. 'lo' and 'hi' are flipped already
+__attribute__((target("avx2")))
+static inline __m256i avx2_in_range(__m256i v, __m256i lo, __m256i hi){
+	__m256i fv = AVX2_FLIP(v);
+
+	return _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi64(lo, fv), _mm256_cmpgt_epi64(fv, hi)),
+				_mm256_set1_epi64x(-1));
+}
+
+// lanes of 4 bits which pass, from the 64bit values of the fields
+__attribute__((target("avx2")))
+static inline int avx2_pass(const struct dio_filter* pflt, __m256i time, __m256i sector,
+				__m256i pid, __m256i action){
+	__m256i ok;
+
+	ok = _mm256_and_si256(
+		avx2_in_range(time, AVX2_FLIP(_mm256_set1_epi64x(pflt->time_start)), AVX2_FLIP(_mm256_set1_epi64x(pflt->time_end))),
+		avx2_in_range(sector, AVX2_FLIP(_mm256_set1_epi64x(pflt->sector_start)), AVX2_FLIP(_mm256_set1_epi64x(pflt->sector_end))));
+	if( pflt->pid != (uint64_t)(-1) )
+		ok = _mm256_and_si256(ok, _mm256_cmpeq_epi64(pid, _mm256_set1_epi64x(pflt->pid)));
+	ok = _mm256_andnot_si256(_mm256_cmpeq_epi64(_mm256_srli_epi64(_mm256_and_si256(action,
+				_mm256_set1_epi64x(0xffffffff)), BLK_TC_SHIFT), _mm256_set1_epi64x(BLK_TC_NOTIFY)), ok);
+	return _mm256_movemask_pd(_mm256_castsi256_pd(ok));
+}
+
+static inline size_t put_sel(int mask, size_t base, uint32_t* sel, size_t cnt){
+	while( mask ){
+		sel[cnt++] = base + __builtin_ctz(mask);
+		mask &= mask - 1;
+	}
+	return cnt;
+}
+
+// fields of 4 bits are gathered at the stride of the struct
+__attribute__((target("avx2")))
+static size_t filter_bits_avx2(const struct dio_filter* pflt, const struct blk_io_trace* bits,
+				size_t n, uint32_t* sel){
+	const __m256i idx64 = _mm256_set_epi64x(3 * sizeof(struct blk_io_trace), 2 * sizeof(struct blk_io_trace),
+						sizeof(struct blk_io_trace), 0);
+	const __m128i idx32 = _mm_set_epi32(3 * sizeof(struct blk_io_trace), 2 * sizeof(struct blk_io_trace),
+						sizeof(struct blk_io_trace), 0);
+	__m256i time, sector, pid, action;
+	size_t i = 0, cnt = 0;
+
+	for(i=0; i+4<=n; i+=4){
+		time = _mm256_i64gather_epi64((const long long*)&bits[i].time, idx64, 1);
+		sector = _mm256_i64gather_epi64((const long long*)&bits[i].sector, idx64, 1);
+		pid = _mm256_cvtepu32_epi64(_mm_i32gather_epi32((const int*)&bits[i].pid, idx32, 1));
+		action = _mm256_cvtepu32_epi64(_mm_i32gather_epi32((const int*)&bits[i].action, idx32, 1));
+		cnt = put_sel(avx2_pass(pflt, time, sector, pid, action), i, sel, cnt);
+	}
+	for(; i<n; i++){
+		if( pass_one(pflt, bits[i].time, bits[i].sector, bits[i].pid, bits[i].action) )
+			sel[cnt++] = i;
+	}
+	return cnt;
+}
+
+__attribute__((target("avx2")))
+static size_t filter_cols_avx2(const struct dio_filter* pflt, const uint64_t* time, const uint64_t* sector,
+				const uint64_t* pid, const uint64_t* action, size_t n, uint32_t* sel){
+	size_t i = 0, cnt = 0;
+
+	for(i=0; i+4<=n; i+=4){
+		cnt = put_sel(avx2_pass(pflt,
+				_mm256_loadu_si256((const __m256i*)&time[i]),
+				_mm256_loadu_si256((const __m256i*)&sector[i]),
+				_mm256_loadu_si256((const __m256i*)&pid[i]),
+				_mm256_loadu_si256((const __m256i*)&action[i])), i, sel, cnt);
+	}
+	for(; i<n; i++){
+		if( pass_one(pflt, time[i], sector[i], pid[i], (uint32_t)action[i]) )
+			sel[cnt++] = i;
+	}
+	return cnt;
+}
+#endif
+
+static filter_bits_fn bits_kernel = filter_bits_scalar;
+static filter_cols_fn cols_kernel = filter_cols_scalar;
+static swap_bits_fn swap_kernel = swap_bits_scalar;
+
+void filter_init(void){
+#ifdef FILTER_X86
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports("avx2") ){
+		bits_kernel = filter_bits_avx2;
+		cols_kernel = filter_cols_avx2;
+	}
+	if( __builtin_cpu_supports("ssse3") )
+		swap_kernel = swap_bits_ssse3;
+#endif
+}
+
+size_t filter_bits(const struct dio_filter* pflt, const struct blk_io_trace* bits, size_t n, uint32_t* sel){
+	return bits_kernel(pflt, bits, n, sel);
+}
+
+size_t filter_cols(const struct dio_filter* pflt, const uint64_t* time, const uint64_t* sector,
+		const uint64_t* pid, const uint64_t* action, size_t n, uint32_t* sel){
+	return cols_kernel(pflt, time, sector, pid, action, n, sel);
+}
+
+void swap_bits(struct blk_io_trace* bits, size_t n){
+	swap_kernel(bits, n);
+}
@@ -0,0 +1,41 @@
+/*
+	dio_filter.h
+	filter and decode kernels over batches of bits
+
+	A filter kernel tests the time range, the sector range, the pid and
+	the notify action of a batch of bits at once and returns the indexes
+	of the bits which pass. A swap kernel turns a batch of bits of the
+	other byte order to the native one.
+	Kernels are picked once by filter_init from the instructions of the
+	running cpu (AVX2 and SSSE3, or the scalar ones).
+*/
+
+#ifndef DIO_FILTER_H
+#define DIO_FILTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "blktrace_api.h"
+
+struct dio_filter{
+	uint64_t time_start;
+	uint64_t time_end;
+	uint64_t sector_start;
+	uint64_t sector_end;
+	uint64_t pid;		//(uint64_t)(-1) for all pids
+};
+
+void filter_init(void);
+
+// bits in an array of structs. return the number of indexes put in 'sel'
+size_t filter_bits(const struct dio_filter* pflt, const struct blk_io_trace* bits, size_t n, uint32_t* sel);
+
+// bits in columns. return the number of indexes put in 'sel'
+size_t filter_cols(const struct dio_filter* pflt, const uint64_t* time, const uint64_t* sector,
+		const uint64_t* pid, const uint64_t* action, size_t n, uint32_t* sel);
+
+// swap the byte order of all fields of the bits
+void swap_bits(struct blk_io_trace* bits, size_t n);
+
+#endif
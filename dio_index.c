@@ -0,0 +1,111 @@
+/*
+	dio_index.c
+	sidecar zone map index of a trace file
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dio_index.h"
+
+static inline int pid_bit(uint32_t pid){
+	return (int)((pid * 2654435761u) >> 24) % ZONE_PID_BITS;
+}
+
+void zone_init(struct dio_zone* pzone, uint64_t off, uint64_t len){
+	memset(pzone, 0, sizeof(struct dio_zone));
+	pzone->off = off;
+	pzone->len = len;
+	pzone->min_time = (uint64_t)(-1);
+	pzone->min_sector = (uint64_t)(-1);
+}
+
+void zone_add(struct dio_zone* pzone, struct blk_io_trace* pbit){
+	int bit = pid_bit(pbit->pid);
+
+	pzone->cnt++;
+	if( pbit->time < pzone->min_time )
+		pzone->min_time = pbit->time;
+	if( pbit->time > pzone->max_time )
+		pzone->max_time = pbit->time;
+	if( pbit->sector < pzone->min_sector )
+		pzone->min_sector = pbit->sector;
+	if( pbit->sector > pzone->max_sector )
+		pzone->max_sector = pbit->sector;
+	pzone->pids[bit / 64] |= (uint64_t)1 << (bit % 64);
+}
+
+bool zone_match(struct dio_zone* pzone, uint64_t time_start, uint64_t time_end,
+		uint64_t sector_start, uint64_t sector_end, uint64_t pid){
+	int bit = 0;
+
+	if( pzone->cnt == 0 )
+		return false;
+	if( pzone->max_time < time_start || pzone->min_time > time_end )
+		return false;
+	if( pzone->max_sector < sector_start || pzone->min_sector > sector_end )
+		return false;
+	if( pid != (uint64_t)(-1) ){
+		bit = pid_bit((uint32_t)pid);
+		if( !(pzone->pids[bit / 64] & ((uint64_t)1 << (bit % 64))) )
+			return false;
+	}
+	return true;
+}
+
+bool write_index(const char* path, struct stat* pst, struct dio_zone* zones, size_t cnt){
+	struct dio_index_header hdr;
+	FILE* fp = NULL;
+	bool ok = true;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, DIO_INDEX_MAGIC, sizeof(hdr.magic));
+	hdr.file_size = pst->st_size;
+	hdr.file_mtime = pst->st_mtime;
+	hdr.zone_cnt = cnt;
+
+	fp = fopen(path, "wb");
+	if( fp == NULL )
+		return false;
+	if( fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+		(cnt > 0 && fwrite(zones, sizeof(struct dio_zone), cnt, fp) != cnt) )
+		ok = false;
+	if( fclose(fp) != 0 )
+		ok = false;
+
+	//a broken index must not be used later
+	if( !ok )
+		remove(path);
+	return ok;
+}
+
+struct dio_zone* read_index(const char* path, struct stat* pst, size_t* pcnt){
+	struct dio_index_header hdr;
+	struct dio_zone* zones = NULL;
+	FILE* fp = NULL;
+
+	*pcnt = 0;
+	fp = fopen(path, "rb");
+	if( fp == NULL )
+		return NULL;
+
+	if( fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+		memcmp(hdr.magic, DIO_INDEX_MAGIC, sizeof(hdr.magic)) ||
+		hdr.file_size != (uint64_t)pst->st_size || hdr.file_mtime != (int64_t)pst->st_mtime )
+		goto err;
+
+	zones = (struct dio_zone*)malloc(sizeof(struct dio_zone) * (hdr.zone_cnt + 1));
+	if( zones == NULL )
+		goto err;
+	if( hdr.zone_cnt > 0 && fread(zones, sizeof(struct dio_zone), hdr.zone_cnt, fp) != hdr.zone_cnt )
+		goto err;
+
+	fclose(fp);
+	*pcnt = hdr.zone_cnt;
+	return zones;
+err:
+	free(zones);
+	fclose(fp);
+	return NULL;
+}
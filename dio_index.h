@@ -0,0 +1,58 @@
+/*
+	dio_index.h
+	sidecar zone map index of a trace file
+
+	The trace file is cut in blocks at bit boundaries, and each block
+	keeps the range of time and sector and a bitmap of the pids of its
+	bits. A filtered parse reads only the blocks whose zone can have a
+	matching bit, instead of decoding the whole file.
+	The index is valid only for the file of the same size and mtime.
+*/
+
+#ifndef DIO_INDEX_H
+#define DIO_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+
+#include "blktrace_api.h"
+
+#define DIO_INDEX_MAGIC		"DIOIDX01"
+#define DIO_INDEX_SUFFIX	".idx"
+#define ZONE_PID_BITS		256	//pids are hashed into the bitmap
+
+struct dio_zone{
+	uint64_t off;		//offset of the block in the file
+	uint64_t len;		//length of the block
+	uint64_t cnt;		//number of bits counted in the zone
+	uint64_t min_time;
+	uint64_t max_time;
+	uint64_t min_sector;
+	uint64_t max_sector;
+	uint64_t pids[ZONE_PID_BITS / 64];
+};
+
+struct dio_index_header{
+	char magic[8];
+	uint64_t file_size;
+	int64_t file_mtime;
+	uint64_t zone_cnt;
+};
+
+void zone_init(struct dio_zone* pzone, uint64_t off, uint64_t len);
+void zone_add(struct dio_zone* pzone, struct blk_io_trace* pbit);
+
+// whether a bit of the zone can be in the filter. 'pid' is (uint64_t)(-1) for all pids
+bool zone_match(struct dio_zone* pzone, uint64_t time_start, uint64_t time_end,
+		uint64_t sector_start, uint64_t sector_end, uint64_t pid);
+
+// write the zones of the trace file 'pst' to 'path'
+bool write_index(const char* path, struct stat* pst, struct dio_zone* zones, size_t cnt);
+
+// return the zones read from 'path', or NULL if there isn't a valid index of 'pst'.
+// the zones are allocated by malloc
+struct dio_zone* read_index(const char* path, struct stat* pst, size_t* pcnt);
+
+#endif
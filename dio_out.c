@@ -0,0 +1,121 @@
+/*
+	dio_out.c
+	buffered writer of the text output
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "dio_out.h"
+
+const char out_digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+// chunks are taken one by one by the threads, and a thread waits until
+// the chunks before its own are written before it writes
+struct out_ctx{
+	FILE* fp;
+	size_t cnt;
+	size_t chunk_rows;
+	size_t chunk_cnt;
+	size_t buf_size;
+	out_fmt_func fmt;
+	void* arg;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	size_t taken;		//chunks taken by the threads
+	size_t written;		//chunks written
+	bool failed;
+};
+
+static void* format_chunks(void* param){
+	struct out_ctx* pctx = (struct out_ctx*)param;
+	char* buf = NULL;
+	size_t k = 0, start = 0, end = 0, len = 0;
+	bool ok = true;
+
+	buf = (char*)malloc(pctx->buf_size);
+	pthread_mutex_lock(&pctx->lock);
+	if( buf == NULL )
+		pctx->failed = true;
+	while( buf != NULL && pctx->taken < pctx->chunk_cnt ){
+		k = pctx->taken++;
+		pthread_mutex_unlock(&pctx->lock);
+
+		start = k * pctx->chunk_rows;
+		end = start + pctx->chunk_rows;
+		if( end > pctx->cnt )
+			end = pctx->cnt;
+		len = pctx->fmt(buf, start, end, pctx->arg);
+
+		pthread_mutex_lock(&pctx->lock);
+		while( pctx->written != k )
+			pthread_cond_wait(&pctx->cond, &pctx->lock);
+		ok = !pctx->failed;
+		pthread_mutex_unlock(&pctx->lock);
+
+		//only this thread writes until 'written' goes up
+		if( ok )
+			ok = (fwrite(buf, 1, len, pctx->fp) == len);
+
+		pthread_mutex_lock(&pctx->lock);
+		if( !ok )
+			pctx->failed = true;
+		pctx->written++;
+		pthread_cond_broadcast(&pctx->cond);
+	}
+	pthread_mutex_unlock(&pctx->lock);
+
+	free(buf);
+	return NULL;
+}
+
+bool out_rows(FILE* fp, size_t cnt, size_t row_max, int thread_cnt, out_fmt_func fmt, void* arg){
+	struct out_ctx ctx;
+	pthread_t* tds = NULL;
+	int i = 0, created = 0;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.fp = fp;
+	ctx.cnt = cnt;
+	ctx.chunk_rows = OUT_CHUNK_SIZE / row_max;
+	if( ctx.chunk_rows == 0 )
+		ctx.chunk_rows = 1;
+	ctx.chunk_cnt = (cnt + ctx.chunk_rows - 1) / ctx.chunk_rows;
+	ctx.buf_size = ctx.chunk_rows * row_max;
+	ctx.fmt = fmt;
+	ctx.arg = arg;
+	pthread_mutex_init(&ctx.lock, NULL);
+	pthread_cond_init(&ctx.cond, NULL);
+
+	if( (size_t)thread_cnt > ctx.chunk_cnt )
+		thread_cnt = (int)ctx.chunk_cnt;
+	if( thread_cnt > 1 )
+		tds = (pthread_t*)malloc(sizeof(pthread_t) * (thread_cnt - 1));
+
+	//the other chunks are taken by the threads which could be made
+	for(i=0; tds != NULL && i<thread_cnt-1; i++){
+		if( pthread_create(&tds[i], NULL, format_chunks, &ctx) )
+			break;
+		created++;
+	}
+	format_chunks(&ctx);
+	for(i=0; i<created; i++)
+		pthread_join(tds[i], NULL);
+	free(tds);
+
+	pthread_mutex_destroy(&ctx.lock);
+	pthread_cond_destroy(&ctx.cond);
+	return !ctx.failed && fflush(fp) == 0;
+}
@@ -0,0 +1,90 @@
+/*
+	dio_out.h
+	buffered writer of the text output
+
+	Numbers are formatted by hand into a buffer instead of parsing a
+	printf format for each field, and the buffer is written at once.
+	out_rows cuts the rows in chunks which are formatted by several
+	threads and written in the order of rows.
+*/
+
+#ifndef DIO_OUT_H
+#define DIO_OUT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define OUT_CHUNK_SIZE	(1024*1024)	//buffer of a chunk
+
+extern const char out_digit_pairs[201];
+
+// format rows [start, end) into 'buf' and return the length
+typedef size_t(*out_fmt_func)(char* buf, size_t start, size_t end, void* arg);
+
+// write rows [0, cnt) to 'fp' with 'thread_cnt' threads.
+// 'row_max' is the longest length of a row.
+// false is returned if writing is failed
+bool out_rows(FILE* fp, size_t cnt, size_t row_max, int thread_cnt, out_fmt_func fmt, void* arg);
+
+// the formatters write at 'p' and return the end of what they wrote
+static inline char* out_u64(char* p, uint64_t v){
+	char tmp[20];
+	char* q = tmp + sizeof(tmp);
+	size_t len = 0;
+
+	while( v >= 100 ){
+		q -= 2;
+		memcpy(q, &out_digit_pairs[(v % 100) * 2], 2);
+		v /= 100;
+	}
+	if( v >= 10 ){
+		q -= 2;
+		memcpy(q, &out_digit_pairs[v * 2], 2);
+	}
+	else
+		*--q = '0' + (char)v;
+
+	len = tmp + sizeof(tmp) - q;
+	memcpy(p, q, len);
+	return p + len;
+}
+
+static inline char* out_i64(char* p, int64_t v){
+	if( v < 0 ){
+		*p++ = '-';
+		return out_u64(p, -(uint64_t)v);
+	}
+	return out_u64(p, (uint64_t)v);
+}
+
+// nanoseconds as "%5d.%09d" of seconds and nanoseconds
+static inline char* out_time(char* p, uint64_t ns){
+	uint64_t sec = ns / 1000000000, frac = ns % 1000000000;
+	char* q = NULL;
+	size_t len = out_u64(p, sec) - p;
+	int i = 0;
+
+	//right aligned in 5 columns
+	if( len < 5 ){
+		memmove(p + 5 - len, p, len);
+		memset(p, ' ', 5 - len);
+		len = 5;
+	}
+	p += len;
+	*p++ = '.';
+
+	//9 digits from the last
+	q = p + 9;
+	for(i=0; i<4; i++){
+		q -= 2;
+		memcpy(q, &out_digit_pairs[(frac % 100) * 2], 2);
+		frac /= 100;
+	}
+	p[0] = '0' + (char)frac;
+	return p + 9;
+}
+
+#endif
@@ -13,15 +13,32 @@
 #include <errno.h>
 #include <signal.h>
 #include <string.h>
+#include <ctype.h>
 #include <fcntl.h>
 #include <stdarg.h>
 #include <getopt.h>
+#include <sched.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include "dio_shark.h"
 #include "list.h"
 #include "rbtree.h"
+#include "bptree.h"
+#include "histogram.h"
+#include "dio_index.h"
+#include "dio_column.h"
+#include "dio_filter.h"
+#include "dio_expr.h"
+#include "dio_out.h"
+#include "dio_emit.h"
+#include "dio_chart.h"
+#include "dio_pyramid.h"
+#include "dio_sketch.h"
+#include "dio_cache.h"
 #include "blktrace_api.h"
 
 /*--------------	struct and defines	------------------*/
@@ -30,49 +47,24 @@
 #define DOUBLE_TO_NANO_ULL(d)   ((unsigned long long)((d) * 1000000000))
 
 #define BLK_ACTION_STRING		"QMFGSRDCPUTIXBAad"
-#define GET_ACTION_CHAR(x)      (0<(x&0xffff) && (x&0xffff)<sizeof(BLK_ACTION_STRING))?BLK_ACTION_STRING[(x & 0xffff) - 1]:'?'
-
-#define BE_TO_LE16(word) \
-	(((word)>>8 & 0x00FF) | ((word)<<8 & 0xFF00))
-
-#define BE_TO_LE32(dword) \
-	(((dword)>>24 & 0x000000FF) | ((dword)<<24 & 0xFF000000) |\
-	((dword)>>8  & 0x0000FF00) | ((dword)<<8  & 0x00FF0000))
-
-#define BE_TO_LE64(qword) \
-	(((qword)>>56 & 0x00000000000000FF) | ((qword)<<56 & 0xFF00000000000000) |\
-	((qword)>>40 & 0x000000000000FF00) | ((qword)<<40 & 0x00FF000000000000) |\
-	((qword)>>24 & 0x0000000000FF0000) | ((qword)<<24 & 0x0000FF0000000000) |\
-	((qword)>>8  & 0x00000000FF000000) | ((qword)<<8  & 0x000000FF00000000))
-
-#define BE_TO_LE_BIT(bit) \
-	(bit).magic 	= BE_TO_LE32((bit).magic);\
-	(bit).sequence 	= BE_TO_LE32((bit).sequence);\
-	(bit).time	= BE_TO_LE64((bit).time);\
-	(bit).sector	= BE_TO_LE64((bit).sector);\
-	(bit).bytes	= BE_TO_LE32((bit).bytes);\
-	(bit).action	= BE_TO_LE32((bit).action);\
-	(bit).pid	= BE_TO_LE32((bit).pid);\
-	(bit).device	= BE_TO_LE32((bit).device);\
-	(bit).cpu	= BE_TO_LE32((bit).cpu);\
-	(bit).error	= BE_TO_LE16((bit).error);\
-	(bit).pdu_len	= BE_TO_LE16((bit).pdu_len)
-
-
-// dio_rbentity used for handling nuggets as sector order
-struct dio_rbentity{
-	struct rb_node rblink;		//red black tree link
+#define GET_ACTION_CHAR(x)      ((0<(x&0xffff) && (x&0xffff)<sizeof(BLK_ACTION_STRING))?BLK_ACTION_STRING[(x & 0xffff) - 1]:'?')
+
+// dio_secentity used for handling nuggets as sector order
+// it is the value of sector index (B+tree) for its sector
+struct dio_secentity{
 	struct list_head nghead;	//head of nugget list
 	uint64_t sector;
 };
 
 // dio_nugget is a treated data of bit
-// it will be linked at dio_rbentity 's nghead
+// it will be linked at dio_secentity 's nghead
 #define MAX_ELEMENT_SIZE 50
 #define NG_ACTIVE	1
 #define NG_BACKMERGE	2
 #define NG_FRONTMERGE	3
 #define NG_COMPLETE	4
+#define NG_PENDING	5	//front merged from other shard, waits for the reconcile
+#define NG_STANDIN	6	//stands for the front merged request of other shard
 struct dio_nugget{
 	struct list_head nglink;	//link of dio_nugget datatype
 
@@ -83,44 +75,180 @@ struct dio_nugget{
 	uint64_t times[MAX_ELEMENT_SIZE];	//states[elemidx] is occured at times[elemidx]
 	int size;	//size of nugget
 	uint64_t sector;	//sector number of bit who was requested. is it really need?
+	uint32_t device;
 	uint32_t pid;
 	struct dio_nugget* mlink;	//if it was merged, than mlink points the other nugget
+	struct rb_node endlink;		//link of end sector index while it is active
 	int ngflag;
 	int idxCPU;
 };
 
-// list node of blk_io_trace
-// it just maintain the time ordered bits
-struct bit_entity{
-	struct list_head link;
-	
-	struct blk_io_trace bit;
+// dio_ngtable is an open addressing hash table of the active nuggets.
+// a nugget lives here from its first event until it is completed or merged,
+// so the table stays as small as the number of requests in flight.
+// slots are probed linearly and deletion shifts the following slots back,
+// so there is no tombstone.
+#define NGTABLE_INIT_SIZE	1024
+struct dio_ngslot{
+	uint64_t sector;
+	uint32_t device;
+	struct dio_nugget* pdng;	//NULL means empty slot
 };
 
-struct data_time
-{
-	unsigned int total_time;
-	unsigned int count;
-	unsigned int average_time;
+struct dio_ngtable{
+	struct dio_ngslot* slots;
+	unsigned int mask;	//number of slots - 1
+	unsigned int cnt;	//number of used slots
+};
+
+// dio_arena hands out the memory of nuggets and secentities from big blocks.
+// each shard has its own arena, so building threads never contend in malloc
+// and all of the blocks are freed at once
+#define ARENA_BLOCK_SIZE	(1024*1024)
+struct dio_arena_block{
+	struct dio_arena_block* next;
+	size_t used;
+	char data[];
+};
+
+struct dio_arena{
+	struct dio_arena_block* head;
+};
+
+// dio_shard builds the nuggets of the sectors it owns.
+// sectors are cut in chunks of (1 << SHARD_CHUNK_SHIFT) and chunk i is owned by
+// shard (i % shard_cnt). requests of different chunks never meet except the merges
+// at chunk boundaries, so shards are built in parallel and the merges which
+// couldn't be resolved in a shard are reconciled after all shards are built.
+#define SHARD_CHUNK_SHIFT	11	//1MB chunk of 512 byte sectors
+#define MAX_SHARD		64
+#define SHARD_OF(sector)	(((sector) >> SHARD_CHUNK_SHIFT) % shard_cnt)
+#define MAX_REQ_SECTORS		65536	//limit of searching back merged request
+
+// merged bio whose request was not in the shard of the bio.
+// a front merge also moves the request into the shard of the bio. the shard of
+// the request retires it as pending and the shard of the bio keeps a stand-in
+// for it, which takes the states of the request until they are reconciled
+struct dio_pending_merge{
+	struct dio_nugget* pdng;	//nugget of the merged bio
+	struct dio_nugget* pstandin;	//stand-in of the front merged request
+	int bytes;			//bytes of the merged bio
+	uint64_t time;			//when it was merged
+};
+
+// dio_spsc is a lock-free ring queue between one producer thread and one consumer thread.
+// the producer only writes 'tail' and the consumer only writes 'head',
+// so the threads share nothing else but the slots between them.
+// a side which waits for the other spins a little and then sleeps on its futex
+// word, which the other side clears when it moves
+struct dio_spsc{
+	void** items;
+	size_t mask;	//number of slots - 1
+	size_t head __attribute__((aligned(64)));	//next slot to pop
+	int push_sleep;					//the producer sleeps on a full ring
+	size_t tail __attribute__((aligned(64)));	//next slot to push
+	int pop_sleep;					//the consumer sleeps on an empty ring
+};
+
+struct dio_shard{
+	pthread_t td;
+	struct dio_spsc bitq;		//bits from the sorter
 
-	unsigned int min_time;
-	unsigned int max_time;
+	struct bptree sec_index;	//secentities order by sector
+	struct dio_ngtable active_ngs;	//nuggets in flight
+	struct rb_root endidx_root;	//nuggets in flight order by end sector
+	struct dio_arena arena;		//memory of nuggets and secentities
+
+	struct dio_pending_merge* pendings;
+	size_t pending_cnt;
+	size_t pending_max;
+
+	bool failed;
+};
+
+// iterator of the sector indexes of all shards in sector order
+struct dio_secwalk{
+	struct bpt_iter itrs[MAX_SHARD];
+	uint64_t end;		//last sector to walk
+	int cur;		//shard which is walked now
+	uint64_t chunk_end;	//first sector after the chunk which is walked now
+};
+
+// dioparse ingests the input as a pipeline of threads joined by dio_spsc queues.
+//   reader   : cuts the file in blocks at bit boundaries
+//   decoders : filter the bits of a block and sort them by time (a run)
+//   sorter   : merges the runs as they come, and at the end of the file
+//              streams the last merge to the shards and the bit statistics
+//   shards   : build the nuggets of their sectors
+// blocks are dealt to the decoders round-robin and collected in the same order,
+// so bits of the same time keep the order of the file.
+#define INGEST_BLOCK_SIZE	(4*1024*1024)
+#define DECODER_INQ_SIZE	4
+#define DECODER_OUTQ_SIZE	16
+#define SHARD_BITQ_SIZE		4096
+#define SPSC_SPIN		64	//reads of the other side before yielding the cpu
+#define SPSC_YIELD		16	//yields of the cpu before sleeping
+#define MAX_RUN			64
+#define DECODE_BATCH		256	//bits given to the filter kernel at once
+
+// dio_resync keeps the reader on the bits of a broken input.
+// a bit is valid if it has the magic and version, and its pdu is not too long.
+// after an invalid one, bytes are skipped until a valid bit is proved by its
+// sequence going up from the last bit of its cpu, or by a valid bit next to it.
+// each byte is tried only once, so broken bytes cost no more than the good ones.
+#define MAX_PDU_LEN		1024
+#define RESYNC_MAX_CPU		1024
+#define MAX_SKIP_REPORT		16
+struct dio_resync{
+	uint32_t next_seq[RESYNC_MAX_CPU];	//last sequence + 1 of each cpu, 0 if not seen
+	bool skipping;
+	uint64_t skip_off;	//offset in the file where the skipping began
+	uint64_t skip_len;
+	uint64_t skip_total;
+	int skip_cnt;
+};
+
+// dio_block is a piece of the input file.
+// its bits stay alive until the program ends because the nuggets and
+// the time ordered bit array point them.
+struct dio_block{
+	struct dio_block* next;		//all blocks are chained for freeing
+	char* raw;			//raw data read from the file
+	size_t rawlen;
+	uint64_t off;			//offset of raw in the file
+	size_t filelen;			//length of raw in the file with the broken bytes
+	struct dio_zone zone;		//made by the decoder when the index is built
+	struct col_group_header* pcol;	//header of the row group if the input is columnar
+	struct blk_io_trace* bits;	//filtered bits in file order
+	struct blk_io_trace** run;	//bits order by time
+	size_t cnt;
+};
+
+struct dio_decoder{
+	pthread_t td;
+	struct dio_spsc inq;	//raw blocks from the reader
+	struct dio_spsc outq;	//sorted blocks to the sorter
+};
+
+// time ordered bits which are not merged yet
+struct dio_run{
+	struct blk_io_trace** bits;
+	size_t cnt;
 };
 
 struct dio_nugget_path
 {
-	struct list_head link;
-
 	int elemidx;
 	char states[MAX_ELEMENT_SIZE];
 
-	struct data_time data_time_read;
-	struct data_time data_time_write;
+	struct dio_hist hist_read;
+	struct dio_hist hist_write;
 
-	struct data_time* data_time_interval_read;
-	struct data_time* data_time_interval_write;
+	struct dio_hist* hist_interval_read;	//hist_interval_xxx[i] is from states[i] to states[i+1]
+	struct dio_hist* hist_interval_write;
 };
 
+#define MAX_CPU_NUM 128
 struct dio_cpu
 {
 	int r_cnt;
@@ -128,120 +256,495 @@ struct dio_cpu
 };
 
 // statistic initialize function.
-typedef void(*statistic_init_func)(void);
+// it returns a new partial state. every statistic thread has its own one
+typedef void*(*statistic_init_func)(void);
 
 // statistic traveling function. 
-// rb traveling function will be given the each nugget as a parameter
-typedef void(*statistic_travel_func)(struct dio_nugget*);
+// sector traveling function will be given the partial state and each nugget
+typedef void(*statistic_travel_func)(void*, struct dio_nugget*);
 
 // statistic iterating function.
-// list iterating function will be given the each bit as a parameter
-typedef void(*statistic_itr_func)(struct blk_io_trace*);
+// bit iterating function will be given the partial state and each bit
+typedef void(*statistic_itr_func)(void*, struct blk_io_trace*);
+
+// partial state merging function.
+// the second state is merged into the first one and freed.
+// the first one always comes earlier in the order of traversal
+typedef void(*statistic_merge_func)(void*, void*);
 
 // data process function.
-typedef void(*statistic_process_func)(int);
+// it is given the merged state and the number of nuggets or bits, and frees the state
+typedef void(*statistic_process_func)(void*, int);
+
+// dio_stat is a registered statistic.
+// the nuggets (or bits) are divided among the statistic threads in the order of
+// traversal, so the merged state is the same as one thread would make
+struct dio_stat{
+	struct list_head link;
+	statistic_init_func init_fn;
+	union{
+		statistic_travel_func trv_fn;
+		statistic_itr_func itr_fn;
+	};
+	statistic_merge_func merge_fn;
+	statistic_process_func proc_fn;
+};
 
-#define MAX_STATISTIC_FUNCTION 10
+// a statistic thread and its partial states, one for each statistic
+struct dio_stat_worker{
+	pthread_t td;
+	void** parts;
+	uint64_t start;		//nugget: first sector, bit: first index
+	uint64_t end;		//nugget: last sector, bit: index after the last
+	int cnt;		//number of nuggets or bits traveled
+};
 
 /*--------------	function interfaces	-----------------------*/
 /* function for option handling */
 bool parse_args(int argc, char** argv);
 void check_stat_opt(char *str);
 
-/* function for bit list */
-// insert bit_entity data into rbiten_head order by time
-static void insert_proper_pos(struct bit_entity* pbiten);
+/* function for ingest pipeline */
+static bool spsc_init(struct dio_spsc* pq, size_t size);
+static void spsc_destroy(struct dio_spsc* pq);
+static void spsc_push(struct dio_spsc* pq, void* item);
+static void* spsc_pop(struct dio_spsc* pq);
+
+// wait a little for the other side. false means that the caller should sleep
+static bool spsc_spin(int* pspin);
+
+// sleep while the word is 1, and wake the sleepers on the word.
+// a waker stores what the sleepers wait for before it wakes them
+static void futex_sleep(int* pword);
+static void futex_wake(int* pword);
+
+// body of the reader thread. NULL is sent to all decoders at the end of file
+static void* read_blocks(void* param);
+
+// body of the reader thread which reads only the blocks of 'zones' matching the filter
+static void* read_zone_blocks(void* param);
+
+// body of the reader thread for the columnar input. groups out of the filter are skipped
+static void* read_col_groups(void* param);
+
+// write the raw input to the columnar file 'path'
+static bool convert_trace(int ifd, const char* path);
+
+// find the byte order of the raw input from the magics in its head.
+// false is returned if they are not the bits of blktrace
+static bool check_byte_order(int ifd);
+
+// pack the valid bits of 'buf' at its front, skipping the broken bytes.
+// 'pos' is the offset of 'buf' in the file and 'eof' tells no data follows 'buf'.
+// the length of packed bits is returned through 'pvalid', and the return is
+// the length used. the bytes after it are given again with the next data
+static size_t pack_bits(struct dio_resync* prs, char* buf, size_t len, uint64_t pos, bool eof, size_t* pvalid);
+
+// report the total of skipped bytes
+static void resync_done(struct dio_resync* prs);
+
+// body of a decoder thread
+static void* decode_blocks(void* param);
+
+// run the whole pipeline on the input file.
+// when it returns, 'time_bits' has all the bits order by time
+// and the shards have built their nuggets
+static bool ingest_bits(int ifd);
+
+// merge two runs into a new one. bits of 'older' go first at the same time
+static bool merge_runs(struct dio_run* older, struct dio_run* newer, struct dio_run* merged);
 
-/* function for rbentity */
-//initialize dio_rbentity
-static void init_rbentity(struct dio_rbentity* prben);
-static struct dio_rbentity* rb_search_entity(uint64_t sector);
-static struct dio_rbentity* rb_search_end(uint64_t sec_t);
-static struct dio_rbentity* __rb_insert_entity(struct dio_rbentity* prben);
-static struct dio_rbentity* rb_insert_entity(struct dio_rbentity* prben);
+// k-way merge the runs into 'time_bits' and feed the shards on the way
+static void stream_runs(struct dio_run* runs, int run_cnt);
+
+/* function for secentity */
+//initialize dio_secentity
+static void init_secentity(struct dio_secentity* psecen);
 
 /* function for nugget */
 static void init_nugget(struct dio_nugget* pdng);
-static void copy_nugget(struct dio_nugget* destng, struct dio_nugget* srcng);
-static struct dio_nugget* FRONT_NUGGET(struct list_head* png_head);
 
-// it return a valid nugget point even if inserted 'sector' doesn't existed in rbtree
-// if NULL value is returned, reason is a problem of inserting the new rbentity 
+// append the states of 'srcng' at the end of 'destng'
+static void append_nugget(struct dio_nugget* destng, struct dio_nugget* srcng);
+
+/* function for active nugget table */
+static bool ngtable_init(struct dio_ngtable* ptbl, unsigned int size);
+static void ngtable_destroy(struct dio_ngtable* ptbl);
+static struct dio_nugget* ngtable_find(struct dio_ngtable* ptbl, uint32_t device, uint64_t sector);
+static bool ngtable_insert(struct dio_ngtable* ptbl, struct dio_nugget* pdng);
+static void ngtable_remove(struct dio_ngtable* ptbl, struct dio_nugget* pdng);
+
+/* function for end sector index */
+// active nuggets are also ordered by (device, end sector) so that a back merged
+// bio finds the request which ends where the bio starts.
+// the key of a nugget changes whenever it grows, so it is removed and inserted again
+#define NG_END_SECTOR(pdng)	((pdng)->sector + (pdng)->size/512)
+static void endidx_insert(struct dio_shard* psh, struct dio_nugget* pdng);
+static void endidx_remove(struct dio_shard* psh, struct dio_nugget* pdng);
+static struct dio_nugget* endidx_search(struct dio_shard* psh, uint32_t device, uint64_t end);
+
+/* function for arena */
+static void* arena_alloc(struct dio_arena* parena, size_t size);
+static void arena_destroy(struct dio_arena* parena);
+
+/* function for shard */
+static bool init_shard(struct dio_shard* psh);
+static void destroy_shard(struct dio_shard* psh);
+static void add_pending_merge(struct dio_shard* psh, struct dio_nugget* pdng, struct dio_nugget* pstandin, int bytes);
+
+// the request which the bio of other shard was front merged into starts at
+// the bio from now on. it is retired, so the later bits at its sector never find it
+static void retire_front_merged(struct dio_shard* psh, struct blk_io_trace* pbit);
+
+// the front merged request of other shard is built as a stand-in at the bio
+static struct dio_nugget* new_standin(struct dio_shard* psh, struct blk_io_trace* pbit);
+
+// build the nuggets of the bits in a shard. it is the body of shard thread
+static void* build_shard(void* param);
+
+// finish the shards after their threads are joined
+static bool finish_shards(void);
+
+// resolve the merges that the shards couldn't, in time order
+static void reconcile_shards(void);
+static void reconcile_back_merge(struct dio_pending_merge* ppm);
+static void reconcile_front_merge(struct dio_pending_merge* ppm);
+
+// walk the secentities of all shards in the sector range [start, end]
+static void secwalk_init(struct dio_secwalk* pwalk, uint64_t start, uint64_t end);
+static struct dio_secentity* secwalk_next(struct dio_secwalk* pwalk);
+
+// it return the active nugget of (device, sector) from the active nugget table.
+// if there isn't, a new nugget is created, linked at the secentity of 'sector'
+// and registered in the active nugget table.
+// if NULL value is returned, reason is a problem of inserting the new secentity 
 // or memory allocating the new nugget 
-static struct dio_nugget* get_nugget_at(uint64_t sector);
+static struct dio_nugget* get_nugget_at(struct dio_shard* psh, uint32_t device, uint64_t sector);
 
-// create active nugget on rbtree
-// if there isn't rbentity of sector number 'sector', than it create rbentity automatically
-// and return the pointer of created nugget
-static struct dio_nugget* create_nugget_at(uint64_t sector);
+// link the nugget at the secentity of 'sector'
+// if there isn't secentity of sector number 'sector', than it create secentity automatically
+static bool link_nugget_at(struct dio_shard* psh, struct dio_nugget* pdng, uint64_t sector);
 
-// delete active nugget from rbtree
-static void delete_nugget_at(uint64_t sector);
+// the nugget is not active anymore (completed or merged)
+static void retire_nugget(struct dio_shard* psh, struct dio_nugget* pdng);
 
-static void extract_nugget(struct blk_io_trace* pbit, struct dio_nugget* pdngbuf);
-static void handle_action(uint32_t act, struct dio_nugget* pdng);
+static void extract_nugget(struct dio_shard* psh, struct blk_io_trace* pbit, struct dio_nugget* pdngbuf);
+static void handle_action(struct dio_shard* psh, struct blk_io_trace* pbit, struct dio_nugget* pdng);
 
 // add the statistic callback functions
-static void add_nugget_stat_func(statistic_init_func stat_init_fn, 
+static bool add_nugget_stat_func(statistic_init_func stat_init_fn, 
 					statistic_travel_func stat_trv_fn,
+					statistic_merge_func stat_merge_fn,
 					statistic_process_func stat_proc_fn);
-static void add_bit_stat_func(statistic_init_func stat_init_fn,
+static bool add_bit_stat_func(statistic_init_func stat_init_fn,
 					statistic_itr_func stat_itr_fn,
+					statistic_merge_func stat_merge_fn,
 					statistic_process_func stat_proc_fn);
 
-// traveling the rb tree with execution the added statistic functions
-static void statistic_rb_traveling();
+// make the partial states of a worker
+static bool init_stat_worker(struct dio_stat_worker* pwk, struct list_head* stats, int stat_cnt);
+
+// merge the partial states of the workers in order and process them
+static void process_stat_workers(struct dio_stat_worker* pwks, int wk_cnt, struct list_head* stats);
+
+// cut the sector range in 'cnt' ranges which have similar number of secentities
+static void split_sector_range(uint64_t* bounds, int cnt);
+
+// traveling the sector index with execution the added statistic functions
+static void statistic_sector_traveling();
+static void* travel_sector_range(void* param);
 
-// statistic for each list entity
-static void statistic_list_for_each();
+// statistic for each bit in time order. it is the body of bit statistic thread
+// which follows the bits as the sorter publishes them
+static void* statistic_list_for_each(void* param);
+
+// process the results of bit statistics
+static void statistic_list_process();
 
 // print functions
-void print_data_time_statistic(FILE* stream, struct data_time* pdata_time);
+// latency columns of a histogram: count, average, p50, p90, p99, p99.9, max, min
+void print_hist_header(FILE* stream);
+void print_hist_statistic(FILE* stream, struct dio_hist* phist);
+
+// columns of a histogram in the emitted tables, and their values
+#define EMIT_HIST_COLS \
+	{ "count", EMIT_U64 }, { "mean_ns", EMIT_U64 }, { "p50_ns", EMIT_U64 }, { "p90_ns", EMIT_U64 }, \
+	{ "p99_ns", EMIT_U64 }, { "p99.9_ns", EMIT_U64 }, { "max_ns", EMIT_U64 }, { "min_ns", EMIT_U64 }
+void emit_hist(struct dio_hist* phist);
 
-void print_time();
-void print_sector();
+void print_time(void* part, int bit_cnt);
+void print_sector(void* part, int ng_cnt);
 
 // disk I/O type statistic (just count)
-void init_type_statistic();
-void itr_type_statistic(struct blk_io_trace* pbit);
-void process_type_statistic(int bit_cnt);
+struct type_stat{
+	int r_cnt;
+	int w_cnt;
+	int x_cnt;
+};
+void* init_type_statistic();
+void itr_type_statistic(void* part, struct blk_io_trace* pbit);
+void merge_type_statistic(void* dst, void* src);
+void process_type_statistic(void* part, int bit_cnt);
 
 // path statistic functions
+// state paths are interned in a trie of actions. a node is a prefix of paths,
+// and the node where a nugget ends has the id of its path in 'paths'.
+#define PATH_ACTION_CNT		(sizeof(BLK_ACTION_STRING))	//actions and '?'
+struct path_node
+{
+	int child[PATH_ACTION_CNT];	//0 if there isn't. the root is never a child
+	int pathid;			//-1 if no path ends here
+};
+struct path_stat
+{
+	struct path_node* nodes;
+	int node_cnt;
+	int node_max;
+	struct dio_nugget_path* paths;	//indexed by path id in the order they are found
+	int path_cnt;
+	int path_max;
+};
 int instr(const char* str1, const char* str2);
-struct dio_nugget_path* find_nugget_path(struct list_head* nugget_path_head, char* states);
-void init_path_statistic(void);
-void travel_path_statistic(struct dio_nugget* pdng);
-void process_path_statistic(int ng_cnt);
-void print_path_statistic_graphic(struct dio_nugget_path* pnugget_path);
+int intern_nugget_path(struct path_stat* pps, const char* states, int elemidx);
+void* init_path_statistic(void);
+void travel_path_statistic(void* part, struct dio_nugget* pdng);
+void merge_path_statistic(void* dst, void* src);
+void process_path_statistic(void* part, int ng_cnt);
+void chart_path_statistic(struct path_stat* pps);
 void print_path_statistic_text(struct dio_nugget_path* pnugget_path);
+void emit_path_statistic(struct dio_nugget_path* pnugget_path);
 
 // cpu statistic functions
-void create_diocpu(void);
-void init_cpu_statistic(void);
-void itr_cpu_statistic(struct blk_io_trace* pbit);
-void process_cpu_statistic(int bit_cnt);
-void print_cpu_statistic_graphic(void);
-void print_cpu_statistic_text(int bit_cnt);
+struct cpu_stat{
+	struct dio_cpu* diocpu;
+	int maxCPU;
+};
+void create_diocpu(struct cpu_stat* pcs);
+void* init_cpu_statistic(void);
+void itr_cpu_statistic(void* part, struct blk_io_trace* pbit);
+void merge_cpu_statistic(void* dst, void* src);
+void process_cpu_statistic(void* part, int bit_cnt);
+void chart_cpu_statistic(struct cpu_stat* pcs);
+void print_cpu_statistic_text(struct cpu_stat* pcs, int bit_cnt);
+void emit_cpu_statistic(struct cpu_stat* pcs, int bit_cnt);
+
+// latency of the nuggets by the cpu which completed them
+struct cpu_lat_stat{
+	struct dio_hist* hist_read[MAX_CPU_NUM];	//NULL until the cpu is seen
+	struct dio_hist* hist_write[MAX_CPU_NUM];
+};
+void* init_cpu_latency_statistic(void);
+void travel_cpu_latency_statistic(void* part, struct dio_nugget* pdng);
+void merge_cpu_latency_statistic(void* dst, void* src);
+void process_cpu_latency_statistic(void* part, int ng_cnt);
 
 // pid statistic functions
 struct pid_stat_data{
 	struct rb_node link;
 
 	uint32_t pid;
-        struct data_time data_time_read;
-        struct data_time data_time_write;
+	struct dio_hist hist_read;
+	struct dio_hist hist_write;
+};
+struct pid_stat{
+	struct rb_root psd_root;	//pid stat data root
 };
-static struct rb_root psd_root = RB_ROOT;	//pid stat data root
 
-static struct pid_stat_data* rb_search_psd(uint32_t pid);
-static struct pid_stat_data* __rb_insert_psd(struct pid_stat_data* newpsd);
-static struct pid_stat_data* rb_insert_psd(struct pid_stat_data* newpsd);
+static struct pid_stat_data* rb_search_psd(struct rb_root* psd_root, uint32_t pid);
+static struct pid_stat_data* __rb_insert_psd(struct rb_root* psd_root, struct pid_stat_data* newpsd);
+static struct pid_stat_data* rb_insert_psd(struct rb_root* psd_root, struct pid_stat_data* newpsd);
 static void __clear_pid_stat(struct rb_node* p);
-void init_pid_statistic();
-void travel_pid_statistic(struct dio_nugget* pdng);
-void process_pid_statistic(int ng_cnt);
-void print_pid_statistic_graphic(struct pid_stat_data* ppsd);
+void* init_pid_statistic();
+void travel_pid_statistic(void* part, struct dio_nugget* pdng);
+void merge_pid_statistic(void* dst, void* src);
+void process_pid_statistic(void* part, int ng_cnt);
+void chart_pid_statistic(struct pid_stat* pps);
 void print_pid_statistic_text(struct pid_stat_data* ppsd);
+void emit_pid_statistic(struct pid_stat_data* ppsd);
+
+// stage statistic functions
+#define STAGE_Q2G	0
+#define STAGE_G2I	1
+#define STAGE_I2D	2
+#define STAGE_D2C	3
+#define STAGE_Q2C	4
+#define STAGE_CNT	5
+struct stage_group{
+	struct rb_node link;
+
+	uint64_t key;	//pid, device or size class
+	struct dio_hist hists[STAGE_CNT];
+};
+struct stage_stat{
+	struct dio_hist all[STAGE_CNT];
+	struct rb_root pid_root;
+	struct rb_root dev_root;
+	struct rb_root size_root;
+};
+
+static int64_t find_stage_time(struct dio_nugget* pdng, int stage);
+static struct stage_group* get_stage_group(struct rb_root* root, uint64_t key);
+void* init_stage_statistic();
+void travel_stage_statistic(void* part, struct dio_nugget* pdng);
+void merge_stage_statistic(void* dst, void* src);
+void process_stage_statistic(void* part, int ng_cnt);
+
+// timeline statistic functions
+#define TIMELINE_DEFAULT_WIDTH	10000000	//10ms
+struct timeline_bucket{
+	uint32_t r_cnt;
+	uint32_t w_cnt;
+	uint64_t r_bytes;
+	uint64_t w_bytes;
+	uint32_t lat_cnt;
+	uint64_t lat_total;
+	uint64_t depth_time;	//sum of the time of nuggets in the device (D to C)
+};
+// latency of a completed nugget and its bucket
+struct timeline_lat{
+	uint64_t lat;
+	uint32_t bkt;
+};
+struct timeline_stat{
+	uint64_t base;		//start time of bucket 0
+	uint64_t width;		//of a bucket
+	struct timeline_bucket* bkts;
+	size_t bkt_cnt;
+	size_t bkt_max;
+	struct timeline_lat* lats;
+	size_t lat_cnt;
+	size_t lat_max;
+};
+
+uint64_t parse_time_width(const char* str);
+void* init_timeline_statistic();
+void travel_timeline_statistic(void* part, struct dio_nugget* pdng);
+void merge_timeline_statistic(void* dst, void* src);
+void process_timeline_statistic(void* part, int ng_cnt);
+
+// timeline pyramid functions
+#define PYRAMID_BASE_WIDTH	1000000		//1ms at level 0
+#define PYRAMID_FACTOR		10		//a bucket has 10 buckets of the level below
+void* init_pyramid_statistic();
+void process_pyramid_statistic(void* part, int ng_cnt);
+
+// queue depth statistic functions
+enum { DEPTH_D2C, DEPTH_Q2C, DEPTH_KIND_CNT };
+// a nugget enters (+1) or leaves (-1) the device or the block layer
+struct depth_edge{
+	uint64_t time;
+	uint32_t device;
+	uint8_t kind;
+	int8_t delta;
+};
+struct depth_stat{
+	struct depth_edge* edges;
+	size_t edge_cnt;
+	size_t edge_max;
+};
+// result of sweeping the edges of a device
+struct depth_sweep{
+	uint64_t* time_at;	//time spent at each depth
+	int time_max;
+	int max_depth;
+	uint64_t area;		//sum of depth * time
+	uint64_t busy;		//time of depth > 0
+};
+
+void* init_depth_statistic();
+void travel_depth_statistic(void* part, struct dio_nugget* pdng);
+void merge_depth_statistic(void* dst, void* src);
+void process_depth_statistic(void* part, int ng_cnt);
+
+// top statistic functions
+#define TOP_DEFAULT_CNT		100
+#define TOP_MAX_CNT		1000000
+struct top_entry{
+	uint64_t lat;		//Q2C
+	struct dio_nugget* pdng;
+};
+// min-heap of the slowest nuggets, so the fastest of them is replaced first
+struct top_stat{
+	struct top_entry* heap;
+	size_t cnt;
+};
+
+void* init_top_statistic();
+void travel_top_statistic(void* part, struct dio_nugget* pdng);
+void merge_top_statistic(void* dst, void* src);
+void process_top_statistic(void* part, int ng_cnt);
+
+// the key of an extent or a block in the sketches has the device (major
+// in 12 bits and minor in 20 bits) in the top 32 bits and the index in the
+// rest, so the 4KB blocks of devices up to 16TB are told apart
+#define DEV_KEY_INDEX_BITS	32
+static inline uint64_t dev_index_key(uint32_t device, uint64_t idx){
+	return ((uint64_t)device << DEV_KEY_INDEX_BITS) | (idx & ((1ULL << DEV_KEY_INDEX_BITS) - 1));
+}
+
+// hotspot statistic functions
+#define HOTSPOT_DEFAULT_EXTENT	(1024*1024)
+#define HOTSPOT_MIN_EXTENT	4096	//the index of an extent fits the key up to 16TB
+#define HOTSPOT_TOP_CNT		20
+struct hotspot_stat{
+	struct count_min cm_ios;
+	struct count_min cm_bytes;
+	struct space_saving ss_ios;
+	struct space_saving ss_bytes;
+};
+
+uint64_t parse_byte_size(const char* str);
+void* init_hotspot_statistic();
+void travel_hotspot_statistic(void* part, struct dio_nugget* pdng);
+void merge_hotspot_statistic(void* dst, void* src);
+void process_hotspot_statistic(void* part, int ng_cnt);
+
+// working set statistic functions
+#define WS_DEFAULT_WIDTH	60000000000ULL	//1 minute
+#define WS_BLOCK_SIZE		4096
+enum { WS_READ, WS_WRITE, WS_RW_CNT };
+// distinct blocks of a time window or a pid
+struct ws_sketch{
+	struct rb_node link;	//of a pid
+
+	uint64_t key;
+	struct hyperloglog hlls[WS_RW_CNT];
+};
+struct ws_stat{
+	uint64_t base;
+	struct ws_sketch** windows;
+	size_t win_cnt;
+	struct rb_root pid_root;
+};
+
+void* init_ws_statistic();
+void travel_ws_statistic(void* part, struct dio_nugget* pdng);
+void merge_ws_statistic(void* dst, void* src);
+void process_ws_statistic(void* part, int ng_cnt);
+
+// cache simulation functions
+#define CACHE_DEFAULT_RATE	0.01
+#define CACHE_BLOCK_SIZE	4096
+#define CACHE_MIN_SIZE		256	//blocks of the smallest cache simulated
+#define CACHE_MAX_SIZES		40
+// a completed reference of a sampled block
+struct cache_ref{
+	uint64_t time;
+	uint64_t block;
+	uint8_t is_read;
+};
+struct cache_stat{
+	struct cache_ref* refs;
+	size_t cnt;
+	size_t max;
+	uint64_t all_cnt;	//references of all blocks, sampled or not
+	uint64_t all_reads;
+};
+
+void* init_cache_statistic();
+void travel_cache_statistic(void* part, struct dio_nugget* pdng);
+void merge_cache_statistic(void* dst, void* src);
+void process_cache_statistic(void* part, int ng_cnt);
 
 /*--------------	global variables	-----------------------*/
 #define MAX_FILEPATH_LEN 255
@@ -256,25 +759,58 @@ static uint64_t time_end;
 static uint64_t sector_start;
 static uint64_t sector_end;
 static uint64_t filter_pid;
+static struct dio_filter bit_filter;	/* filters above for the filter kernels */
+static struct dio_expr* bit_expr;	/* filter expression, NULL if there isn't */
 static bool is_graphic;
 static bool is_path;
 static bool is_pid;
 static bool is_cpu;
-
-
-static struct rb_root rben_root;	//root of rbentity tree
-static struct list_head biten_head;
-
-static statistic_init_func stat_init_fns[MAX_STATISTIC_FUNCTION];
-static statistic_travel_func stat_trv_fns[MAX_STATISTIC_FUNCTION];
-static statistic_itr_func stat_itr_fns[MAX_STATISTIC_FUNCTION];
-static statistic_process_func stat_proc_fns[MAX_STATISTIC_FUNCTION];
-static int stat_fn_cnt = 0;		//statistic callback functions iterated on tree
-static int stat_fn_list_cnt = 0;	//statistic callback functions iterated on list.
-					//callback function for list is filled from the 
-					//last index of callback table
-
-#define ARG_OPTS "i:o:p:T:S:P:s:g:h"
+static bool is_stage;
+static bool is_timeline;
+static bool is_depth;
+static bool is_top;
+static bool is_hotspot;
+static bool is_ws;
+static bool is_cache;
+static bool is_index;			/* build the index of the input */
+static struct dio_zone* zones;		/* index of the input, or the index being built */
+static size_t zone_cnt;
+static bool is_col_input;		/* the input is a columnar file */
+static bool is_swapped;			/* the input is in the other byte order */
+static char* convpath;			/* convert the input to this columnar file */
+static uint64_t timeline_width;		/* in nanoseconds */
+static size_t top_cnt;			/* nuggets reported by -s top */
+static uint64_t hotspot_extent;		/* in bytes */
+static uint64_t ws_width;		/* window of -s workingset in nanoseconds */
+static double cache_rate;		/* sampling rate of the blocks of -s cache */
+static enum emit_format out_format;	/* results are emitted in this format unless it is text */
+static struct dio_emitter emitter;
+static const char* chart_dir = ".";	/* directory of the charts of -g */
+static const char* pyrpath;		/* write the timeline pyramid to this file */
+
+
+static struct dio_shard shards[MAX_SHARD];
+static int shard_cnt;
+static struct dio_decoder decoders[MAX_SHARD];
+static int decoder_cnt;
+static struct dio_block* block_head;	//all blocks of the input
+static bool ingest_failed;		//set by the reader and decoders with __atomic
+static int col_group_cnt;		//row groups of the column input
+static int col_broken_cnt;		//row groups skipped for broken bytes
+
+static struct blk_io_trace** time_bits;	//all bits order by time
+static size_t time_bit_cnt;
+static size_t time_bit_pub;		//bits published to the bit statistics
+static int time_bit_sleep;		//futex word of the bit statistics waiting for bits
+
+static LIST_HEAD(nugget_stats);		//statistics traveled on sector index
+static LIST_HEAD(bit_stats);		//statistics iterated on time ordered bits
+static int nugget_stat_cnt = 0;
+static int bit_stat_cnt = 0;
+static int stat_worker_cnt;
+static struct dio_stat_worker bit_workers[MAX_SHARD];
+
+#define ARG_OPTS "i:o:p:T:S:P:F:s:gj:h"
 static struct option arg_opts[] = {
 	{	
 		.name = "resfile",
@@ -312,6 +848,12 @@ static struct option arg_opts[] = {
 		.flag = NULL,
 		.val = 'P'
 	},
+	{
+		.name = "filter",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'F'
+	},
 	{
 		.name = "statistic",
 		.has_arg = required_argument,
@@ -324,6 +866,42 @@ static struct option arg_opts[] = {
 		.flag = NULL,
 		.val = 'g'
 	},
+	{
+		.name = "threads",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'j'
+	},
+	{
+		.name = "index",
+		.has_arg = no_argument,
+		.flag = NULL,
+		.val = 'x'
+	},
+	{
+		.name = "convert",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'c'
+	},
+	{
+		.name = "format",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'f'
+	},
+	{
+		.name = "chart-dir",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'G'
+	},
+	{
+		.name = "pyramid",
+		.has_arg = required_argument,
+		.flag = NULL,
+		.val = 'y'
+	},
 	{
 		.name = "help",
 		.has_arg = no_argument,
@@ -339,13 +917,19 @@ static char opt_detail[] = "\n"\
 			"\t-T : Time filter option\n"\
 			"\t-S : Sector filter option\n"\
 			"\t-P : Pid filter option\n"\
-			"\t-s : Statistic option. It can have three suboptions \'path\', \'pid\' and \'cpu\'\n"\
-			"\t-g : Show statistic results graphically.\n\n";
+			"\t-F : Filter expression like \"pid in (123,456) && bytes >= 64K && rw == W && time in [12.5s, 14s]\"\n"\
+			"\t-s : Statistic option. It can have suboptions \'path\', \'pid\', \'cpu\', \'stage\', \'timeline[=10ms]\', \'depth\', \'top[=100]\', \'hotspots[=1M]\', \'workingset[=60s]\' and \'cache[=0.01]\'\n"\
+			"\t-g : Draw statistic results as SVG charts instead of text.\n"\
+			"\t-j : Number of threads decoding bits, building nuggets and running statistics. Sectors are sharded among them.\n"\
+			"\t--index : Build the sidecar index <input>.idx. Later runs with -T, -S or -P read only the blocks which can match.\n"\
+			"\t--convert : Convert the input to a columnar file which can be given to -i for faster parses, and exit.\n"\
+			"\t--chart-dir : Directory where -g writes the SVG charts. It is the current directory by default.\n"\
+			"\t--pyramid : Write the timeline at 1ms, 10ms, 100ms, ... to the file and its viewer to <file>.html\n"\
+			"\t--format : Output format of the results. It can be \'text\' (default), \'json\', \'csv\' or \'bin\'\n\n";
 
 /*--------------	function implementations	---------------*/
 int main(int argc, char** argv){
-	INIT_LIST_HEAD(&biten_head);
-	rben_root = RB_ROOT;
+	shard_cnt = 1;
 
 	print_type = PRINT_TYPE_TIME;
 	time_start = 0;
@@ -357,129 +941,175 @@ int main(int argc, char** argv){
 	is_path = false;
 	is_cpu = false;
 	is_pid = false;
+	is_stage = false;
+	is_timeline = false;
+	is_depth = false;
+	is_top = false;
+	is_hotspot = false;
+	is_ws = false;
+	is_cache = false;
+	is_index = false;
+	timeline_width = TIMELINE_DEFAULT_WIDTH;
+	top_cnt = TOP_DEFAULT_CNT;
+	hotspot_extent = HOTSPOT_DEFAULT_EXTENT;
+	ws_width = WS_DEFAULT_WIDTH;
+	cache_rate = CACHE_DEFAULT_RATE;
 
 
 	int ifd = -1;
-	int rdsz = 0;
-	char pdubuf[256];
+	int i = 0;
+	struct dio_block* pblk = NULL;
+	struct stat ist;
+	char idxpath[MAX_FILEPATH_LEN + sizeof(DIO_INDEX_SUFFIX)];
+	char magic[8];
 
 	strncpy(respath, "dioshark.output", MAX_FILEPATH_LEN);
 
 	parse_args(argc, argv);
+	bit_filter.time_start = time_start;
+	bit_filter.time_end = time_end;
+	bit_filter.sector_start = sector_start;
+	bit_filter.sector_end = sector_end;
+	bit_filter.pid = filter_pid;
+	filter_init();
+
+	//the ranges which the expression needs are used to skip blocks and bits early
+	if( bit_expr != NULL ){
+		expr_narrow_filter(bit_expr, &bit_filter);
+		time_start = bit_filter.time_start;
+		time_end = bit_filter.time_end;
+		sector_start = bit_filter.sector_start;
+		sector_end = bit_filter.sector_end;
+		filter_pid = bit_filter.pid;
+	}
+	decoder_cnt = shard_cnt;
+	stat_worker_cnt = shard_cnt;
+	for(i=0; i<shard_cnt; i++){
+		if( !init_shard(&shards[i]) ){
+			perror("failed to initialize shard");
+			goto err;
+		}
+	}
+
 	ifd = open(respath, O_RDONLY);
-	if( ifd < 0 ){
+	if( ifd < 0 || fstat(ifd, &ist) < 0 ){
 		perror("failed to open result file");
 		goto err;
 	}
-	
-	struct bit_entity* pbiten = NULL;
-	struct dio_nugget* pdng = NULL;
 
-	int i = 0;
-	while(1){
-		if( pbiten == NULL ){
-			pbiten = (struct bit_entity*)malloc(sizeof(struct bit_entity));
-			if( pbiten == NULL ){
-				perror("failed to allocate memory");
-				goto err;
-			}
-		}
+	//groups of the columnar input have their own zones
+	is_col_input = (pread(ifd, magic, sizeof(magic), 0) == sizeof(magic) &&
+			!memcmp(magic, DIO_COLUMN_MAGIC, sizeof(magic)));
+	if( !is_col_input && !check_byte_order(ifd) ){
+		printf("%s is not a trace of version %d\n", respath, BLK_IO_TRACE_VERSION);
+		goto err;
+	}
 
-		rdsz = read(ifd, &(pbiten->bit), sizeof(struct blk_io_trace));
-		if( rdsz < 0 ){
-			perror("failed to read");
+	if( convpath != NULL ){
+		if( is_col_input ){
+			printf("%s is converted already\n", respath);
 			goto err;
 		}
-		else if( rdsz == 0 ){
-			break;
-		}
-
-		//BE_TO_LE_BIT(pbiten->bit);
-
-		//DBGOUT(">pdu_len : %d\n", pbiten->bit.pdu_len);
-		if( pbiten->bit.pdu_len > 0 ){
-			//rdsz = read(ifd, pdubuf, pbiten->bit.pdu_len);
-			//pdubuf[rdsz] = '\0';
-			//DBGOUT(">pdu data : %s\n", pdubuf);
-			lseek(ifd, pbiten->bit.pdu_len, SEEK_CUR);
-		}
-		
-		//filter
-		if( (time_start > pbiten->bit.time || time_end < pbiten->bit.time) ||
-			(sector_start > pbiten->bit.sector || sector_end < pbiten->bit.sector) )
-			continue;
-		if( filter_pid !=(uint64_t)(-1) && filter_pid != pbiten->bit.pid )
-			continue;
-
-		if( (pbiten->bit.action >> BLK_TC_SHIFT) == BLK_TC_NOTIFY )
-			continue;
-			
-		//insert into list order by time
-		insert_proper_pos(pbiten);
-
-		pbiten = NULL;
-	}
-
-	//build up the rbtree order by number of sector
-	struct bit_entity* p = NULL;
-	uint64_t recentsect = 0;
-	list_for_each_entry(p, &biten_head, link){
-#if 0
-		if( p->bit.sector != 0 )
-			recentsect = p->bit.sector;
-#endif
-		
-		pdng = get_nugget_at(p->bit.sector);
-
-		if( pdng == NULL ){
-			DBGOUT(">failed to get nugget at sector %llu\n", p->bit.sector);
+		if( !convert_trace(ifd, convpath) ){
+			perror("failed to convert");
 			goto err;
 		}
-		extract_nugget(&p->bit, pdng);
+		close(ifd);
+		return 0;
+	}
+	if( is_col_input && is_index ){
+		printf("--index is not needed for a columnar input\n");
+		is_index = false;
 	}
 
-
+	//a filtered parse reads only the blocks in the index which can match
+	snprintf(idxpath, sizeof(idxpath), "%s%s", respath, DIO_INDEX_SUFFIX);
+	if( !is_index && !is_col_input && (time_start != 0 || time_end != (uint64_t)(-1) ||
+		sector_start != 0 || sector_end != (uint64_t)(-1) || filter_pid != (uint64_t)(-1)) )
+		zones = read_index(idxpath, &ist, &zone_cnt);
 
 	if(output==NULL) {
 		output = stdout;
 	}
+	emit_begin(&emitter, output, out_format);
 
+	//bit statistics run while the nuggets are built, so add them first
 	if(print_type == PRINT_TYPE_TIME) {
-		add_bit_stat_func(NULL, NULL, print_time);
+		add_bit_stat_func(NULL, NULL, NULL, print_time);
 	} else if(print_type == PRINT_TYPE_SECTOR) {
-		add_nugget_stat_func(NULL, NULL, print_sector);
+		add_nugget_stat_func(NULL, NULL, NULL, print_sector);
 	}
 
 	//statistics
-	add_bit_stat_func(init_type_statistic, itr_type_statistic, process_type_statistic);
+	add_bit_stat_func(init_type_statistic, itr_type_statistic, merge_type_statistic, process_type_statistic);
 
 	if(is_path)
-		add_nugget_stat_func(init_path_statistic, travel_path_statistic, process_path_statistic);
-	if(is_cpu)
-		add_bit_stat_func(init_cpu_statistic, itr_cpu_statistic, process_cpu_statistic);
+		add_nugget_stat_func(init_path_statistic, travel_path_statistic, merge_path_statistic, process_path_statistic);
+	if(is_cpu){
+		add_bit_stat_func(init_cpu_statistic, itr_cpu_statistic, merge_cpu_statistic, process_cpu_statistic);
+		add_nugget_stat_func(init_cpu_latency_statistic, travel_cpu_latency_statistic,
+					merge_cpu_latency_statistic, process_cpu_latency_statistic);
+	}
 	if(is_pid)
-		add_nugget_stat_func(init_pid_statistic, travel_pid_statistic, process_pid_statistic);
+		add_nugget_stat_func(init_pid_statistic, travel_pid_statistic, merge_pid_statistic, process_pid_statistic);
+	if(is_stage)
+		add_nugget_stat_func(init_stage_statistic, travel_stage_statistic, merge_stage_statistic, process_stage_statistic);
+	if(is_timeline)
+		add_nugget_stat_func(init_timeline_statistic, travel_timeline_statistic, merge_timeline_statistic, process_timeline_statistic);
+	if(pyrpath != NULL)
+		add_nugget_stat_func(init_pyramid_statistic, travel_timeline_statistic, merge_timeline_statistic, process_pyramid_statistic);
+	if(is_depth)
+		add_nugget_stat_func(init_depth_statistic, travel_depth_statistic, merge_depth_statistic, process_depth_statistic);
+	if(is_top)
+		add_nugget_stat_func(init_top_statistic, travel_top_statistic, merge_top_statistic, process_top_statistic);
+	if(is_hotspot)
+		add_nugget_stat_func(init_hotspot_statistic, travel_hotspot_statistic, merge_hotspot_statistic, process_hotspot_statistic);
+	if(is_ws)
+		add_nugget_stat_func(init_ws_statistic, travel_ws_statistic, merge_ws_statistic, process_ws_statistic);
+	if(is_cache)
+		add_nugget_stat_func(init_cache_statistic, travel_cache_statistic, merge_cache_statistic, process_cache_statistic);
+
+	//read, sort and build up the nuggets order by number of sector
+	if( !ingest_bits(ifd) ){
+		fprintf(stderr, "failed to build nuggets\n");
+		goto err;
+	}
+	if( is_index && !write_index(idxpath, &ist, zones, zone_cnt) )
+		perror("failed to write index");
 
-	statistic_list_for_each();
-	statistic_rb_traveling();
+	statistic_list_process();
+	statistic_sector_traveling();
+	emit_end(&emitter);
 
 	//clean all list entities
 	if(output!=stdout){
 		fclose(output);
 	}
+	for(i=0; i<shard_cnt; i++)
+		destroy_shard(&shards[i]);
+	free(time_bits);
+	free(zones);
+	expr_free(bit_expr);
+	while( block_head != NULL ){
+		pblk = block_head->next;
+		free(block_head->bits);
+		free(block_head);
+		block_head = pblk;
+	}
+	close(ifd);
 
 	return 0;
 err:
-	if( ifd < 0 )
+	if( ifd >= 0 )
 		close(ifd);
-	if( pbiten != NULL )
-		free(pbiten);
-	return 0;
+	return 1;
 }
 
 bool parse_args(int argc, char** argv){
 	char tok;
 	char *p;
+	char experr[128];
+	int fmt;
 	
 	while( (tok = getopt_long(argc, argv, ARG_OPTS, arg_opts, NULL)) >= 0){
 	switch(tok){
@@ -519,6 +1149,14 @@ bool parse_args(int argc, char** argv){
 	case 'P':
 		filter_pid = (uint64_t)atoi(optarg);
 		break;
+	case 'F':
+		expr_free(bit_expr);
+		bit_expr = expr_compile(optarg, experr, sizeof(experr));
+		if(bit_expr == NULL) {
+			printf("-F Option Error : %s\n", experr);
+			exit(1);
+		}
+		break;
 	case 's':
 		p = strtok(optarg,",");
 		check_stat_opt(optarg);
@@ -532,8 +1170,35 @@ bool parse_args(int argc, char** argv){
 	case 'g':
 		is_graphic = true;
 		break;
+	case 'j':
+		shard_cnt = atoi(optarg);
+		if( shard_cnt < 1 || shard_cnt > MAX_SHARD ){
+			printf("-j Option Error\n");
+			exit(1);
+		}
+		break;
+	case 'x':
+		is_index = true;
+		break;
+	case 'c':
+		convpath = optarg;
+		break;
+	case 'G':
+		chart_dir = optarg;
+		break;
+	case 'y':
+		pyrpath = optarg;
+		break;
+	case 'f':
+		fmt = emit_parse_format(optarg);
+		if( fmt < 0 ){
+			printf("--format Option Error\n");
+			exit(1);
+		}
+		out_format = (enum emit_format)fmt;
+		break;
 	case 'h':
-		printf("USAGE : %s [ -i <input> ] [ -o <output> ] [-p <print> ] [ -T <time filter> ] [ -S <sector filter> ] [ -P <pid filter> ] [ -s <statistic> ] [ -g ]\n", argv[0]);
+		printf("USAGE : %s [ -i <input> ] [ -o <output> ] [-p <print> ] [ -T <time filter> ] [ -S <sector filter> ] [ -P <pid filter> ] [ -F <filter expression> ] [ -s <statistic> ] [ -g ] [ -j <threads> ] [ --index ] [ --convert <columnar file> ] [ --format <format> ] [ --chart-dir <dir> ] [ --pyramid <file> ]\n", argv[0]);
 		printf("%s", opt_detail);
 		exit(1);
 		break;
@@ -542,157 +1207,110 @@ bool parse_args(int argc, char** argv){
     return true;
 }
 void check_stat_opt(char *str) {
+	char* end = NULL;
+
 	if(!strcmp(str,"cpu"))
 		is_cpu = true;
 	else if(!strcmp(str,"path"))
 		is_path = true;
 	else if(!strcmp(str,"pid"))
 		is_pid = true;
-	else {
-		printf("-s Option Error\n");
-		exit(1);
+	else if(!strcmp(str,"stage"))
+		is_stage = true;
+	else if(!strcmp(str,"depth"))
+		is_depth = true;
+	else if(!strncmp(str,"timeline",8) && (str[8] == '\0' || str[8] == '=')) {
+		is_timeline = true;
+		if(str[8] == '=')
+			timeline_width = parse_time_width(str+9);
+		if(timeline_width == 0) {
+			printf("-s timeline Option Error\n");
+			exit(1);
+		}
 	}
-
-}
-void insert_proper_pos(struct bit_entity* pbiten){
-	struct list_head* p = NULL;
-	struct bit_entity* _pbiten = NULL;
-
-	//list foreach back
-	for(p = biten_head.prev; p != &(biten_head); p = p->prev){
-		_pbiten = list_entry(p, struct bit_entity, link);
-		if( _pbiten->bit.time <= pbiten->bit.time ){
-			list_add(&(pbiten->link), p);
-			return;
+	else if(!strncmp(str,"top",3) && (str[3] == '\0' || str[3] == '=')) {
+		is_top = true;
+		if(str[3] == '=') {
+			//strtoul takes "-1" as a huge count, so only digits are allowed
+			top_cnt = strtoul(str+4, &end, 10);
+			if(!isdigit((unsigned char)str[4]) || *end != '\0' || top_cnt > TOP_MAX_CNT)
+				top_cnt = 0;
+		}
+		if(top_cnt == 0) {
+			printf("-s top Option Error\n");
+			exit(1);
 		}
 	}
-	list_add(&(pbiten->link), &(biten_head));
-}
-
-static void init_rbentity(struct dio_rbentity* prben){
-	memset(prben, 0, sizeof(struct dio_rbentity));
-	INIT_LIST_HEAD(&prben->nghead);
-	prben->sector = 0;
-}
-
-static struct dio_rbentity* rb_search_entity(uint64_t sector){
-	struct rb_node* p = rben_root.rb_node;
-	struct dio_rbentity* prben = NULL;
-
-	while(p){
-		prben = rb_entry(p, struct dio_rbentity, rblink);
-		if( sector < prben->sector )
-			p = prben->rblink.rb_left;
-		else if( sector > prben->sector )
-			p = prben->rblink.rb_right;
-		else
-			return prben;
+	else if(!strncmp(str,"hotspots",8) && (str[8] == '\0' || str[8] == '=')) {
+		is_hotspot = true;
+		if(str[8] == '=')
+			hotspot_extent = parse_byte_size(str+9);
+		if(hotspot_extent < HOTSPOT_MIN_EXTENT || hotspot_extent % 512) {
+			printf("-s hotspots Option Error\n");
+			exit(1);
+		}
 	}
-	return NULL;
-}
-
-struct dio_rbentity* rb_search_end(uint64_t sec_t){
-	struct rb_node* p = rben_root.rb_node;
-	struct dio_rbentity* prben = NULL;
-	struct dio_nugget* actng = NULL;
-	uint64_t calcsect = 0;
-
-	while(p){
-		prben = rb_entry(p, struct dio_rbentity, rblink);
-		actng = FRONT_NUGGET(&prben->nghead);
-		if( prben->sector != actng->sector ){
-			DBGOUT("prben->sector != actng->sector\n");
-			return NULL;
+	else if(!strncmp(str,"workingset",10) && (str[10] == '\0' || str[10] == '=')) {
+		is_ws = true;
+		if(str[10] == '=')
+			ws_width = parse_time_width(str+11);
+		if(ws_width == 0) {
+			printf("-s workingset Option Error\n");
+			exit(1);
 		}
-		calcsect = actng->sector + actng->size/512;
-
-		if( sec_t < calcsect )
-			p = prben->rblink.rb_left;
-		else if( sec_t > calcsect )
-			p = prben->rblink.rb_right;
-		else
-			return prben;
 	}
-	return NULL;
-}
-
-struct dio_nugget* FRONT_NUGGET(struct list_head* png_head){
-	if( list_empty(png_head) )
-		DBGOUT(">>>>>>>>>>>>>>>> list empty\n");
-
-	return list_entry(png_head->next, struct dio_nugget, nglink);
-}
-
-static struct dio_rbentity* __rb_insert_entity(struct dio_rbentity* prben){
-	struct rb_node** p = &rben_root.rb_node;
-	struct rb_node* parent = NULL;
-	struct dio_rbentity* prbenbuf = NULL;
-
-	while(*p){
-		parent = *p;
-		prbenbuf = rb_entry(parent, struct dio_rbentity, rblink);
-
-		if( prben->sector < prbenbuf->sector )
-			p = &(*p)->rb_left;
-		else if( prben->sector > prbenbuf->sector )
-			p = &(*p)->rb_right;
-		else
-			return prbenbuf;	//there already exists
+	else if(!strncmp(str,"cache",5) && (str[5] == '\0' || str[5] == '=')) {
+		is_cache = true;
+		if(str[5] == '=') {
+			cache_rate = strtod(str+6, &end);
+			if(end == str+6 || *end != '\0')
+				cache_rate = 0;
+		}
+		if(!(cache_rate > 0 && cache_rate <= 1)) {
+			printf("-s cache Option Error\n");
+			exit(1);
+		}
+	}
+	else {
+		printf("-s Option Error\n");
+		exit(1);
 	}
 
-	rb_link_node(&(prben->rblink), parent, p);
-	return NULL;	//success
 }
-
-static struct dio_rbentity* rb_insert_entity(struct dio_rbentity* prben){
-	struct dio_rbentity* rbenret = NULL;
-	if( (rbenret = __rb_insert_entity(prben)) )
-		return rbenret;	//there already exists
-
-	rb_insert_color(&(prben->rblink), &(rben_root));
-	return NULL;	//insert successfully
+static void init_secentity(struct dio_secentity* psecen){
+	memset(psecen, 0, sizeof(struct dio_secentity));
+	INIT_LIST_HEAD(&psecen->nghead);
+	psecen->sector = 0;
 }
 
 void init_nugget(struct dio_nugget* pdng){
 	memset(pdng, 0, sizeof(struct dio_nugget));
+	RB_CLEAR_NODE(&pdng->endlink);
 	//pdng->elemidx = 0;
 }
 
-void copy_nugget(struct dio_nugget* destng, struct dio_nugget* srcng){
-	memcpy(destng, srcng, sizeof(struct dio_nugget));
+void append_nugget(struct dio_nugget* destng, struct dio_nugget* srcng){
+	int i = 0;
+
+	for(i=0; i<srcng->elemidx && destng->elemidx < MAX_ELEMENT_SIZE-1; i++){
+		destng->states[destng->elemidx] = srcng->states[i];
+		destng->times[destng->elemidx] = srcng->times[i];
+		destng->elemidx++;
+	}
+	destng->ngflag = srcng->ngflag;
+	destng->category = srcng->category;
+	destng->idxCPU = srcng->idxCPU;
 }
 
-struct dio_nugget* get_nugget_at(uint64_t sector){
+struct dio_nugget* get_nugget_at(struct dio_shard* psh, uint32_t device, uint64_t sector){
 	struct dio_nugget* pdng = NULL;
-	struct dio_rbentity* prben = NULL;
-
-	prben = rb_search_entity(sector);
-	if( prben == NULL ){
-		prben = (struct dio_rbentity*)malloc(sizeof(struct dio_rbentity));
-		if( prben == NULL){
-			DBGOUT("failed to get memory\n");
-			return NULL;
-		}
-		init_rbentity(prben);
-		prben->sector = sector;
-		if( rb_insert_entity(prben) != NULL ){
-			free(prben);
-			DBGOUT(">failed to insert rbentity into rbtree\n");
-			return NULL;
-		}
-	}
 
-	//return the first item of nugget list
-	if( !list_empty(&prben->nghead) ){
-		pdng = FRONT_NUGGET(&prben->nghead);
-		if( pdng->ngflag == NG_ACTIVE ){
-			return pdng;
-		}
-	}
+	pdng = ngtable_find(&psh->active_ngs, device, sector);
+	if( pdng != NULL )
+		return pdng;
 
-	//else if list is empty or first item is inactive
-	pdng = NULL;
-	pdng = (struct dio_nugget*)malloc(sizeof(struct dio_nugget));
+	//else there isn't any request in flight at the sector
+	pdng = (struct dio_nugget*)arena_alloc(&psh->arena, sizeof(struct dio_nugget));
 	if( pdng == NULL ){
 		perror("failed to allocate nugget memory");
 		return NULL;
@@ -700,62 +1318,64 @@ struct dio_nugget* get_nugget_at(uint64_t sector){
 
 	init_nugget(pdng);
 	pdng->sector = sector;
+	pdng->device = device;
 	pdng->ngflag = NG_ACTIVE;
-	list_add(&pdng->nglink, &prben->nghead);
+	if( !link_nugget_at(psh, pdng, sector) )
+		return NULL;
+	if( !ngtable_insert(&psh->active_ngs, pdng) ){
+		perror("failed to grow active nugget table");
+		list_del(&pdng->nglink);
+		return NULL;
+	}
 
 	return pdng;
 }
 
-struct dio_nugget* create_nugget_at(uint64_t sector){
-	struct dio_rbentity* rben = rb_search_entity(sector);
-	if( rben == NULL ){
-		rben = (struct dio_rbentity*)malloc(sizeof(struct dio_rbentity));
-		if( rben == NULL ){
-			perror("failed to allocate rbentity memory");
-			return NULL;
-		}
-		init_rbentity(rben);
-		rben->sector = sector;
+bool link_nugget_at(struct dio_shard* psh, struct dio_nugget* pdng, uint64_t sector){
+	struct dio_secentity** psecen = NULL;
 
-		rb_insert_entity(rben);
+	psecen = (struct dio_secentity**)bpt_insert(&psh->sec_index, sector);
+	if( psecen == NULL ){
+		perror("failed to insert secentity into sector index");
+		return false;
 	}
-
-	struct dio_nugget* newng = NULL;
-	newng = (struct dio_nugget*)malloc(sizeof(struct dio_nugget));
-	if( newng == NULL ){
-		perror("failed to allocate nugget memory");
-		return NULL;
+	if( *psecen == NULL ){
+		*psecen = (struct dio_secentity*)arena_alloc(&psh->arena, sizeof(struct dio_secentity));
+		if( *psecen == NULL ){
+			perror("failed to allocate secentity memory");
+			return false;
+		}
+		init_secentity(*psecen);
+		(*psecen)->sector = sector;
 	}
-	init_nugget(newng);
-	newng->sector = sector;
-	newng->ngflag = NG_ACTIVE;
-	list_add(&newng->nglink, &rben->nghead);
 
-	return newng;
+	list_add(&pdng->nglink, &(*psecen)->nghead);
+	return true;
 }
 
-void delete_nugget_at(uint64_t sector){
-	struct dio_rbentity* prben = rb_search_entity(sector);
-	if( prben == NULL )
-		return;
-	
-	if( list_empty(&prben->nghead) )
-		return;
-
-	struct dio_nugget* del = FRONT_NUGGET(&prben->nghead);
-	list_del(prben->nghead.next);
-	free(del);
+void retire_nugget(struct dio_shard* psh, struct dio_nugget* pdng){
+	ngtable_remove(&psh->active_ngs, pdng);
+	endidx_remove(psh, pdng);
 }
 
-void extract_nugget(struct blk_io_trace* pbit, struct dio_nugget* pdngbuf){
+void extract_nugget(struct dio_shard* psh, struct blk_io_trace* pbit, struct dio_nugget* pdngbuf){
+	//keep the last state slot for string terminator
+	if( pdngbuf->elemidx >= MAX_ELEMENT_SIZE-1 ){
+		DBGOUT("too many states at sector %llu\n", (unsigned long long)pdngbuf->sector);
+		return;
+	}
+
 	pdngbuf->times[pdngbuf->elemidx] = pbit->time;
 	if( pdngbuf->elemidx == 0 ){
-		pdngbuf->size = pbit->bytes;
+		//a stand-in has the size of the bios merged into its request
+		if( pdngbuf->ngflag != NG_STANDIN )
+			pdngbuf->size = pbit->bytes;
 		pdngbuf->pid = pbit->pid;
 		pdngbuf->category = pbit->action >> BLK_TC_SHIFT;
+		endidx_insert(psh, pdngbuf);
 	}
 
-	handle_action(pbit->action, pdngbuf);
+	handle_action(psh, pbit, pdngbuf);
 	pdngbuf->category = pbit->action >> BLK_TC_SHIFT;
 	if(pbit->cpu < 128)
 	{
@@ -764,790 +1384,4334 @@ void extract_nugget(struct blk_io_trace* pbit, struct dio_nugget* pdngbuf){
 	pdngbuf->elemidx++;
 }
 
-void handle_action(uint32_t act, struct dio_nugget* pdng){
+void handle_action(struct dio_shard* psh, struct blk_io_trace* pbit, struct dio_nugget* pdng){
 	struct dio_nugget* ptmpng = NULL;
-	struct dio_nugget* newng = NULL;
-	struct dio_rbentity* prben = NULL;
+	uint64_t reqsect = 0;
 
-	char actc = GET_ACTION_CHAR(act);
+	char actc = GET_ACTION_CHAR(pbit->action);
 	pdng->states[pdng->elemidx] = actc;
 
-	switch(act){
+	switch(actc){
 	case 'M':
-		//back merged
-		prben = rb_search_end(pdng->sector);
-		if( prben == NULL ){
-			DBGOUT("Failed to search nugget when back merging\n");
+		//back merged. the bio is not in flight by itself anymore
+		pdng->ngflag = NG_BACKMERGE;
+		retire_nugget(psh, pdng);
+
+		ptmpng = endidx_search(psh, pdng->device, pdng->sector);
+		if( ptmpng == NULL ){
+			//the request may start at the chunk of other shard
+			if( shard_cnt > 1 )
+				add_pending_merge(psh, pdng, NULL, pbit->bytes);
+			else
+				DBGOUT("Failed to search nugget when back merging\n");
 			return;
 		}
-		ptmpng = FRONT_NUGGET(&prben->nghead);
-		
-		pdng->ngflag = NG_BACKMERGE;
 		pdng->mlink = ptmpng;
-		ptmpng->size += pdng->size;
+
+		//the request grows at its end
+		endidx_remove(psh, ptmpng);
+		ptmpng->size += pbit->bytes;
+		endidx_insert(psh, ptmpng);
 		break;
 
 	case 'F':
-		//front merged
-		newng = create_nugget_at(pdng->sector);
-		if( newng == NULL ){
-			DBGOUT("Failed to create nugget\n");
+		//front merged. the request starts at the sector of the bio from now on
+		pdng->ngflag = NG_FRONTMERGE;
+		retire_nugget(psh, pdng);
+
+		//the request starts where the bio ends. the sorter tells its shard by the same bit
+		reqsect = pbit->sector + pbit->bytes/512;
+		ptmpng = ngtable_find(&psh->active_ngs, pdng->device, reqsect);
+		if( ptmpng == NULL ){
+			if( SHARD_OF(reqsect) != SHARD_OF(pdng->sector) ){
+				ptmpng = new_standin(psh, pbit);
+				if( ptmpng == NULL ){
+					psh->failed = true;
+					return;
+				}
+				pdng->mlink = ptmpng;
+				add_pending_merge(psh, pdng, ptmpng, pbit->bytes);
+			}
+			else
+				DBGOUT("Failed to search nugget when front merging\n");
 			return;
 		}
-		prben = rb_search_entity(pdng->sector + pdng->size);
-		if( prben == NULL ){
-			DBGOUT("Failed to search nugget when front merging\n");
+		pdng->mlink = ptmpng;
+
+		retire_nugget(psh, ptmpng);
+		list_del(&ptmpng->nglink);
+		ptmpng->sector = pdng->sector;
+		ptmpng->size += pbit->bytes;
+		if( !link_nugget_at(psh, ptmpng, ptmpng->sector) ||
+			!ngtable_insert(&psh->active_ngs, ptmpng) ){
+			DBGOUT("Failed to move nugget when front merging\n");
 			return;
 		}
-		ptmpng = FRONT_NUGGET(&prben->nghead);
-		copy_nugget(newng, ptmpng);
-
-		pdng->ngflag = NG_FRONTMERGE;
-		pdng->mlink = ptmpng;
-		delete_nugget_at(pdng->sector + pdng->size);
+		endidx_insert(psh, ptmpng);
 		break;
 	case 'C':
 		pdng->ngflag = NG_COMPLETE;
+		retire_nugget(psh, pdng);
 		break;
 	};
 }
 
-void add_nugget_stat_func(statistic_init_func stat_init_fn, 
-				statistic_travel_func stat_trv_fn,
-				statistic_process_func stat_proc_fn){
-	if( stat_fn_cnt +1 >= MAX_STATISTIC_FUNCTION )
-		return;
-	
-	stat_init_fns[stat_fn_cnt] = stat_init_fn;
-	stat_trv_fns[stat_fn_cnt] = stat_trv_fn;
-	stat_proc_fns[stat_fn_cnt] = stat_proc_fn;
-	stat_fn_cnt++;
-}
-
-void add_bit_stat_func(statistic_init_func stat_init_fn,
-				statistic_itr_func stat_itr_fn,
-				statistic_process_func stat_proc_fn){
-	if( stat_fn_list_cnt >= MAX_STATISTIC_FUNCTION - stat_fn_cnt )
-		return;
-	
-	stat_init_fns[MAX_STATISTIC_FUNCTION - stat_fn_list_cnt - 1] = stat_init_fn;
-	stat_itr_fns[MAX_STATISTIC_FUNCTION - stat_fn_list_cnt - 1] = stat_itr_fn;
-	stat_proc_fns[MAX_STATISTIC_FUNCTION - stat_fn_list_cnt - 1] = stat_proc_fn;
-	stat_fn_list_cnt ++;
-}
-
-void statistic_rb_traveling(){
-	struct rb_node* node;
-	int i=0, cnt=0;
+//------------------- arena --------------------------------------//
+void* arena_alloc(struct dio_arena* parena, size_t size){
+	struct dio_arena_block* pblk = parena->head;
+	void* ret = NULL;
 
-	//init all statistic functions
-	for(i=0; i<stat_fn_cnt; i++){
-		if( stat_init_fns[i] != NULL )
-			stat_init_fns[i]();
+	size = (size + 15) & ~(size_t)15;
+	if( pblk == NULL || pblk->used + size > ARENA_BLOCK_SIZE ){
+		pblk = (struct dio_arena_block*)malloc(sizeof(struct dio_arena_block) +
+				(size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE));
+		if( pblk == NULL )
+			return NULL;
+		pblk->used = 0;
+		pblk->next = parena->head;
+		parena->head = pblk;
 	}
-	
-	node = rb_first(&rben_root);
-	do{
-		struct dio_rbentity* prben = NULL;
-		prben = rb_entry(node, struct dio_rbentity, rblink);
 
-		struct dio_nugget* pdng = NULL;
-		list_for_each_entry(pdng, &prben->nghead, nglink){
-			//traveling
-			for(i=0; i<stat_fn_cnt; i++){
-				if( stat_trv_fns[i] != NULL )
-					stat_trv_fns[i](pdng);	
-			}
-			cnt++;
-		}
-	}while((node = rb_next(node)) != NULL);
+	ret = pblk->data + pblk->used;
+	pblk->used += size;
+	return ret;
+}
 
-	//process data
-	for(i=0; i<stat_fn_cnt; i++){
-		if( stat_proc_fns[i] != NULL )
-			stat_proc_fns[i](cnt);
-	}
+void arena_destroy(struct dio_arena* parena){
+	struct dio_arena_block* pblk = parena->head;
+	struct dio_arena_block* pnext = NULL;
 
+	while( pblk != NULL ){
+		pnext = pblk->next;
+		free(pblk);
+		pblk = pnext;
+	}
+	parena->head = NULL;
 }
 
-void statistic_list_for_each(){
-	struct bit_entity* pos;
-	int i=0, cnt=0;
-	int itrcnt = MAX_STATISTIC_FUNCTION - stat_fn_list_cnt;
+//------------------- ingest pipeline ------------------------------//
+bool spsc_init(struct dio_spsc* pq, size_t size){
+	memset(pq, 0, sizeof(struct dio_spsc));
+	pq->items = (void**)malloc(sizeof(void*) * size);
+	if( pq->items == NULL )
+		return false;
+	pq->mask = size - 1;
+	return true;
+}
 
-	//init all statistic functions
-	for(i=MAX_STATISTIC_FUNCTION-1; i >= itrcnt; i--){
-		if( stat_init_fns[i] != NULL )
-			stat_init_fns[i]();
-	}
-	
-	list_for_each_entry(pos, &biten_head, link){
-		//foreach data
-		for(i=MAX_STATISTIC_FUNCTION-1; i >= itrcnt; i--){
-			if( stat_itr_fns[i] != NULL )
-				stat_itr_fns[i](&pos->bit);
-		}
-		cnt++;
-	}
+void spsc_destroy(struct dio_spsc* pq){
+	free(pq->items);
+	pq->items = NULL;
+}
 
-	//process data
-	for(i=MAX_STATISTIC_FUNCTION-1; i >= itrcnt; i--){
-		if( stat_proc_fns[i] != NULL )
-			stat_proc_fns[i](cnt);
+bool spsc_spin(int* pspin){
+	(*pspin)++;
+	if( *pspin < SPSC_SPIN )
+		return true;
+	//the other side may be waiting for the cpu
+	if( *pspin < SPSC_SPIN + SPSC_YIELD ){
+		sched_yield();
+		return true;
 	}
+	return false;
+}
 
+void futex_sleep(int* pword){
+	syscall(SYS_futex, pword, FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
 }
 
-//------------------- printing -------------------------------------//
-void print_time() {
-	struct bit_entity* p = NULL;
+void futex_wake(int* pword){
+	//the store of the waker must be seen before the word is read
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if( __atomic_load_n(pword, __ATOMIC_RELAXED) && __atomic_exchange_n(pword, 0, __ATOMIC_SEQ_CST) )
+		syscall(SYS_futex, pword, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
 
-	list_for_each_entry(p, &biten_head, link) {
+void spsc_push(struct dio_spsc* pq, void* item){
+	size_t tail = pq->tail;
+	int spin = 0;
 
-		fprintf(output,"%5d.%09lu\t", (int)SECONDS(p->bit.time), (unsigned long)NANO_SECONDS(p->bit.time));
-		fprintf(output,"%llu\t",p->bit.sector);
-		fprintf(output,"%u\t",p->bit.pid);
-		fprintf(output,"%u\n",p->bit.bytes/8);
+	while( tail - __atomic_load_n(&pq->head, __ATOMIC_ACQUIRE) > pq->mask ){
+		if( spsc_spin(&spin) )
+			continue;
+		//the word is set before the head is read again, so a pop in between clears it
+		__atomic_store_n(&pq->push_sleep, 1, __ATOMIC_SEQ_CST);
+		if( tail - __atomic_load_n(&pq->head, __ATOMIC_SEQ_CST) > pq->mask )
+			futex_sleep(&pq->push_sleep);
+		else
+			__atomic_store_n(&pq->push_sleep, 0, __ATOMIC_RELAXED);
 	}
+
+	pq->items[tail & pq->mask] = item;
+	__atomic_store_n(&pq->tail, tail + 1, __ATOMIC_RELEASE);
+	futex_wake(&pq->pop_sleep);
 }
 
-void print_sector() {
+void* spsc_pop(struct dio_spsc* pq){
+	size_t head = pq->head;
+	void* item = NULL;
+	int spin = 0;
 
-	struct rb_node *node;
-	node = rb_first(&rben_root);
-	while((node = rb_next(node)) != NULL) {
-		struct list_head* nugget_head;
-		struct dio_rbentity* prbentity;
+	while( __atomic_load_n(&pq->tail, __ATOMIC_ACQUIRE) == head ){
+		if( spsc_spin(&spin) )
+			continue;
+		__atomic_store_n(&pq->pop_sleep, 1, __ATOMIC_SEQ_CST);
+		if( __atomic_load_n(&pq->tail, __ATOMIC_SEQ_CST) == head )
+			futex_sleep(&pq->pop_sleep);
+		else
+			__atomic_store_n(&pq->pop_sleep, 0, __ATOMIC_RELAXED);
+	}
 
-		prbentity = rb_entry(node, struct dio_rbentity, rblink);
+	item = pq->items[head & pq->mask];
+	__atomic_store_n(&pq->head, head + 1, __ATOMIC_RELEASE);
+	futex_wake(&pq->push_sleep);
+	return item;
+}
 
-		struct dio_nugget* pdng;
-		uint64_t tmpt = 0;
+// length of the bit at 'p' including its pdu
+static inline size_t bit_len(const char* p){
+	uint16_t pdu_len = 0;
 
-		list_for_each_entry(pdng, &(prbentity->nghead), nglink) {
-			tmpt = pdng->times[pdng->elemidx-1] - pdng->times[0];
-			fprintf(output,"%"PRIu64"\t",pdng->sector);
-			fprintf(output,"%5d.%09lu\t",(int)SECONDS(tmpt), (unsigned long)NANO_SECONDS(tmpt));
-			fprintf(output,"%u\t", pdng->pid);
-			fprintf(output,"%d\n", pdng->size);
-		}
-	}
+	memcpy(&pdu_len, p + offsetof(struct blk_io_trace, pdu_len), sizeof(uint16_t));
+	if( is_swapped )
+		pdu_len = __builtin_bswap16(pdu_len);
+	return sizeof(struct blk_io_trace) + pdu_len;
 }
 
-//------------------- i/o type statistics -------------------------------//
-static int r_cnt,w_cnt,x_cnt;
+bool check_byte_order(int ifd){
+	char head[65536];
+	uint32_t magic = 0;
+	ssize_t len = 0, off = 0;
+	int native = 0, swapped = 0;
+
+	//broken bits may come first, so count the magics at any offset of the head.
+	//an empty input is native
+	len = pread(ifd, head, sizeof(head), 0);
+	for(off=0; off + (ssize_t)sizeof(struct blk_io_trace) <= len; off++){
+		memcpy(&magic, head + off, sizeof(uint32_t));
+		if( magic == (BLK_IO_TRACE_MAGIC | BLK_IO_TRACE_VERSION) )
+			native++;
+		else if( __builtin_bswap32(magic) == (BLK_IO_TRACE_MAGIC | BLK_IO_TRACE_VERSION) )
+			swapped++;
+	}
+	if( len > 0 && native == 0 && swapped == 0 )
+		return false;
 
-void init_type_statistic(){
-	r_cnt = w_cnt = x_cnt = 0;
+	is_swapped = (swapped > native);
+	return true;
 }
 
-void itr_type_statistic(struct blk_io_trace* pbit){
-	uint32_t category = pbit->action >> BLK_TC_SHIFT;
+static inline bool bit_valid(const char* p){
+	uint32_t magic = 0;
 
-	if( category & BLK_TC_READ )
-		r_cnt++;
-	else if( category & BLK_TC_WRITE )
-		w_cnt++;
-	else
-		x_cnt++;
+	memcpy(&magic, p + offsetof(struct blk_io_trace, magic), sizeof(uint32_t));
+	if( is_swapped )
+		magic = __builtin_bswap32(magic);
+	if( magic != (BLK_IO_TRACE_MAGIC | BLK_IO_TRACE_VERSION) )
+		return false;
+	return bit_len(p) <= sizeof(struct blk_io_trace) + MAX_PDU_LEN;
 }
 
-void process_type_statistic(int bit_cnt){
-	int tot;
-	fprintf(output, "%7s %10s %13s\n", "TYPE","COUNT","PERCENTAGE");
-	
-	fprintf(output, "%7s %10d %13f\n", "R",r_cnt, r_cnt/(double)bit_cnt*100);
-	fprintf(output, "%7s %10d %13f\n", "W",w_cnt,w_cnt/(double)bit_cnt*100);
-	fprintf(output, "%7s %10d %13f\n", "Unknown",x_cnt, x_cnt/(double)bit_cnt*100);
-
-	tot = r_cnt + w_cnt + x_cnt;
-	fprintf(output, "%7s %10d %13f\n", "Total :",tot, tot/(double)bit_cnt*100);
+static inline void bit_cpu_seq(const char* p, uint32_t* pcpu, uint32_t* pseq){
+	memcpy(pcpu, p + offsetof(struct blk_io_trace, cpu), sizeof(uint32_t));
+	memcpy(pseq, p + offsetof(struct blk_io_trace, sequence), sizeof(uint32_t));
+	if( is_swapped ){
+		*pcpu = __builtin_bswap32(*pcpu);
+		*pseq = __builtin_bswap32(*pseq);
+	}
 }
 
-//------------------- path statistics ------------------------------//
-struct list_head nugget_path_head;
-struct dio_nugget_path* pnugget_path;
-FILE*	fPathData = NULL;
+// 1 if the bit at 'p' can be the first one after the broken bytes, 0 if not.
+// -1 if the bytes up to the next bit are needed to tell it
+static int resync_proof(struct dio_resync* prs, const char* p, size_t avail, bool eof){
+	uint32_t cpu = 0, seq = 0;
+	size_t blen = 0;
 
-int instr(const char* str1, const char* str2)
-{
-        int i, j;
+	if( !bit_valid(p) )
+		return 0;
 
-        i=0;
-        while(str1[i] != '\0')
-        {
-                j=0;
-                while(str2[j] != '\0')
-                {
-                        if(str1[i+j] != str2[j])
-                        {
-                                break;
-                        }
-                        j++;
-                }
-                if(str2[j] == '\0')
-                {
-                        return i+1;
-                }
-                i++;
-        }
+	bit_cpu_seq(p, &cpu, &seq);
+	blen = bit_len(p);
+	if( cpu < RESYNC_MAX_CPU && prs->next_seq[cpu] != 0 && seq >= prs->next_seq[cpu] )
+		return blen <= avail || !eof ? 1 : 0;
 
-        return 0;
+	if( blen + sizeof(struct blk_io_trace) > avail ){
+		if( !eof )
+			return -1;
+		return blen <= avail;
+	}
+	return bit_valid(p + blen);
 }
 
-struct dio_nugget_path* find_nugget_path(struct list_head* nugget_path_head, char* states)
-{
-	struct dio_nugget_path* pdngpath;
+static void end_skip(struct dio_resync* prs){
+	if( prs->skip_cnt < MAX_SKIP_REPORT )
+		fprintf(stderr, "skipped %"PRIu64" broken bytes at %"PRIu64"\n", prs->skip_len, prs->skip_off);
+	prs->skip_total += prs->skip_len;
+	prs->skip_cnt++;
+	prs->skipping = false;
+	prs->skip_len = 0;
+}
 
-	list_for_each_entry(pdngpath, nugget_path_head, link)
-	{
-		if(strcmp(pdngpath->states, states) == 0)
-		{
-			return pdngpath;
+size_t pack_bits(struct dio_resync* prs, char* buf, size_t len, uint64_t pos, bool eof, size_t* pvalid){
+	size_t in = 0, out = 0, blen = 0, torn = 0;
+	uint32_t cpu = 0, seq = 0;
+	int proof = 0;
+
+	while( in + sizeof(struct blk_io_trace) <= len ){
+		if( prs->skipping ){
+			proof = resync_proof(prs, buf + in, len - in, eof);
+			if( proof < 0 )
+				break;
+			if( proof == 0 ){
+				in++;
+				prs->skip_len++;
+				continue;
+			}
+			end_skip(prs);
+		}
+		else if( !bit_valid(buf + in) ){
+			prs->skipping = true;
+			prs->skip_off = pos + in;
+			continue;
 		}
-	}
 
-	return NULL;
-}
+		blen = bit_len(buf + in);
+		if( in + blen > len )
+			break;
 
-void init_path_statistic(void)
-{
-	if(is_graphic)
-	{
-		fPathData = fopen("dioparse.path.dat", "wt");
-		if(!fPathData)
-		{
-			DBGOUT("dioparse.path.dat open error \n");
+		//a torn bit is followed by a broken one. it is dropped if a bit begins inside it
+		if( in + blen + sizeof(struct blk_io_trace) <= len && !bit_valid(buf + in + blen) ){
+			for(torn=in+1; torn<in+blen; torn++){
+				if( resync_proof(prs, buf + torn, len - torn, eof) == 1 )
+					break;
+			}
+			if( torn < in + blen ){
+				prs->skipping = true;
+				prs->skip_off = pos + in;
+				prs->skip_len = torn - in;
+				in = torn;
+				continue;
+			}
+		}
+		bit_cpu_seq(buf + in, &cpu, &seq);
+		if( cpu < RESYNC_MAX_CPU )
+			prs->next_seq[cpu] = seq + 1;
+		if( out != in )
+			memmove(buf + out, buf + in, blen);
+		out += blen;
+		in += blen;
+	}
+
+	//a broken bit at the end of file is dropped
+	if( eof && in < len ){
+		if( !prs->skipping ){
+			prs->skipping = true;
+			prs->skip_off = pos + in;
 		}
+		prs->skip_len += len - in;
+		in = len;
 	}
+	if( eof && prs->skipping )
+		end_skip(prs);
 
-	INIT_LIST_HEAD(&nugget_path_head);
+	*pvalid = out;
+	return in;
 }
 
-void travel_path_statistic(struct dio_nugget* pdng)
-{
-	char* 			pstates;
-	uint64_t*		ptimes;
-	int*			pelemidx;
-	int			i;
-	int			nugget_time;
-	int			nugget_time_interval;
-	struct data_time*	pdata_time;
-	struct data_time*	pdata_time_interval;
-	
-	pnugget_path = find_nugget_path(&nugget_path_head, pdng->states);
-	if(pnugget_path == NULL)	// if not exist
-	{
-		pnugget_path = (struct dio_nugget_path*)malloc(sizeof(struct dio_nugget_path));
-		memset(pnugget_path, 0, sizeof(struct dio_nugget_path));
-
-		pnugget_path->data_time_interval_read = (struct data_time*)malloc(sizeof(struct data_time) * pdng->elemidx);
-		pnugget_path->data_time_interval_write = (struct data_time*)malloc(sizeof(struct data_time) * pdng->elemidx);
-		memset(pnugget_path->data_time_interval_read, 0, sizeof(struct data_time) * pdng->elemidx);
-		memset(pnugget_path->data_time_interval_write, 0, sizeof(struct data_time) * pdng->elemidx);
-
-		// Init pnugget_path's members
-		pnugget_path->elemidx = pdng->elemidx;
-		pnugget_path->data_time_read.min_time = -1;
-		pnugget_path->data_time_write.min_time = -1;
-		for(i=0 ; i<pnugget_path->elemidx ; i++)
-		{
-			pnugget_path->data_time_interval_read[i].min_time = -1;
-			pnugget_path->data_time_interval_write[i].min_time = -1;
+void resync_done(struct dio_resync* prs){
+	if( prs->skip_cnt > 0 )
+		fprintf(stderr, "skipped %"PRIu64" broken bytes in %d places\n", prs->skip_total, prs->skip_cnt);
+}
+
+void* read_blocks(void* param){
+	int ifd = (int)(intptr_t)param;
+	struct dio_block* pblk = NULL;
+	struct dio_resync* prs = NULL;
+	char* carry = NULL;
+	size_t carrylen = 0, off = 0, valid = 0;
+	uint64_t pos = 0;
+	ssize_t rdsz = 0;
+	int i = 0, nblk = 0;
+
+	prs = (struct dio_resync*)calloc(1, sizeof(struct dio_resync));
+	while( prs != NULL ){
+		pblk = (struct dio_block*)calloc(1, sizeof(struct dio_block));
+		if( pblk != NULL )
+			pblk->raw = (char*)malloc(INGEST_BLOCK_SIZE);
+		if( pblk == NULL || pblk->raw == NULL ){
+			perror("failed to allocate memory");
+			__atomic_store_n(&ingest_failed, true, __ATOMIC_RELEASE);
+			free(pblk);
+			break;
 		}
-		strncpy(pnugget_path->states, pdng->states, MAX_ELEMENT_SIZE);
 
-		// Add list
-		list_add(&(pnugget_path->link), &nugget_path_head);
-	}
-	
-	// Add read/write count to distribute those.
-	if(pdng->category & BLK_TC_READ)
-	{
-		pdata_time = &pnugget_path->data_time_read;
-		pdata_time_interval = pnugget_path->data_time_interval_read;
+		//the cut bit of the last block comes first
+		if( carrylen > 0 )
+			memcpy(pblk->raw, carry, carrylen);
+		pblk->rawlen = carrylen;
+		while( pblk->rawlen < INGEST_BLOCK_SIZE ){
+			rdsz = read(ifd, pblk->raw + pblk->rawlen, INGEST_BLOCK_SIZE - pblk->rawlen);
+			if( rdsz < 0 && errno == EINTR )
+				continue;
+			if( rdsz <= 0 )
+				break;
+			pblk->rawlen += rdsz;
+		}
+		if( rdsz < 0 ){
+			perror("failed to read");
+			__atomic_store_n(&ingest_failed, true, __ATOMIC_RELEASE);
+		}
+
+		//cut the block at the last whole bit, and drop the broken bytes
+		off = pack_bits(prs, pblk->raw, pblk->rawlen, pos, rdsz <= 0, &valid);
+		free(carry);
+		carry = NULL;
+		carrylen = pblk->rawlen - off;
+		if( carrylen > 0 && rdsz > 0 ){
+			carry = (char*)malloc(carrylen);
+			if( carry == NULL ){
+				perror("failed to allocate memory");
+				__atomic_store_n(&ingest_failed, true, __ATOMIC_RELEASE);
+				carrylen = 0;
+			}
+			else
+				memcpy(carry, pblk->raw + off, carrylen);
+		}
+		pblk->rawlen = valid;
+		pblk->off = pos;
+		pblk->filelen = off;
+		pos += off;
+
+		//a block of only broken bytes has nothing to decode
+		if( valid == 0 ){
+			free(pblk->raw);
+			free(pblk);
+			if( off == 0 || rdsz <= 0 || __atomic_load_n(&ingest_failed, __ATOMIC_ACQUIRE) )
+				break;
+			continue;
+		}
+
+		spsc_push(&decoders[nblk % decoder_cnt].inq, pblk);
+		nblk++;
+		if( rdsz <= 0 || __atomic_load_n(&ingest_failed, __ATOMIC_ACQUIRE) )
+			break;
 	}
-	else if(pdng->category & BLK_TC_WRITE)
-	{
-		pdata_time = &pnugget_path->data_time_write;
-		pdata_time_interval = pnugget_path->data_time_interval_write;
+	if( prs == NULL ){
+		perror("failed to allocate memory");
+		__atomic_store_n(&ingest_failed, true, __ATOMIC_RELEASE);
 	}
 	else
-	{
-		DBGOUT("%x \n", pdng->category);
-		return ;
-	}
+		resync_done(prs);
+	free(prs);
+	free(carry);
 
-	// Set data on pnugget_path.
-	nugget_time = pdng->times[pnugget_path->elemidx-1] - pdng->times[0];
-	pdata_time->count++;
-	pdata_time->total_time += nugget_time;
-	if(pdata_time->max_time < nugget_time)
-	{
-		pdata_time->max_time = nugget_time;
-	}
-	if(pdata_time->min_time > nugget_time)
-	{
-		pdata_time->min_time = nugget_time;
+	//the end of blocks is NULL
+	for(i=0; i<decoder_cnt; i++)
+		spsc_push(&decoders[(nblk + i) % decoder_cnt].inq, NULL);
+	return NULL;
+}
+
+// blocks of the index were cut at bit boundaries, so they are read as they are
+void* read_zone_blocks(void* param){
+	int ifd = (int)(intptr_t)param;
+	struct dio_block* pblk = NULL;
+	struct dio_resync* prs = NULL;
+	ssize_t rdsz = 0;
+	size_t z = 0, len = 0;
+	int i = 0, nblk = 0;
+
+	prs = (struct dio_resync*)calloc(1, sizeof(struct dio_resync));
+	if( prs == NULL ){
+		perror("failed to allocate memory");
+		__atomic_store_n(&ingest_failed, true, __ATOMIC_RELEASE);
 	}
 
-	// Set data on pnugget_path->data_time_interval
-	for(i=0 ; i<pnugget_path->elemidx ; i++)
-	{
-		nugget_time_interval = pdng->times[i+1] - pdng->times[i];
-		pdata_time_interval[i].count++;
-		pdata_time_interval[i].total_time += nugget_time_interval;
-		if(pdata_time_interval[i].max_time < nugget_time)
-		{
-			pdata_time_interval[i].max_time = nugget_time;
+	for(z=0; z<zone_cnt && !__atomic_load_n(&ingest_failed, __ATOMIC_ACQUIRE); z++){
+		if( !zone_match(&zones[z], time_start, time_end, sector_start, sector_end, filter_pid) )
+			continue;
+
+		pblk = (struct dio_block*)calloc(1, sizeof(struct dio_block));
+		if( pblk != NULL )
+			pblk->raw = (char*)malloc(zones[z].len);
+		if( pblk == NULL || pblk->raw == NULL ){
+			perror("failed to allocate memory");
+			__atomic_store_n(&ingest_failed, true, __ATOMIC_RELEASE);
+			free(pblk);
+			break;
 		}
-		if(pdata_time_interval[i].min_time > nugget_time)
-		{
-			pdata_time_interval[i].min_time = nugget_time;
+
+		pblk->off = zones[z].off;
+		for(len=0; len < zones[z].len; len += rdsz){
+			rdsz = pread(ifd, pblk->raw + len, zones[z].len - len, zones[z].off + len);
+			if( rdsz < 0 && errno == EINTR ){
+				rdsz = 0;
+				continue;
+			}
+			if( rdsz <= 0 )
+				break;
+		}
+		if( len < zones[z].len ){
+			if( rdsz < 0 )
+				perror("failed to read");
+			else
+				fprintf(stderr, "zone at %llu is over the end of input\n", (unsigned long long)zones[z].off);
+			__atomic_store_n(&ingest_failed, true, __ATOMIC_RELEASE);
+			free(pblk->raw);
+			free(pblk);
+			break;
 		}
+		//the zone ends at a bit boundary, but it may have the broken bytes in it
+		pblk->filelen = len;
+		pack_bits(prs, pblk->raw, len, pblk->off, true, &pblk->rawlen);
+
+		spsc_push(&decoders[nblk % decoder_cnt].inq, pblk);
+		nblk++;
 	}
+	if( prs != NULL )
+		resync_done(prs);
+	free(prs);
 
+	for(i=0; i<decoder_cnt; i++)
+		spsc_push(&decoders[(nblk + i) % decoder_cnt].inq, NULL);
+	return NULL;
 }
 
-
-void process_path_statistic(int ng_cnt)
-{
-	int i;
-
-	if(is_graphic)
-	{
-		fprintf(fPathData, "%s %s %s\n", "path", "read", "write");
+void* read_col_groups(void* param){
+	int ifd = (int)(intptr_t)param;
+	struct col_group_header hdr;
+	struct dio_block* pblk = NULL;
+	struct stat ist;
+	uint64_t off = sizeof(DIO_COLUMN_MAGIC) - 1;
+	ssize_t rdsz = 0;
+	int i = 0, nblk = 0;
+
+	if( fstat(ifd, &ist) < 0 ){
+		perror("failed to stat input");
+		__atomic_store_n(&ingest_failed, true, __ATOMIC_RELEASE);
 	}
-	else
-	{
-		fprintf(output,"%20s %6s %6s %12s %12s %12s \n", "Path", "Type", "No", "AverageTime", "MaxTime", "MinTime");
-	}
-
-	list_for_each_entry(pnugget_path, &nugget_path_head, link)
-	{
-		// Calculate average time(path)
-		if(pnugget_path->data_time_read.count != 0)
-		{
-			pnugget_path->data_time_read.average_time = pnugget_path->data_time_read.total_time / pnugget_path->data_time_read.count;
-		}
-		if(pnugget_path->data_time_write.count != 0)
-		{
-			pnugget_path->data_time_write.average_time = pnugget_path->data_time_write.total_time / pnugget_path->data_time_write.count;
+	while( !__atomic_load_n(&ingest_failed, __ATOMIC_ACQUIRE) ){
+		rdsz = pread(ifd, &hdr, sizeof(hdr), off);
+		if( rdsz < 0 && errno == EINTR )
+			continue;
+		if( rdsz == 0 )
+			break;
+		if( rdsz < 0 ){
+			perror("failed to read");
+			__atomic_store_n(&ingest_failed, true, __ATOMIC_RELEASE);
+			break;
 		}
 
-		// if min_time is -1 that initializing value for calculating min_time, change that to 0.
-		if(pnugget_path->data_time_read.min_time == -1)
-		{
-			pnugget_path->data_time_read.min_time = 0;
+		//the next group is found only by the length of this one,
+		//so the rest of file is skipped after a broken header
+		col_group_cnt++;
+		if( rdsz != sizeof(hdr) || hdr.zone.off != off + sizeof(hdr) ||
+			hdr.zone.cnt > COL_GROUP_ROWS || col_offset(&hdr, COL_CNT) != hdr.zone.len ){
+			fprintf(stderr, "skipped broken row group at %llu and the rest of file\n", (unsigned long long)off);
+			__atomic_add_fetch(&col_broken_cnt, 1, __ATOMIC_RELAXED);
+			break;
 		}
-		if(pnugget_path->data_time_write.min_time == -1)
-		{
-			pnugget_path->data_time_write.min_time = 0;
+		if( hdr.zone.len > (uint64_t)ist.st_size - hdr.zone.off ){
+			fprintf(stderr, "skipped truncated row group at %llu\n", (unsigned long long)off);
+			__atomic_add_fetch(&col_broken_cnt, 1, __ATOMIC_RELAXED);
+			break;
 		}
+		off += sizeof(hdr) + hdr.zone.len;
+		if( !zone_match(&hdr.zone, time_start, time_end, sector_start, sector_end, filter_pid) )
+			continue;
 
-		// Calculate average time(path interval)
-		for(i=0 ; i<pnugget_path->elemidx ; i++)
-		{
-			if(pnugget_path->data_time_interval_read[i].count != 0)
-			{
-				pnugget_path->data_time_interval_read[i].average_time = pnugget_path->data_time_interval_read[i].total_time / pnugget_path->data_time_interval_read[i].count;
+		pblk = (struct dio_block*)calloc(1, sizeof(struct dio_block));
+		if( pblk != NULL ){
+			pblk->raw = (char*)malloc(hdr.zone.len);
+			pblk->pcol = (struct col_group_header*)malloc(sizeof(hdr));
+		}
+		if( pblk == NULL || pblk->raw == NULL || pblk->pcol == NULL ){
+			perror("failed to allocate memory");
+			__atomic_store_n(&ingest_failed, true, __ATOMIC_RELEASE);
+			if( pblk != NULL ){
+				free(pblk->raw);
+				free(pblk->pcol);
 			}
-			if(pnugget_path->data_time_interval_write[i].count != 0)
-			{
-				pnugget_path->data_time_interval_write[i].average_time = pnugget_path->data_time_interval_write[i].total_time / pnugget_path->data_time_interval_write[i].count;
+			free(pblk);
+			break;
+		}
+		*pblk->pcol = hdr;
+		pblk->off = hdr.zone.off;
+
+		for(pblk->rawlen=0; pblk->rawlen < hdr.zone.len; pblk->rawlen += rdsz){
+			rdsz = pread(ifd, pblk->raw + pblk->rawlen, hdr.zone.len - pblk->rawlen, hdr.zone.off + pblk->rawlen);
+			if( rdsz < 0 && errno == EINTR ){
+				rdsz = 0;
+				continue;
 			}
-	
-			// if min_time is -1 that initializing value for calculating min_time, change that to 0.
-			if(pnugget_path->data_time_interval_read[i].min_time == -1)
-			{
-				pnugget_path->data_time_interval_read[i].min_time = 0;
+			if( rdsz <= 0 )
+				break;
+		}
+		if( pblk->rawlen < hdr.zone.len ){
+			if( rdsz < 0 ){
+				perror("failed to read");
+				__atomic_store_n(&ingest_failed, true, __ATOMIC_RELEASE);
 			}
-			if(pnugget_path->data_time_interval_write[i].min_time == -1)
-			{
-				pnugget_path->data_time_interval_write[i].min_time = 0;
+			else{
+				fprintf(stderr, "skipped truncated row group at %llu\n", (unsigned long long)(hdr.zone.off - sizeof(hdr)));
+				__atomic_add_fetch(&col_broken_cnt, 1, __ATOMIC_RELAXED);
 			}
+			free(pblk->raw);
+			free(pblk->pcol);
+			free(pblk);
+			break;
 		}
-		if(instr(pnugget_path->states, "P") || instr(pnugget_path->states, "U") || instr(pnugget_path->states, "?"))
-		{
+
+		spsc_push(&decoders[nblk % decoder_cnt].inq, pblk);
+		nblk++;
+	}
+
+	for(i=0; i<decoder_cnt; i++)
+		spsc_push(&decoders[(nblk + i) % decoder_cnt].inq, NULL);
+	return NULL;
+}
+
+bool convert_trace(int ifd, const char* path){
+	struct col_writer wr;
+	struct blk_io_trace bit;
+	struct dio_resync* prs = NULL;
+	char* buf = NULL;
+	size_t len = 0, off = 0, used = 0, valid = 0;
+	uint64_t pos = 0;
+	ssize_t rdsz = 0;
+	bool ok = true;
+
+	buf = (char*)malloc(INGEST_BLOCK_SIZE);
+	prs = (struct dio_resync*)calloc(1, sizeof(struct dio_resync));
+	if( buf == NULL || prs == NULL || !col_writer_open(&wr, path) ){
+		free(buf);
+		free(prs);
+		return false;
+	}
+
+	while( ok ){
+		rdsz = read(ifd, buf + len, INGEST_BLOCK_SIZE - len);
+		if( rdsz < 0 && errno == EINTR )
 			continue;
+		if( rdsz < 0 ){
+			ok = false;
+			break;
+		}
+		len += rdsz;
+
+		//a bit cut at the end of buffer is left for the next read
+		used = pack_bits(prs, buf, len, pos, rdsz == 0, &valid);
+		for(off=0; off < valid; off += bit_len(buf + off)){
+			memcpy(&bit, buf + off, sizeof(struct blk_io_trace));
+			if( is_swapped )
+				swap_bits(&bit, 1);
+			if( (bit.action >> BLK_TC_SHIFT) == BLK_TC_NOTIFY )
+				continue;
+			if( !col_writer_add(&wr, &bit) ){
+				ok = false;
+				break;
+			}
 		}
+		memmove(buf, buf + used, len - used);
+		len -= used;
+		pos += used;
+		if( rdsz == 0 )
+			break;
+	}
+	resync_done(prs);
 
-		if(is_graphic)
-		{
-			print_path_statistic_graphic(pnugget_path);
+	if( !col_writer_close(&wr) )
+		ok = false;
+	free(buf);
+	free(prs);
+	return ok;
+}
+
+// bits of the same time keep the file order, and 'bits' of a block is in file order
+static int cmp_bit_time(const void* p1, const void* p2){
+	const struct blk_io_trace* pbit1 = *(const struct blk_io_trace* const*)p1;
+	const struct blk_io_trace* pbit2 = *(const struct blk_io_trace* const*)p2;
+
+	if( pbit1->time != pbit2->time )
+		return (pbit1->time < pbit2->time) ? -1 : 1;
+	if( pbit1 != pbit2 )
+		return (pbit1 < pbit2) ? -1 : 1;
+	return 0;
+}
+
+// decode the raw bits of the block. bits are copied out of the pdus in batches,
+// and the filter kernel picks the bits of a batch at once.
+// return whether they are in time order
+static bool decode_raw_block(struct dio_block* pblk){
+	struct blk_io_trace batch[DECODE_BATCH];
+	uint32_t sel[DECODE_BATCH];
+	struct blk_io_trace* pbit = NULL;
+	size_t off = 0, n = 0, selcnt = 0, i = 0;
+	bool sorted = true;
+
+	pblk->bits = (struct blk_io_trace*)malloc(pblk->rawlen);
+	pblk->run = (struct blk_io_trace**)malloc(pblk->rawlen / sizeof(struct blk_io_trace) * sizeof(void*));
+	if( pblk->bits == NULL || pblk->run == NULL ){
+		perror("failed to allocate memory");
+		__atomic_store_n(&ingest_failed, true, __ATOMIC_RELEASE);
+		pblk->rawlen = 0;
+	}
+
+	zone_init(&pblk->zone, pblk->off, pblk->filelen);
+	for(off=0; off < pblk->rawlen; ){
+		for(n=0; n < DECODE_BATCH && off < pblk->rawlen; off += bit_len(pblk->raw + off))
+			memcpy(&batch[n++], pblk->raw + off, sizeof(struct blk_io_trace));
+		if( is_swapped )
+			swap_bits(batch, n);
+
+		//the zone has all the bits which can pass a filter
+		for(i=0; is_index && i<n; i++){
+			if( (batch[i].action >> BLK_TC_SHIFT) != BLK_TC_NOTIFY )
+				zone_add(&pblk->zone, &batch[i]);
 		}
-		else
-		{
-			print_path_statistic_text(pnugget_path);
+
+		//filter
+		selcnt = filter_bits(&bit_filter, batch, n, sel);
+		for(i=0; i<selcnt; i++){
+			if( bit_expr != NULL && !expr_eval(bit_expr, &batch[sel[i]]) )
+				continue;
+			pbit = &pblk->bits[pblk->cnt];
+			*pbit = batch[sel[i]];
+			if( pblk->cnt > 0 && pblk->run[pblk->cnt-1]->time > pbit->time )
+				sorted = false;
+			pblk->run[pblk->cnt++] = pbit;
 		}
 	}
+	return sorted;
+}
 
-	// Free all dynamic allocated variables.
-	struct dio_nugget_path* tmpdng_path;
-
-	list_for_each_entry_safe(pnugget_path, tmpdng_path, &nugget_path_head, link)
-	{
-		list_del(&pnugget_path->link);
-		free(pnugget_path->data_time_interval_read);
-		free(pnugget_path->data_time_interval_write);
-		free(pnugget_path);
+// decode the row group of the block. the columns of the filter are decoded first
+// and the others only when some rows pass. return whether the bits are in time order
+static bool decode_col_block(struct dio_block* pblk){
+	struct col_group_header* phdr = pblk->pcol;
+	struct blk_io_trace* pbit = NULL;
+	uint64_t* vals[COL_CNT];
+	uint32_t* sel = NULL;
+	size_t rows = phdr->zone.cnt, selcnt = 0, i = 0;
+	bool sorted = true;
+	int col = 0;
+
+	vals[0] = (uint64_t*)malloc(sizeof(uint64_t) * COL_CNT * rows);
+	sel = (uint32_t*)malloc(sizeof(uint32_t) * rows);
+	if( vals[0] == NULL || sel == NULL ){
+		perror("failed to allocate memory");
+		__atomic_store_n(&ingest_failed, true, __ATOMIC_RELEASE);
+		goto out;
+	}
+	for(col=1; col<COL_CNT; col++)
+		vals[col] = vals[0] + rows * col;
+
+	if( !col_decode(phdr, (uint8_t*)pblk->raw, COL_TIME, vals[COL_TIME]) ||
+		!col_decode(phdr, (uint8_t*)pblk->raw, COL_SECTOR, vals[COL_SECTOR]) ||
+		!col_decode(phdr, (uint8_t*)pblk->raw, COL_PID, vals[COL_PID]) ||
+		!col_decode(phdr, (uint8_t*)pblk->raw, COL_ACTION, vals[COL_ACTION]) )
+		goto broken;
+
+	selcnt = filter_cols(&bit_filter, vals[COL_TIME], vals[COL_SECTOR], vals[COL_PID], vals[COL_ACTION], rows, sel);
+	if( selcnt == 0 )
+		goto out;
+
+	if( !col_decode(phdr, (uint8_t*)pblk->raw, COL_BYTES, vals[COL_BYTES]) ||
+		!col_decode(phdr, (uint8_t*)pblk->raw, COL_DEVICE, vals[COL_DEVICE]) ||
+		!col_decode(phdr, (uint8_t*)pblk->raw, COL_CPU, vals[COL_CPU]) ||
+		!col_decode(phdr, (uint8_t*)pblk->raw, COL_ERROR, vals[COL_ERROR]) )
+		goto broken;
+
+	pblk->bits = (struct blk_io_trace*)calloc(selcnt, sizeof(struct blk_io_trace));
+	pblk->run = (struct blk_io_trace**)malloc(sizeof(struct blk_io_trace*) * selcnt);
+	if( pblk->bits == NULL || pblk->run == NULL ){
+		perror("failed to allocate memory");
+		__atomic_store_n(&ingest_failed, true, __ATOMIC_RELEASE);
+		goto out;
 	}
+	for(i=0; i<selcnt; i++){
+		pbit = &pblk->bits[pblk->cnt];
+		pbit->magic = BLK_IO_TRACE_MAGIC | BLK_IO_TRACE_VERSION;
+		pbit->time = vals[COL_TIME][sel[i]];
+		pbit->sector = vals[COL_SECTOR][sel[i]];
+		pbit->bytes = (uint32_t)vals[COL_BYTES][sel[i]];
+		pbit->action = (uint32_t)vals[COL_ACTION][sel[i]];
+		pbit->pid = (uint32_t)vals[COL_PID][sel[i]];
+		pbit->device = (uint32_t)vals[COL_DEVICE][sel[i]];
+		pbit->cpu = (uint32_t)vals[COL_CPU][sel[i]];
+		pbit->error = (uint16_t)vals[COL_ERROR][sel[i]];
+		if( bit_expr != NULL && !expr_eval(bit_expr, pbit) )
+			continue;
 
-	if(fPathData != NULL)
-	{
-		fclose(fPathData);
-		system("gnuplot path.cmd -p");
+		if( pblk->cnt > 0 && pblk->run[pblk->cnt-1]->time > pbit->time )
+			sorted = false;
+		pblk->run[pblk->cnt++] = pbit;
 	}
+	goto out;
+
+broken:
+	//the group is skipped like the broken bytes of raw input
+	fprintf(stderr, "skipped broken row group at %llu\n", (unsigned long long)(phdr->zone.off - sizeof(*phdr)));
+	__atomic_add_fetch(&col_broken_cnt, 1, __ATOMIC_RELAXED);
+out:
+	free(vals[0]);
+	free(sel);
+	free(pblk->pcol);
+	pblk->pcol = NULL;
+	return sorted;
 }
 
-void print_path_statistic_graphic(struct dio_nugget_path* pnugget_path)
-{
-	fprintf(fPathData, "%s %d %d\n", pnugget_path->states, pnugget_path->data_time_read.count, pnugget_path->data_time_write.count);
+void* decode_blocks(void* param){
+	struct dio_decoder* pdec = (struct dio_decoder*)param;
+	struct dio_block* pblk = NULL;
+	bool sorted = true;
+
+	while( (pblk = (struct dio_block*)spsc_pop(&pdec->inq)) != NULL ){
+		pblk->cnt = 0;
+		if( pblk->pcol != NULL )
+			sorted = decode_col_block(pblk);
+		else
+			sorted = decode_raw_block(pblk);
+		free(pblk->raw);
+		pblk->raw = NULL;
+
+		if( !sorted )
+			qsort(pblk->run, pblk->cnt, sizeof(struct blk_io_trace*), cmp_bit_time);
+		spsc_push(&pdec->outq, pblk);
+	}
+
+	spsc_push(&pdec->outq, NULL);
+	return NULL;
 }
 
-void print_path_statistic_text(struct dio_nugget_path* pnugget_path)
-{
-	int i;
+bool merge_runs(struct dio_run* older, struct dio_run* newer, struct dio_run* merged){
+	size_t i = 0, j = 0, k = 0;
 
-	//printing
-	fprintf(output, "%20s %6s ", pnugget_path->states, "Read");
-	print_data_time_statistic(output, &pnugget_path->data_time_read);
-	fprintf(output, "\n");
+	merged->cnt = older->cnt + newer->cnt;
+	merged->bits = (struct blk_io_trace**)malloc(sizeof(struct blk_io_trace*) * (merged->cnt + 1));
+	if( merged->bits == NULL )
+		return false;
 
-	fprintf(output, "%20s %6s ", " ", "Write");
-	print_data_time_statistic(output, &pnugget_path->data_time_write);
-	fprintf(output, "\n");
+	while( i < older->cnt && j < newer->cnt ){
+		if( newer->bits[j]->time < older->bits[i]->time )
+			merged->bits[k++] = newer->bits[j++];
+		else
+			merged->bits[k++] = older->bits[i++];
+	}
+	while( i < older->cnt )
+		merged->bits[k++] = older->bits[i++];
+	while( j < newer->cnt )
+		merged->bits[k++] = newer->bits[j++];
+	return true;
+}
 
-	for(i=0 ; i<pnugget_path->elemidx-1 ; i++)
-	{
-		fprintf(output, "%18s%.2s %6s ", " ", &pnugget_path->states[i], "Read");
-		print_data_time_statistic(output, &pnugget_path->data_time_interval_read[i]);
-		if(pnugget_path->data_time_read.average_time != 0)
-		{
-			fprintf(output, " %2.2f%%", ((double)pnugget_path->data_time_interval_read[i].average_time / pnugget_path->data_time_read.average_time) * 100);
+void stream_runs(struct dio_run* runs, int run_cnt){
+	size_t pos[MAX_RUN] = {0,};
+	struct blk_io_trace* pbit = NULL;
+	size_t n = 0;
+	int i = 0, min = 0;
+
+	for(n=0; n<time_bit_cnt; n++){
+		//the older run wins at the same time
+		min = -1;
+		for(i=0; i<run_cnt; i++){
+			if( pos[i] == runs[i].cnt )
+				continue;
+			if( min < 0 || runs[i].bits[pos[i]]->time < runs[min].bits[pos[min]]->time )
+				min = i;
 		}
+		pbit = runs[min].bits[pos[min]++];
+
+		time_bits[n] = pbit;
+		spsc_push(&shards[SHARD_OF(pbit->sector)].bitq, pbit);
+
+		//the shard of a front merged request is told when the request moves out
+		if( shard_cnt > 1 && GET_ACTION_CHAR(pbit->action) == 'F' &&
+			SHARD_OF(pbit->sector + pbit->bytes/512) != SHARD_OF(pbit->sector) )
+			spsc_push(&shards[SHARD_OF(pbit->sector + pbit->bytes/512)].bitq, pbit);
+
+		if( (n & 255) == 255 ){
+			__atomic_store_n(&time_bit_pub, n + 1, __ATOMIC_RELEASE);
+			futex_wake(&time_bit_sleep);
+		}
+	}
+	__atomic_store_n(&time_bit_pub, time_bit_cnt, __ATOMIC_RELEASE);
+	futex_wake(&time_bit_sleep);
+}
+
+bool ingest_bits(int ifd){
+	struct dio_run runs[MAX_RUN];
+	struct dio_run merged;
+	struct dio_block* pblk = NULL;
+	struct dio_block** pnext = &block_head;
+	struct dio_zone* newzones = NULL;
+	size_t zone_max = 0;
+	pthread_t reader_td;
+	int run_cnt = 0, stat_thread_cnt = 0, i = 0, j = 0, ret = 0;
+
+	//if a thread can't be made, the threads which are waiting on queues
+	//are just left to the end of program
+	for(i=0; i<decoder_cnt; i++){
+		if( !spsc_init(&decoders[i].inq, DECODER_INQ_SIZE) ||
+			!spsc_init(&decoders[i].outq, DECODER_OUTQ_SIZE) ){
+			perror("failed to initialize decoder");
+			return false;
+		}
+		ret = pthread_create(&decoders[i].td, NULL, decode_blocks, &decoders[i]);
+		if( ret ){
+			fprintf(stderr, "pthread_create(decoder:%d) failed:%d/%s\n", i, ret, strerror(ret));
+			return false;
+		}
+	}
+	if( is_col_input )
+		ret = pthread_create(&reader_td, NULL, read_col_groups, (void*)(intptr_t)ifd);
+	else
+		ret = pthread_create(&reader_td, NULL, zones != NULL ? read_zone_blocks : read_blocks, (void*)(intptr_t)ifd);
+	if( ret ){
+		fprintf(stderr, "pthread_create(reader) failed:%d/%s\n", ret, strerror(ret));
+		return false;
+	}
+
+	//collect the blocks in the order of file, and merge the runs while the file is read.
+	//a run is merged with the one below it until the sizes go down from the bottom,
+	//so only a few runs are left at the end of file. the top runs of a full stack
+	//are merged anyway, since blocks may get smaller one after another by the filters
+	for(i=0; (pblk = (struct dio_block*)spsc_pop(&decoders[i].outq)) != NULL; i=(i+1)%decoder_cnt){
+		*pnext = pblk;
+		pnext = &pblk->next;
+		if( is_index ){
+			if( zone_cnt == zone_max ){
+				zone_max = zone_max ? zone_max * 2 : 256;
+				newzones = (struct dio_zone*)realloc(zones, sizeof(struct dio_zone) * zone_max);
+				if( newzones == NULL ){
+					perror("failed to allocate memory");
+					return false;
+				}
+				zones = newzones;
+			}
+			zones[zone_cnt++] = pblk->zone;
+		}
+		if( pblk->cnt == 0 )
+			continue;
+
+		runs[run_cnt].bits = pblk->run;
+		runs[run_cnt].cnt = pblk->cnt;
+		pblk->run = NULL;
+		run_cnt++;
+		while( run_cnt >= 2 && (runs[run_cnt-2].cnt <= runs[run_cnt-1].cnt || run_cnt == MAX_RUN) ){
+			if( !merge_runs(&runs[run_cnt-2], &runs[run_cnt-1], &merged) ){
+				perror("failed to merge bits");
+				return false;
+			}
+			free(runs[run_cnt-2].bits);
+			free(runs[run_cnt-1].bits);
+			runs[run_cnt-2] = merged;
+			run_cnt--;
+		}
+	}
+
+	//each of the other decoders has sent NULL too
+	for(j=1; j<decoder_cnt; j++)
+		spsc_pop(&decoders[(i+j)%decoder_cnt].outq);
+	pthread_join(reader_td, NULL);
+	for(i=0; i<decoder_cnt; i++){
+		pthread_join(decoders[i].td, NULL);
+		spsc_destroy(&decoders[i].inq);
+		spsc_destroy(&decoders[i].outq);
+	}
+	if( __atomic_load_n(&ingest_failed, __ATOMIC_ACQUIRE) )
+		return false;
+	if( col_broken_cnt > 0 && col_broken_cnt == col_group_cnt ){
+		fprintf(stderr, "no row group could be read\n");
+		return false;
+	}
+
+	//the last merge feeds the shards and the bit statistics
+	for(i=0; i<run_cnt; i++)
+		time_bit_cnt += runs[i].cnt;
+	time_bits = (struct blk_io_trace**)malloc(sizeof(struct blk_io_trace*) * (time_bit_cnt + 1));
+	if( time_bits == NULL ){
+		perror("failed to allocate memory");
+		return false;
+	}
+
+	for(i=0; i<shard_cnt; i++){
+		ret = pthread_create(&shards[i].td, NULL, build_shard, &shards[i]);
+		if( ret ){
+			fprintf(stderr, "pthread_create(shard:%d) failed:%d/%s\n", i, ret, strerror(ret));
+			return false;
+		}
+	}
+
+	//bit statistic workers take their slices of the time ordered bits
+	for(i=0; i<stat_worker_cnt; i++){
+		if( !init_stat_worker(&bit_workers[i], &bit_stats, bit_stat_cnt) ){
+			perror("failed to initialize statistic");
+			return false;
+		}
+		bit_workers[i].start = time_bit_cnt * i / stat_worker_cnt;
+		bit_workers[i].end = time_bit_cnt * (i+1) / stat_worker_cnt;
+	}
+	for(stat_thread_cnt=0; stat_thread_cnt<stat_worker_cnt; stat_thread_cnt++){
+		ret = pthread_create(&bit_workers[stat_thread_cnt].td, NULL, statistic_list_for_each, &bit_workers[stat_thread_cnt]);
+		if( ret ){
+			fprintf(stderr, "pthread_create(statistic:%d) failed:%d/%s\n", stat_thread_cnt, ret, strerror(ret));
+			break;
+		}
+	}
+
+	stream_runs(runs, run_cnt);
+	for(i=0; i<run_cnt; i++)
+		free(runs[i].bits);
+
+	for(i=0; i<shard_cnt; i++){
+		spsc_push(&shards[i].bitq, NULL);
+		pthread_join(shards[i].td, NULL);
+	}
+
+	//the slices which have no thread are iterated here
+	for(i=0; i<stat_thread_cnt; i++)
+		pthread_join(bit_workers[i].td, NULL);
+	for(i=stat_thread_cnt; i<stat_worker_cnt; i++)
+		statistic_list_for_each(&bit_workers[i]);
+
+	return finish_shards();
+}
+
+//------------------- shard ----------------------------------------//
+bool init_shard(struct dio_shard* psh){
+	memset(psh, 0, sizeof(struct dio_shard));
+	bpt_init(&psh->sec_index);
+	psh->endidx_root = RB_ROOT;
+	if( !spsc_init(&psh->bitq, SHARD_BITQ_SIZE) )
+		return false;
+	return ngtable_init(&psh->active_ngs, NGTABLE_INIT_SIZE);
+}
+
+void destroy_shard(struct dio_shard* psh){
+	spsc_destroy(&psh->bitq);
+	ngtable_destroy(&psh->active_ngs);
+	bpt_destroy(&psh->sec_index);
+	arena_destroy(&psh->arena);
+	free(psh->pendings);
+	memset(psh, 0, sizeof(struct dio_shard));
+}
+
+void add_pending_merge(struct dio_shard* psh, struct dio_nugget* pdng, struct dio_nugget* pstandin, int bytes){
+	struct dio_pending_merge* newpms = NULL;
+
+	if( psh->pending_cnt == psh->pending_max ){
+		psh->pending_max = psh->pending_max ? psh->pending_max * 2 : 64;
+		newpms = (struct dio_pending_merge*)realloc(psh->pendings, sizeof(struct dio_pending_merge) * psh->pending_max);
+		if( newpms == NULL ){
+			DBGOUT("failed to keep pending merge\n");
+			psh->failed = true;
+			return;
+		}
+		psh->pendings = newpms;
+	}
+
+	psh->pendings[psh->pending_cnt].pdng = pdng;
+	psh->pendings[psh->pending_cnt].pstandin = pstandin;
+	psh->pendings[psh->pending_cnt].bytes = bytes;
+	psh->pendings[psh->pending_cnt].time = pdng->times[pdng->elemidx];
+	psh->pending_cnt++;
+}
+
+void retire_front_merged(struct dio_shard* psh, struct blk_io_trace* pbit){
+	struct dio_nugget* preq = NULL;
+
+	preq = ngtable_find(&psh->active_ngs, pbit->device, pbit->sector + pbit->bytes/512);
+	if( preq == NULL )
+		return;
+	retire_nugget(psh, preq);
+	preq->ngflag = NG_PENDING;
+}
+
+struct dio_nugget* new_standin(struct dio_shard* psh, struct blk_io_trace* pbit){
+	struct dio_nugget* pstandin = NULL;
+
+	pstandin = (struct dio_nugget*)arena_alloc(&psh->arena, sizeof(struct dio_nugget));
+	if( pstandin == NULL ){
+		perror("failed to allocate nugget memory");
+		return NULL;
+	}
+
+	//the end of the request is not known, so it is not in the end sector index
+	init_nugget(pstandin);
+	pstandin->sector = pbit->sector;
+	pstandin->device = pbit->device;
+	pstandin->size = pbit->bytes;
+	pstandin->ngflag = NG_STANDIN;
+	if( !link_nugget_at(psh, pstandin, pstandin->sector) )
+		return NULL;
+	if( !ngtable_insert(&psh->active_ngs, pstandin) ){
+		perror("failed to grow active nugget table");
+		list_del(&pstandin->nglink);
+		return NULL;
+	}
+	return pstandin;
+}
+
+void* build_shard(void* param){
+	struct dio_shard* psh = (struct dio_shard*)param;
+	struct dio_nugget* pdng = NULL;
+	struct blk_io_trace* pbit = NULL;
+
+	//bits come in time order until NULL.
+	//a failed shard keeps draining its queue not to block the sorter
+	while( (pbit = (struct blk_io_trace*)spsc_pop(&psh->bitq)) != NULL ){
+		if( psh->failed )
+			continue;
+		if( &shards[SHARD_OF(pbit->sector)] != psh ){
+			retire_front_merged(psh, pbit);
+			continue;
+		}
+
+		pdng = get_nugget_at(psh, pbit->device, pbit->sector);
+		if( pdng == NULL ){
+			DBGOUT(">failed to get nugget at sector %llu\n", (unsigned long long)pbit->sector);
+			psh->failed = true;
+			continue;
+		}
+		extract_nugget(psh, pbit, pdng);
+	}
+	return NULL;
+}
+
+bool finish_shards(void){
+	int i = 0;
+	bool success = true;
+
+	//nuggets in flight are not needed anymore
+	for(i=0; i<shard_cnt; i++){
+		if( shards[i].failed )
+			success = false;
+		ngtable_destroy(&shards[i].active_ngs);
+		shards[i].endidx_root = RB_ROOT;
+	}
+
+	if( success )
+		reconcile_shards();
+	return success;
+}
+
+static int cmp_pending_merge(const void* p1, const void* p2){
+	const struct dio_pending_merge* ppm1 = (const struct dio_pending_merge*)p1;
+	const struct dio_pending_merge* ppm2 = (const struct dio_pending_merge*)p2;
+
+	if( ppm1->time != ppm2->time )
+		return (ppm1->time < ppm2->time) ? -1 : 1;
+	return 0;
+}
+
+void reconcile_shards(void){
+	struct dio_pending_merge* ppms = NULL;
+	size_t cnt = 0, i = 0;
+	int j = 0;
+
+	for(j=0; j<shard_cnt; j++)
+		cnt += shards[j].pending_cnt;
+	if( cnt == 0 )
+		return;
+
+	ppms = (struct dio_pending_merge*)malloc(sizeof(struct dio_pending_merge) * cnt);
+	if( ppms == NULL ){
+		perror("failed to reconcile merges between shards");
+		return;
+	}
+	for(j=0; j<shard_cnt; j++){
+		memcpy(ppms + i, shards[j].pendings, sizeof(struct dio_pending_merge) * shards[j].pending_cnt);
+		i += shards[j].pending_cnt;
+	}
+
+	//a request may get several merges, so apply them as they happened
+	qsort(ppms, cnt, sizeof(struct dio_pending_merge), cmp_pending_merge);
+	for(i=0; i<cnt; i++){
+		if( ppms[i].pstandin == NULL )
+			reconcile_back_merge(&ppms[i]);
+		else
+			reconcile_front_merge(&ppms[i]);
+	}
+
+	free(ppms);
+}
+
+// whether the nugget was a request in flight at 'time'. the flag can't tell it,
+// since a bio at the sector of a request is appended to the request and
+// may be merged later
+static bool was_in_flight(struct dio_nugget* pdng, uint64_t time){
+	int i = 0;
+
+	if( pdng->elemidx == 0 || pdng->times[0] > time )
+		return false;
+	for(i=0; i<pdng->elemidx && pdng->times[i] < time; i++){
+		if( pdng->states[i] == 'M' || pdng->states[i] == 'F' || pdng->states[i] == 'C' )
+			return false;
+	}
+	return true;
+}
+
+void reconcile_back_merge(struct dio_pending_merge* ppm){
+	struct dio_nugget* pdng = ppm->pdng;
+	struct dio_nugget* preq = NULL;
+	struct dio_nugget* pcand = NULL;
+	struct dio_secentity* psecen = NULL;
+	struct dio_secwalk walk;
+	uint64_t from = 0;
+
+	if( pdng->sector == 0 )
+		return;
+
+	//the request ends at the sector of the bio and was in flight at that time
+	from = (pdng->sector > MAX_REQ_SECTORS) ? pdng->sector - MAX_REQ_SECTORS : 0;
+	secwalk_init(&walk, from, pdng->sector - 1);
+	while( (psecen = secwalk_next(&walk)) != NULL ){
+		list_for_each_entry(pcand, &psecen->nghead, nglink){
+			if( pcand->device != pdng->device || NG_END_SECTOR(pcand) != pdng->sector )
+				continue;
+			if( !was_in_flight(pcand, ppm->time) )
+				continue;
+			if( preq == NULL || preq->times[0] < pcand->times[0] )
+				preq = pcand;
+		}
+	}
+
+	if( preq == NULL ){
+		DBGOUT("Failed to search nugget when back merging\n");
+		return;
+	}
+	pdng->mlink = preq;
+	preq->size += ppm->bytes;
+}
+
+void reconcile_front_merge(struct dio_pending_merge* ppm){
+	struct dio_nugget* pdng = ppm->pdng;
+	struct dio_nugget* pstandin = ppm->pstandin;
+	struct dio_nugget* preq = NULL;
+	struct dio_nugget* pcand = NULL;
+	struct dio_secentity* psecen = NULL;
+	uint64_t reqsect = pdng->sector + ppm->bytes/512;
+
+	//the request was retired by the merge in its shard.
+	//an earlier front merge may have moved it to the sector already
+	psecen = (struct dio_secentity*)bpt_search(&shards[SHARD_OF(reqsect)].sec_index, reqsect);
+	if( psecen != NULL ){
+		list_for_each_entry(pcand, &psecen->nghead, nglink){
+			if( pcand->device != pdng->device || pcand->ngflag != NG_PENDING ||
+				pcand->elemidx == 0 || pcand->times[0] > ppm->time )
+				continue;
+			if( preq == NULL || preq->times[0] < pcand->times[0] )
+				preq = pcand;
+		}
+	}
+	if( preq == NULL ){
+		//the stand-in is left as the request
+		DBGOUT("Failed to search nugget when front merging\n");
+		if( pstandin->ngflag == NG_STANDIN )
+			pstandin->ngflag = NG_ACTIVE;
+		return;
+	}
+
+	//the request takes the place and the states of its stand-in
+	pdng->mlink = preq;
+	list_del(&preq->nglink);
+	list_add(&preq->nglink, &pstandin->nglink);
+	list_del(&pstandin->nglink);
+	preq->sector = pstandin->sector;
+	preq->size += pstandin->size;
+	append_nugget(preq, pstandin);
+	if( preq->ngflag == NG_STANDIN )
+		preq->ngflag = NG_ACTIVE;
+}
+
+void secwalk_init(struct dio_secwalk* pwalk, uint64_t start, uint64_t end){
+	int i = 0;
+
+	for(i=0; i<shard_cnt; i++)
+		bpt_lower_bound(&shards[i].sec_index, start, &pwalk->itrs[i]);
+	pwalk->end = end;
+	pwalk->cur = -1;
+	pwalk->chunk_end = 0;
+}
+
+struct dio_secentity* secwalk_next(struct dio_secwalk* pwalk){
+	struct bpt_iter* pitr = NULL;
+	struct dio_secentity* psecen = NULL;
+	uint64_t key = 0, minkey = 0;
+	int i = 0;
+
+	//sectors of a chunk are all in one shard, so stay on it until the chunk ends
+	if( pwalk->cur >= 0 ){
+		pitr = &pwalk->itrs[pwalk->cur];
+		if( !bpt_iter_valid(pitr) || bpt_iter_key(pitr) >= pwalk->chunk_end )
+			pitr = NULL;
+	}
+
+	if( pitr == NULL ){
+		pwalk->cur = -1;
+		for(i=0; i<shard_cnt; i++){
+			if( !bpt_iter_valid(&pwalk->itrs[i]) )
+				continue;
+			key = bpt_iter_key(&pwalk->itrs[i]);
+			if( pwalk->cur < 0 || key < minkey ){
+				pwalk->cur = i;
+				minkey = key;
+			}
+		}
+		if( pwalk->cur < 0 )
+			return NULL;
+
+		pitr = &pwalk->itrs[pwalk->cur];
+		pwalk->chunk_end = ((minkey >> SHARD_CHUNK_SHIFT) + 1) << SHARD_CHUNK_SHIFT;
+		if( pwalk->chunk_end == 0 )	//the last chunk
+			pwalk->chunk_end = (uint64_t)(-1);
+	}
+
+	if( bpt_iter_key(pitr) > pwalk->end )
+		return NULL;
+
+	psecen = (struct dio_secentity*)bpt_iter_val(pitr);
+	bpt_iter_next(pitr);
+	return psecen;
+}
+
+//------------------- end sector index ------------------------------//
+static inline int endidx_cmp(uint32_t device, uint64_t end, struct dio_nugget* pdng){
+	if( device != pdng->device )
+		return (device < pdng->device) ? -1 : 1;
+	if( end != NG_END_SECTOR(pdng) )
+		return (end < NG_END_SECTOR(pdng)) ? -1 : 1;
+	return 0;
+}
+
+void endidx_insert(struct dio_shard* psh, struct dio_nugget* pdng){
+	struct rb_node** p = &psh->endidx_root.rb_node;
+	struct rb_node* parent = NULL;
+	uint64_t end = NG_END_SECTOR(pdng);
+
+	if( !RB_EMPTY_NODE(&pdng->endlink) )
+		return;	//already indexed
+	if( pdng->ngflag == NG_STANDIN )
+		return;	//its end is in other shard
+
+	//same keys are allowed. the later one goes right
+	while(*p){
+		parent = *p;
+		if( endidx_cmp(pdng->device, end, rb_entry(parent, struct dio_nugget, endlink)) < 0 )
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+
+	rb_link_node(&pdng->endlink, parent, p);
+	rb_insert_color(&pdng->endlink, &psh->endidx_root);
+}
+
+void endidx_remove(struct dio_shard* psh, struct dio_nugget* pdng){
+	if( RB_EMPTY_NODE(&pdng->endlink) )
+		return;
+
+	rb_erase(&pdng->endlink, &psh->endidx_root);
+	RB_CLEAR_NODE(&pdng->endlink);
+}
+
+struct dio_nugget* endidx_search(struct dio_shard* psh, uint32_t device, uint64_t end){
+	struct rb_node* p = psh->endidx_root.rb_node;
+	struct dio_nugget* pdng = NULL;
+	int cmp = 0;
+
+	while(p){
+		pdng = rb_entry(p, struct dio_nugget, endlink);
+		cmp = endidx_cmp(device, end, pdng);
+		if( cmp < 0 )
+			p = p->rb_left;
+		else if( cmp > 0 )
+			p = p->rb_right;
+		else
+			return pdng;
+	}
+	return NULL;
+}
+
+//------------------- active nugget table --------------------------//
+static inline unsigned int ngtable_hash(uint32_t device, uint64_t sector){
+	uint64_t h = (sector ^ ((uint64_t)device << 40)) * 0x9E3779B97F4A7C15ULL;
+	return (unsigned int)(h >> 32);
+}
+
+bool ngtable_init(struct dio_ngtable* ptbl, unsigned int size){
+	ptbl->slots = (struct dio_ngslot*)calloc(size, sizeof(struct dio_ngslot));
+	if( ptbl->slots == NULL )
+		return false;
+
+	ptbl->mask = size - 1;
+	ptbl->cnt = 0;
+	return true;
+}
+
+void ngtable_destroy(struct dio_ngtable* ptbl){
+	free(ptbl->slots);
+	ptbl->slots = NULL;
+	ptbl->mask = 0;
+	ptbl->cnt = 0;
+}
+
+struct dio_nugget* ngtable_find(struct dio_ngtable* ptbl, uint32_t device, uint64_t sector){
+	unsigned int i = ngtable_hash(device, sector) & ptbl->mask;
+	struct dio_ngslot* pslot = NULL;
+
+	while( (pslot = &ptbl->slots[i])->pdng != NULL ){
+		if( pslot->sector == sector && pslot->device == device )
+			return pslot->pdng;
+		i = (i+1) & ptbl->mask;
+	}
+	return NULL;
+}
+
+// put the nugget on the first empty slot (or the slot of same key) of its probe sequence
+static void __ngtable_place(struct dio_ngtable* ptbl, uint32_t device, uint64_t sector,
+				struct dio_nugget* pdng){
+	unsigned int i = ngtable_hash(device, sector) & ptbl->mask;
+	struct dio_ngslot* pslot = NULL;
+
+	while( (pslot = &ptbl->slots[i])->pdng != NULL ){
+		if( pslot->sector == sector && pslot->device == device ){
+			//the old one is overwritten. it stays on the rbtree only
+			pslot->pdng = pdng;
+			return;
+		}
+		i = (i+1) & ptbl->mask;
+	}
+
+	pslot->sector = sector;
+	pslot->device = device;
+	pslot->pdng = pdng;
+	ptbl->cnt++;
+}
+
+static bool ngtable_grow(struct dio_ngtable* ptbl){
+	struct dio_ngtable newtbl;
+	unsigned int i = 0;
+
+	if( !ngtable_init(&newtbl, (ptbl->mask+1)*2) )
+		return false;
+
+	for(i=0; i<=ptbl->mask; i++){
+		struct dio_ngslot* pslot = &ptbl->slots[i];
+		if( pslot->pdng != NULL )
+			__ngtable_place(&newtbl, pslot->device, pslot->sector, pslot->pdng);
+	}
+
+	free(ptbl->slots);
+	*ptbl = newtbl;
+	return true;
+}
+
+bool ngtable_insert(struct dio_ngtable* ptbl, struct dio_nugget* pdng){
+	//keep the load factor under 1/2 for short probe sequences
+	if( (ptbl->cnt+1)*2 > ptbl->mask+1 && !ngtable_grow(ptbl) )
+		return false;
+
+	__ngtable_place(ptbl, pdng->device, pdng->sector, pdng);
+	return true;
+}
+
+void ngtable_remove(struct dio_ngtable* ptbl, struct dio_nugget* pdng){
+	unsigned int i = ngtable_hash(pdng->device, pdng->sector) & ptbl->mask;
+	unsigned int j = 0, k = 0;
+
+	while( ptbl->slots[i].pdng != pdng ){
+		if( ptbl->slots[i].pdng == NULL )
+			return;	//it is not in flight
+		i = (i+1) & ptbl->mask;
+	}
+
+	//shift back the following slots which can be placed on the hole
+	j = i;
+	while(1){
+		j = (j+1) & ptbl->mask;
+		if( ptbl->slots[j].pdng == NULL )
+			break;
+
+		k = ngtable_hash(ptbl->slots[j].device, ptbl->slots[j].sector) & ptbl->mask;
+		//slot j is still reachable if its home k is cyclically in (i, j]
+		if( (i <= j) ? (i < k && k <= j) : (i < k || k <= j) )
+			continue;
+
+		ptbl->slots[i] = ptbl->slots[j];
+		i = j;
+	}
+	ptbl->slots[i].pdng = NULL;
+	ptbl->cnt--;
+}
+
+bool add_nugget_stat_func(statistic_init_func stat_init_fn, 
+				statistic_travel_func stat_trv_fn,
+				statistic_merge_func stat_merge_fn,
+				statistic_process_func stat_proc_fn){
+	struct dio_stat* pst = (struct dio_stat*)malloc(sizeof(struct dio_stat));
+	if( pst == NULL ){
+		perror("failed to add statistic");
+		return false;
+	}
+
+	pst->init_fn = stat_init_fn;
+	pst->trv_fn = stat_trv_fn;
+	pst->merge_fn = stat_merge_fn;
+	pst->proc_fn = stat_proc_fn;
+	list_add_tail(&pst->link, &nugget_stats);
+	nugget_stat_cnt++;
+	return true;
+}
+
+bool add_bit_stat_func(statistic_init_func stat_init_fn,
+				statistic_itr_func stat_itr_fn,
+				statistic_merge_func stat_merge_fn,
+				statistic_process_func stat_proc_fn){
+	struct dio_stat* pst = (struct dio_stat*)malloc(sizeof(struct dio_stat));
+	if( pst == NULL ){
+		perror("failed to add statistic");
+		return false;
+	}
+
+	pst->init_fn = stat_init_fn;
+	pst->itr_fn = stat_itr_fn;
+	pst->merge_fn = stat_merge_fn;
+	pst->proc_fn = stat_proc_fn;
+	list_add_tail(&pst->link, &bit_stats);
+	bit_stat_cnt++;
+	return true;
+}
+
+bool init_stat_worker(struct dio_stat_worker* pwk, struct list_head* stats, int stat_cnt){
+	struct dio_stat* pst = NULL;
+	int i = 0;
+
+	pwk->cnt = 0;
+	pwk->parts = (void**)calloc(stat_cnt + 1, sizeof(void*));
+	if( pwk->parts == NULL )
+		return false;
+
+	list_for_each_entry(pst, stats, link){
+		if( pst->init_fn != NULL ){
+			pwk->parts[i] = pst->init_fn();
+			if( pwk->parts[i] == NULL )
+				return false;
+		}
+		i++;
+	}
+	return true;
+}
+
+void process_stat_workers(struct dio_stat_worker* pwks, int wk_cnt, struct list_head* stats){
+	struct dio_stat* pst = NULL;
+	int i = 0, w = 0, cnt = 0;
+
+	for(w=0; w<wk_cnt; w++)
+		cnt += pwks[w].cnt;
+
+	list_for_each_entry(pst, stats, link){
+		//merge in the order of traversal
+		for(w=1; w<wk_cnt; w++){
+			if( pst->merge_fn != NULL && pwks[w].parts[i] != NULL )
+				pst->merge_fn(pwks[0].parts[i], pwks[w].parts[i]);
+		}
+
+		//process data
+		if( pst->proc_fn != NULL )
+			pst->proc_fn(pwks[0].parts[i], cnt);
+		i++;
+	}
+
+	for(w=0; w<wk_cnt; w++){
+		free(pwks[w].parts);
+		pwks[w].parts = NULL;
+	}
+}
+
+// leaf of a sector index and its number of secentities
+struct dio_leafcnt{
+	uint64_t sector;
+	int cnt;
+};
+
+static int cmp_leafcnt(const void* p1, const void* p2){
+	const struct dio_leafcnt* plc1 = (const struct dio_leafcnt*)p1;
+	const struct dio_leafcnt* plc2 = (const struct dio_leafcnt*)p2;
+
+	if( plc1->sector != plc2->sector )
+		return (plc1->sector < plc2->sector) ? -1 : 1;
+	return 0;
+}
+
+void split_sector_range(uint64_t* bounds, int cnt){
+	struct dio_leafcnt* plcs = NULL;
+	struct bpt_leaf* leaf = NULL;
+	size_t leaf_cnt = 0, n = 0, total = 0, sum = 0;
+	int i = 0, k = 1;
+
+	bounds[0] = sector_start;
+	for(i=1; i<cnt; i++)
+		bounds[i] = sector_end;
+	if( cnt == 1 )
+		return;
+
+	//the leaves tell how the secentities are spread without touching all of them
+	for(i=0; i<shard_cnt; i++){
+		for(leaf=shards[i].sec_index.first; leaf != NULL; leaf=leaf->next)
+			leaf_cnt++;
+	}
+	plcs = (struct dio_leafcnt*)malloc(sizeof(struct dio_leafcnt) * (leaf_cnt + 1));
+	if( plcs == NULL )
+		return;	//almost all in the first range
+	for(i=0; i<shard_cnt; i++){
+		for(leaf=shards[i].sec_index.first; leaf != NULL; leaf=leaf->next){
+			if( leaf->nkeys == 0 )
+				continue;
+			plcs[n].sector = leaf->keys[0];
+			plcs[n].cnt = leaf->nkeys;
+			total += leaf->nkeys;
+			n++;
+		}
+	}
+	qsort(plcs, n, sizeof(struct dio_leafcnt), cmp_leafcnt);
+
+	for(i=0; i<(int)n && k<cnt; i++){
+		while( k < cnt && sum >= total * k / cnt ){
+			bounds[k] = plcs[i].sector;
+			if( bounds[k] < bounds[k-1] )
+				bounds[k] = bounds[k-1];
+			k++;
+		}
+		sum += plcs[i].cnt;
+	}
+	free(plcs);
+}
+
+void* travel_sector_range(void* param){
+	struct dio_stat_worker* pwk = (struct dio_stat_worker*)param;
+	struct dio_secwalk walk;
+	struct dio_secentity* psecen = NULL;
+	struct dio_nugget* pdng = NULL;
+	struct dio_stat* pst = NULL;
+	int i = 0;
+
+	secwalk_init(&walk, pwk->start, pwk->end);
+	while( (psecen = secwalk_next(&walk)) != NULL ){
+		list_for_each_entry(pdng, &psecen->nghead, nglink){
+			//traveling
+			i = 0;
+			list_for_each_entry(pst, &nugget_stats, link){
+				if( pst->trv_fn != NULL )
+					pst->trv_fn(pwk->parts[i], pdng);
+				i++;
+			}
+			pwk->cnt++;
+		}
+	}
+	return NULL;
+}
+
+void statistic_sector_traveling(){
+	struct dio_stat_worker wks[MAX_SHARD];
+	uint64_t bounds[MAX_SHARD];
+	int i = 0, thread_cnt = 0, ret = 0;
+
+	if( nugget_stat_cnt == 0 )
+		return;
+
+	//init all statistic functions
+	for(i=0; i<stat_worker_cnt; i++){
+		if( !init_stat_worker(&wks[i], &nugget_stats, nugget_stat_cnt) ){
+			perror("failed to initialize statistic");
+			return;
+		}
+	}
+
+	//only the sectors in sector filter range.
+	//each worker travels [bounds[i], bounds[i+1]), and the ranges are in sector order
+	split_sector_range(bounds, stat_worker_cnt);
+	for(i=0; i<stat_worker_cnt; i++){
+		wks[i].start = bounds[i];
+		wks[i].end = (i == stat_worker_cnt-1) ? sector_end : bounds[i+1] - 1;
+		if( i < stat_worker_cnt-1 && bounds[i+1] == bounds[i] ){
+			//empty range
+			wks[i].start = 1;
+			wks[i].end = 0;
+		}
+	}
+
+	for(thread_cnt=1; thread_cnt<stat_worker_cnt; thread_cnt++){
+		ret = pthread_create(&wks[thread_cnt].td, NULL, travel_sector_range, &wks[thread_cnt]);
+		if( ret ){
+			fprintf(stderr, "pthread_create(statistic:%d) failed:%d/%s\n", thread_cnt, ret, strerror(ret));
+			break;
+		}
+	}
+
+	//the first range and the ranges which have no thread are traveled here
+	travel_sector_range(&wks[0]);
+	for(i=thread_cnt; i<stat_worker_cnt; i++)
+		travel_sector_range(&wks[i]);
+	for(i=1; i<thread_cnt; i++)
+		pthread_join(wks[i].td, NULL);
+
+	process_stat_workers(wks, stat_worker_cnt, &nugget_stats);
+}
+
+void* statistic_list_for_each(void* param){
+	struct dio_stat_worker* pwk = (struct dio_stat_worker*)param;
+	struct dio_stat* pst = NULL;
+	uint64_t n = pwk->start, pub = 0;
+	int i=0, spin=0;
+
+	//the bits of the worker come as the sorter publishes them
+	while( n < pwk->end ){
+		pub = __atomic_load_n(&time_bit_pub, __ATOMIC_ACQUIRE);
+		if( pub <= n ){
+			if( spsc_spin(&spin) )
+				continue;
+			__atomic_store_n(&time_bit_sleep, 1, __ATOMIC_SEQ_CST);
+			if( __atomic_load_n(&time_bit_pub, __ATOMIC_SEQ_CST) <= n )
+				futex_sleep(&time_bit_sleep);
+			continue;
+		}
+		if( pub > pwk->end )
+			pub = pwk->end;
+
+		for(; n < pub; n++){
+			//foreach data
+			i = 0;
+			list_for_each_entry(pst, &bit_stats, link){
+				if( pst->itr_fn != NULL )
+					pst->itr_fn(pwk->parts[i], time_bits[n]);
+				i++;
+			}
+			pwk->cnt++;
+		}
+		spin = 0;
+	}
+	return NULL;
+}
+
+void statistic_list_process(){
+	if( bit_stat_cnt == 0 )
+		return;
+	process_stat_workers(bit_workers, stat_worker_cnt, &bit_stats);
+}
+
+//------------------- printing -------------------------------------//
+// path of the chart 'name' in the chart directory
+static void chart_file(char* path, const char* name){
+	snprintf(path, MAX_FILEPATH_LEN, "%s/dioparse.%s.svg", chart_dir, name);
+}
+
+static void set_rw_series(struct chart_series* series, const double* r, const double* w){
+	series[0].name = "read";
+	series[0].color = "darkblue";
+	series[0].vals = r;
+	series[1].name = "write";
+	series[1].color = "forestgreen";
+	series[1].vals = w;
+}
+
+// longest line of print_time and print_sector
+#define PRINT_ROW_MAX	96
+
+static size_t format_time_rows(char* buf, size_t start, size_t end, void* arg){
+	struct blk_io_trace* pbit = NULL;
+	char* p = buf;
+	size_t n = 0;
+
+	for(n=start; n<end; n++){
+		pbit = time_bits[n];
+		p = out_time(p, pbit->time);
+		*p++ = '\t';
+		p = out_u64(p, pbit->sector);
+		*p++ = '\t';
+		p = out_u64(p, pbit->pid);
+		*p++ = '\t';
+		p = out_u64(p, pbit->bytes/8);
+		*p++ = '\n';
+	}
+	return p - buf;
+}
+
+static const struct emit_col time_cols[] = {
+	{ "time_ns", EMIT_U64 }, { "sector", EMIT_U64 }, { "pid", EMIT_U64 }, { "size", EMIT_U64 }
+};
+
+void print_time(void* part, int bit_cnt) {
+	size_t n = 0;
+
+	if( out_format != EMIT_TEXT ) {
+		emit_table(&emitter, "time", time_cols, 4);
+		for(n=0; n<time_bit_cnt; n++) {
+			emit_row(&emitter);
+			emit_u64(&emitter, time_bits[n]->time);
+			emit_u64(&emitter, time_bits[n]->sector);
+			emit_u64(&emitter, time_bits[n]->pid);
+			emit_u64(&emitter, time_bits[n]->bytes/8);
+			emit_row_end(&emitter);
+		}
+		return;
+	}
+	if( !out_rows(output, time_bit_cnt, PRINT_ROW_MAX, stat_worker_cnt, format_time_rows, NULL) )
+		perror("failed to write");
+}
+
+static size_t format_sector_rows(char* buf, size_t start, size_t end, void* arg){
+	struct dio_nugget** ngs = (struct dio_nugget**)arg;
+	struct dio_nugget* pdng = NULL;
+	char* p = buf;
+	size_t n = 0;
+
+	for(n=start; n<end; n++){
+		pdng = ngs[n];
+		p = out_u64(p, pdng->sector);
+		*p++ = '\t';
+		p = out_time(p, pdng->times[pdng->elemidx-1] - pdng->times[0]);
+		*p++ = '\t';
+		p = out_u64(p, pdng->pid);
+		*p++ = '\t';
+		p = out_i64(p, pdng->size);
+		*p++ = '\n';
+	}
+	return p - buf;
+}
+
+static const struct emit_col sector_cols[] = {
+	{ "sector", EMIT_U64 }, { "latency_ns", EMIT_U64 }, { "pid", EMIT_U64 }, { "size", EMIT_U64 }
+};
+
+void print_sector(void* part, int ng_cnt) {
+
+	struct dio_secwalk walk;
+	struct dio_secentity* psecentity;
+	struct dio_nugget* pdng;
+	struct dio_nugget** ngs;
+	size_t n = 0, i = 0;
+
+	//the nuggets are gathered in sector order so that chunks of them are formatted in parallel
+	ngs = (struct dio_nugget**)malloc(sizeof(struct dio_nugget*) * (ng_cnt + 1));
+	if( ngs == NULL ) {
+		perror("failed to allocate memory");
+		return;
+	}
+
+	secwalk_init(&walk, sector_start, sector_end);
+	while((psecentity = secwalk_next(&walk)) != NULL) {
+		list_for_each_entry(pdng, &(psecentity->nghead), nglink) {
+			if( n < (size_t)ng_cnt )
+				ngs[n++] = pdng;
+		}
+	}
+
+	if( out_format != EMIT_TEXT ) {
+		emit_table(&emitter, "sector", sector_cols, 4);
+		for(i=0; i<n; i++) {
+			pdng = ngs[i];
+			emit_row(&emitter);
+			emit_u64(&emitter, pdng->sector);
+			emit_u64(&emitter, pdng->times[pdng->elemidx-1] - pdng->times[0]);
+			emit_u64(&emitter, pdng->pid);
+			emit_u64(&emitter, pdng->size);
+			emit_row_end(&emitter);
+		}
+	}
+	else if( !out_rows(output, n, PRINT_ROW_MAX, stat_worker_cnt, format_sector_rows, ngs) )
+		perror("failed to write");
+	free(ngs);
+}
+
+//------------------- i/o type statistics -------------------------------//
+void* init_type_statistic(){
+	return calloc(1, sizeof(struct type_stat));
+}
+
+void itr_type_statistic(void* part, struct blk_io_trace* pbit){
+	struct type_stat* pts = (struct type_stat*)part;
+	uint32_t category = pbit->action >> BLK_TC_SHIFT;
+
+	if( category & BLK_TC_READ )
+		pts->r_cnt++;
+	else if( category & BLK_TC_WRITE )
+		pts->w_cnt++;
+	else
+		pts->x_cnt++;
+}
+
+void merge_type_statistic(void* dst, void* src){
+	struct type_stat* pdst = (struct type_stat*)dst;
+	struct type_stat* psrc = (struct type_stat*)src;
+
+	pdst->r_cnt += psrc->r_cnt;
+	pdst->w_cnt += psrc->w_cnt;
+	pdst->x_cnt += psrc->x_cnt;
+	free(psrc);
+}
+
+static const struct emit_col type_cols[] = {
+	{ "rw", EMIT_STR }, { "count", EMIT_U64 }, { "percent", EMIT_F64 }
+};
+
+static void emit_type_row(const char* rw, int cnt, int bit_cnt){
+	emit_row(&emitter);
+	emit_str(&emitter, rw);
+	emit_u64(&emitter, cnt);
+	emit_f64(&emitter, cnt/(double)bit_cnt*100);
+	emit_row_end(&emitter);
+}
+
+void process_type_statistic(void* part, int bit_cnt){
+	struct type_stat* pts = (struct type_stat*)part;
+	int tot;
+
+	if( out_format != EMIT_TEXT ){
+		emit_table(&emitter, "type", type_cols, 3);
+		emit_type_row("R", pts->r_cnt, bit_cnt);
+		emit_type_row("W", pts->w_cnt, bit_cnt);
+		emit_type_row("Unknown", pts->x_cnt, bit_cnt);
+		free(pts);
+		return;
+	}
+	fprintf(output, "%7s %10s %13s\n", "TYPE","COUNT","PERCENTAGE");
+	
+	fprintf(output, "%7s %10d %13f\n", "R",pts->r_cnt, pts->r_cnt/(double)bit_cnt*100);
+	fprintf(output, "%7s %10d %13f\n", "W",pts->w_cnt,pts->w_cnt/(double)bit_cnt*100);
+	fprintf(output, "%7s %10d %13f\n", "Unknown",pts->x_cnt, pts->x_cnt/(double)bit_cnt*100);
+
+	tot = pts->r_cnt + pts->w_cnt + pts->x_cnt;
+	fprintf(output, "%7s %10d %13f\n", "Total :",tot, tot/(double)bit_cnt*100);
+	free(pts);
+}
+
+//------------------- path statistics ------------------------------//
+#define PATH_COL_CNT	12
+static const struct emit_col path_cols[PATH_COL_CNT] = {
+	{ "path", EMIT_STR }, { "interval", EMIT_STR }, { "rw", EMIT_STR }, EMIT_HIST_COLS, { "share_percent", EMIT_F64 }
+};
+static unsigned char path_action_idx[256];	//trie child index of an action
+
+int instr(const char* str1, const char* str2)
+{
+        int i, j;
+
+        i=0;
+        while(str1[i] != '\0')
+        {
+                j=0;
+                while(str2[j] != '\0')
+                {
+                        if(str1[i+j] != str2[j])
+                        {
+                                break;
+                        }
+                        j++;
+                }
+                if(str2[j] == '\0')
+                {
+                        return i+1;
+                }
+                i++;
+        }
+
+        return 0;
+}
+
+static int new_path_node(struct path_stat* pps)
+{
+	struct path_node* newnodes;
+
+	if(pps->node_cnt == pps->node_max)
+	{
+		pps->node_max = pps->node_max ? pps->node_max * 2 : 64;
+		newnodes = (struct path_node*)realloc(pps->nodes, sizeof(struct path_node) * pps->node_max);
+		if(newnodes == NULL)
+		{
+			return -1;
+		}
+		pps->nodes = newnodes;
+	}
+
+	memset(&pps->nodes[pps->node_cnt], 0, sizeof(struct path_node));
+	pps->nodes[pps->node_cnt].pathid = -1;
+	return pps->node_cnt++;
+}
+
+static int new_nugget_path(struct path_stat* pps, const char* states, int elemidx)
+{
+	struct dio_nugget_path*	newpaths;
+	struct dio_nugget_path*	pnugget_path;
+	int			i;
+
+	if(pps->path_cnt == pps->path_max)
+	{
+		pps->path_max = pps->path_max ? pps->path_max * 2 : 16;
+		newpaths = (struct dio_nugget_path*)realloc(pps->paths, sizeof(struct dio_nugget_path) * pps->path_max);
+		if(newpaths == NULL)
+		{
+			return -1;
+		}
+		pps->paths = newpaths;
+	}
+
+	pnugget_path = &pps->paths[pps->path_cnt];
+	memset(pnugget_path, 0, sizeof(struct dio_nugget_path));
+	pnugget_path->hist_interval_read = (struct dio_hist*)malloc(sizeof(struct dio_hist) * elemidx);
+	pnugget_path->hist_interval_write = (struct dio_hist*)malloc(sizeof(struct dio_hist) * elemidx);
+	if(pnugget_path->hist_interval_read == NULL || pnugget_path->hist_interval_write == NULL)
+	{
+		free(pnugget_path->hist_interval_read);
+		free(pnugget_path->hist_interval_write);
+		return -1;
+	}
+
+	// Init pnugget_path's members
+	pnugget_path->elemidx = elemidx;
+	hist_init(&pnugget_path->hist_read);
+	hist_init(&pnugget_path->hist_write);
+	for(i=0 ; i<elemidx ; i++)
+	{
+		hist_init(&pnugget_path->hist_interval_read[i]);
+		hist_init(&pnugget_path->hist_interval_write[i]);
+	}
+	memcpy(pnugget_path->states, states, elemidx);
+
+	return pps->path_cnt++;
+}
+
+// return the id of the path of 'states', making it if it is new.
+// -1 is returned only when memory allocation is failed
+int intern_nugget_path(struct path_stat* pps, const char* states, int elemidx)
+{
+	int	node = 0;
+	int	next;
+	int	i;
+	int	act;
+
+	for(i=0 ; i<elemidx ; i++)
+	{
+		act = path_action_idx[(unsigned char)states[i]];
+		next = pps->nodes[node].child[act];
+		if(next == 0)
+		{
+			next = new_path_node(pps);
+			if(next < 0)
+			{
+				return -1;
+			}
+			pps->nodes[node].child[act] = next;
+		}
+		node = next;
+	}
+
+	if(pps->nodes[node].pathid < 0)
+	{
+		pps->nodes[node].pathid = new_nugget_path(pps, states, elemidx);
+	}
+	return pps->nodes[node].pathid;
+}
+
+static void free_path_stat(struct path_stat* pps)
+{
+	int	i;
+
+	for(i=0 ; i<pps->path_cnt ; i++)
+	{
+		free(pps->paths[i].hist_interval_read);
+		free(pps->paths[i].hist_interval_write);
+	}
+	free(pps->paths);
+	free(pps->nodes);
+	free(pps);
+}
+
+void* init_path_statistic(void)
+{
+	struct path_stat* pps = (struct path_stat*)calloc(1, sizeof(struct path_stat));
+	int i;
+
+	if(pps == NULL)
+	{
+		return NULL;
+	}
+
+	// Unknown actions share the index of '?'
+	memset(path_action_idx, 0, sizeof(path_action_idx));
+	for(i=0 ; BLK_ACTION_STRING[i] != '\0' ; i++)
+	{
+		path_action_idx[(unsigned char)BLK_ACTION_STRING[i]] = i + 1;
+	}
+
+	// root of the trie
+	if(new_path_node(pps) < 0)
+	{
+		free(pps);
+		return NULL;
+	}
+	return pps;
+}
+
+void travel_path_statistic(void* part, struct dio_nugget* pdng)
+{
+	struct path_stat*	pps = (struct path_stat*)part;
+	struct dio_nugget_path*	pnugget_path;
+	int			i;
+	int			elemidx;
+	int			pathid;
+	struct dio_hist*	phist;
+	struct dio_hist*	phist_interval;
+
+	// the path is the states until the end of the string
+	elemidx = strnlen(pdng->states, MAX_ELEMENT_SIZE);
+	if(elemidx > pdng->elemidx)
+	{
+		elemidx = pdng->elemidx;
+	}
+	if(elemidx == 0)
+	{
+		return ;
+	}
+
+	pathid = intern_nugget_path(pps, pdng->states, elemidx);
+	if(pathid < 0)
+	{
+		return ;
+	}
+	pnugget_path = &pps->paths[pathid];
+	
+	// Add read/write count to distribute those.
+	if(pdng->category & BLK_TC_READ)
+	{
+		phist = &pnugget_path->hist_read;
+		phist_interval = pnugget_path->hist_interval_read;
+	}
+	else if(pdng->category & BLK_TC_WRITE)
+	{
+		phist = &pnugget_path->hist_write;
+		phist_interval = pnugget_path->hist_interval_write;
+	}
+	else
+	{
+		DBGOUT("%x \n", pdng->category);
+		return ;
+	}
+
+	// Set data on pnugget_path.
+	hist_add(phist, pdng->times[pnugget_path->elemidx-1] - pdng->times[0]);
+
+	// Set data on pnugget_path->hist_interval
+	for(i=0 ; i<pnugget_path->elemidx-1 ; i++)
+	{
+		hist_add(&phist_interval[i], pdng->times[i+1] - pdng->times[i]);
+	}
+
+}
+
+void merge_path_statistic(void* dst, void* src)
+{
+	struct path_stat*	pdst = (struct path_stat*)dst;
+	struct path_stat*	psrc = (struct path_stat*)src;
+	struct dio_nugget_path*	pnugget_path;
+	struct dio_nugget_path*	pdst_path;
+	int			pathid;
+	int			i, j;
+
+	// Paths of 'src' are interned in the order they were found,
+	// so new paths keep their order after the paths of 'dst'.
+	for(j=0 ; j<psrc->path_cnt ; j++)
+	{
+		pnugget_path = &psrc->paths[j];
+		pathid = intern_nugget_path(pdst, pnugget_path->states, pnugget_path->elemidx);
+		if(pathid < 0)
+		{
+			DBGOUT("failed to merge path statistic \n");
+			break;
+		}
+		pdst_path = &pdst->paths[pathid];
+
+		hist_merge(&pdst_path->hist_read, &pnugget_path->hist_read);
+		hist_merge(&pdst_path->hist_write, &pnugget_path->hist_write);
+		for(i=0 ; i<pdst_path->elemidx-1 ; i++)
+		{
+			hist_merge(&pdst_path->hist_interval_read[i], &pnugget_path->hist_interval_read[i]);
+			hist_merge(&pdst_path->hist_interval_write[i], &pnugget_path->hist_interval_write[i]);
+		}
+	}
+	free_path_stat(psrc);
+}
+
+void process_path_statistic(void* part, int ng_cnt)
+{
+	struct path_stat*	pps = (struct path_stat*)part;
+	struct dio_nugget_path*	pnugget_path;
+	int			i;
+
+	if(out_format != EMIT_TEXT)
+	{
+		emit_table(&emitter, "path", path_cols, PATH_COL_CNT);
+		for(i=pps->path_cnt-1 ; i>=0 ; i--)
+		{
+			pnugget_path = &pps->paths[i];
+			if(!instr(pnugget_path->states, "P") && !instr(pnugget_path->states, "U") && !instr(pnugget_path->states, "?"))
+			{
+				emit_path_statistic(pnugget_path);
+			}
+		}
+		free_path_stat(pps);
+		return;
+	}
+
+	if(is_graphic)
+	{
+		chart_path_statistic(pps);
+		free_path_stat(pps);
+		return;
+	}
+
+	fprintf(output,"%20s %6s ", "Path", "Type");
+	print_hist_header(output);
+
+	// The latest found path goes first
+	for(i=pps->path_cnt-1 ; i>=0 ; i--)
+	{
+		pnugget_path = &pps->paths[i];
+		if(instr(pnugget_path->states, "P") || instr(pnugget_path->states, "U") || instr(pnugget_path->states, "?"))
+		{
+			continue;
+		}
+		print_path_statistic_text(pnugget_path);
+	}
+
+	// Free all dynamic allocated variables.
+	free_path_stat(pps);
+}
+
+// the whole path has an empty interval
+static void emit_path_row(const char* path, const char* interval, const char* rw,
+			struct dio_hist* phist, struct dio_hist* ppath_hist)
+{
+	emit_row(&emitter);
+	emit_str(&emitter, path);
+	emit_str(&emitter, interval);
+	emit_str(&emitter, rw);
+	emit_hist(phist);
+	emit_f64(&emitter, hist_mean(ppath_hist) != 0 ? (double)hist_mean(phist) / hist_mean(ppath_hist) * 100 : 0.0);
+	emit_row_end(&emitter);
+}
+
+void emit_path_statistic(struct dio_nugget_path* pnugget_path)
+{
+	char interval[3];
+	int i;
+
+	emit_path_row(pnugget_path->states, "", "R", &pnugget_path->hist_read, &pnugget_path->hist_read);
+	emit_path_row(pnugget_path->states, "", "W", &pnugget_path->hist_write, &pnugget_path->hist_write);
+	for(i=0 ; i<pnugget_path->elemidx-1 ; i++)
+	{
+		snprintf(interval, sizeof(interval), "%.2s", &pnugget_path->states[i]);
+		emit_path_row(pnugget_path->states, interval, "R", &pnugget_path->hist_interval_read[i], &pnugget_path->hist_read);
+		emit_path_row(pnugget_path->states, interval, "W", &pnugget_path->hist_interval_write[i], &pnugget_path->hist_write);
+	}
+}
+
+void chart_path_statistic(struct path_stat* pps)
+{
+	struct chart_series series[2];
+	const char** labels;
+	double* counts;
+	char path[MAX_FILEPATH_LEN];
+	int i, n = 0;
+
+	labels = (const char**)malloc(sizeof(char*) * (pps->path_cnt + 1));
+	counts = (double*)malloc(sizeof(double) * (pps->path_cnt + 1) * 2);
+	if(labels == NULL || counts == NULL)
+	{
+		perror("failed to allocate memory");
+		goto out;
+	}
+
+	// The latest found path goes first
+	for(i=pps->path_cnt-1 ; i>=0 ; i--)
+	{
+		struct dio_nugget_path* pnugget_path = &pps->paths[i];
+		if(instr(pnugget_path->states, "P") || instr(pnugget_path->states, "U") || instr(pnugget_path->states, "?"))
+		{
+			continue;
+		}
+		labels[n] = pnugget_path->states;
+		counts[n] = pnugget_path->hist_read.count;
+		counts[pps->path_cnt + n] = pnugget_path->hist_write.count;
+		n++;
+	}
+
+	set_rw_series(series, counts, counts + pps->path_cnt);
+	chart_file(path, "path");
+	if(!chart_bars(path, "I/O statistics per path", "Path", "No. of I/O", labels, n, series, 2))
+	{
+		perror("failed to write chart");
+	}
+out:
+	free(labels);
+	free(counts);
+}
+
+// share of the interval in the whole path by average time
+static void print_interval_rate(FILE* stream, struct dio_hist* phist_interval, struct dio_hist* phist)
+{
+	if(hist_mean(phist) != 0)
+	{
+		fprintf(stream, " %2.2f%%", ((double)hist_mean(phist_interval) / hist_mean(phist)) * 100);
+	}
+	else
+	{
+		fprintf(stream, " %2.2f%%", 0.0);
+	}
+}
+
+void print_path_statistic_text(struct dio_nugget_path* pnugget_path)
+{
+	int i;
+
+	//printing
+	fprintf(output, "%20s %6s ", pnugget_path->states, "Read");
+	print_hist_statistic(output, &pnugget_path->hist_read);
+	fprintf(output, "\n");
+
+	fprintf(output, "%20s %6s ", " ", "Write");
+	print_hist_statistic(output, &pnugget_path->hist_write);
+	fprintf(output, "\n");
+
+	for(i=0 ; i<pnugget_path->elemidx-1 ; i++)
+	{
+		fprintf(output, "%18s%.2s %6s ", " ", &pnugget_path->states[i], "Read");
+		print_hist_statistic(output, &pnugget_path->hist_interval_read[i]);
+		print_interval_rate(output, &pnugget_path->hist_interval_read[i], &pnugget_path->hist_read);
+		fprintf(output, "\n");
+
+		fprintf(output, "%20s %6s ", " ", "Write");
+		print_hist_statistic(output, &pnugget_path->hist_interval_write[i]);
+		print_interval_rate(output, &pnugget_path->hist_interval_write[i], &pnugget_path->hist_write);
+		fprintf(output, "\n");
+	}
+	fprintf(output, "\n");
+}
+
+void emit_hist(struct dio_hist* phist)
+{
+	emit_u64(&emitter, phist->count);
+	emit_u64(&emitter, hist_mean(phist));
+	emit_u64(&emitter, hist_percentile(phist, 50));
+	emit_u64(&emitter, hist_percentile(phist, 90));
+	emit_u64(&emitter, hist_percentile(phist, 99));
+	emit_u64(&emitter, hist_percentile(phist, 99.9));
+	emit_u64(&emitter, phist->max);
+	emit_u64(&emitter, hist_min(phist));
+}
+
+void print_hist_header(FILE* stream)
+{
+	fprintf(stream, "%6s %12s %12s %12s %12s %12s %12s %12s \n",
+			"No", "AverageTime", "p50", "p90", "p99", "p99.9", "MaxTime", "MinTime");
+}
+
+#define PRINT_NS(stream, ns)	fprintf(stream, " %2llu.%.9llu", SECONDS(ns), NANO_SECONDS(ns))
+void print_hist_statistic(FILE* stream, struct dio_hist* phist)
+{
+	fprintf(stream, "%6llu", (unsigned long long)phist->count);
+	PRINT_NS(stream, hist_mean(phist));
+	PRINT_NS(stream, hist_percentile(phist, 50));
+	PRINT_NS(stream, hist_percentile(phist, 90));
+	PRINT_NS(stream, hist_percentile(phist, 99));
+	PRINT_NS(stream, hist_percentile(phist, 99.9));
+	PRINT_NS(stream, phist->max);
+	PRINT_NS(stream, hist_min(phist));
+}
+
+//---------------------------------------- pid statistic -------------------------------------------------//
+#define PID_COL_CNT	10
+static const struct emit_col pid_cols[PID_COL_CNT] = {
+	{ "pid", EMIT_U64 }, { "rw", EMIT_STR }, EMIT_HIST_COLS
+};
+
+//function for handling data structure for pid statistic
+struct pid_stat_data* rb_search_psd(struct rb_root* psd_root, uint32_t pid){
+	struct rb_node* n = psd_root->rb_node;
+	struct pid_stat_data* ppsd = NULL;
+	
+	while(n){
+		ppsd = rb_entry(n, struct pid_stat_data, link);
+
+		if( pid < ppsd->pid )
+			n = n->rb_left;
+		else if( pid > ppsd->pid )
+			n = n->rb_right;
+		else 
+			return ppsd;
+	}
+	return NULL;
+}
+
+struct pid_stat_data* __rb_insert_psd(struct rb_root* psd_root, struct pid_stat_data* newpsd){
+	struct pid_stat_data* ret;
+	struct rb_node** p = &(psd_root->rb_node);
+	struct rb_node* parent = NULL;
+	
+	while(*p){
+		parent = *p;
+		ret = rb_entry(parent, struct pid_stat_data, link);
+
+		if( newpsd->pid < ret->pid )
+			p = &(*p)->rb_left;
+		else if( newpsd->pid > ret->pid )
+			p = &(*p)->rb_right;
+		else
+			return ret;
+	}
+
+	rb_link_node(&newpsd->link, parent, p);
+	return NULL;
+}
+
+struct pid_stat_data* rb_insert_psd(struct rb_root* psd_root, struct pid_stat_data* newpsd){
+	struct pid_stat_data* ret = NULL;
+	if( (ret = __rb_insert_psd(psd_root, newpsd) ) )
+		return ret;
+	rb_insert_color(&newpsd->link, psd_root);
+	return ret;
+}
+
+void __clear_pid_stat(struct rb_node* p){
+	if( p->rb_left != NULL )
+		__clear_pid_stat(p->rb_left);
+	if( p->rb_right != NULL )
+		__clear_pid_stat(p->rb_right);
+	
+	struct pid_stat_data* psd = rb_entry(p, struct pid_stat_data, link);
+	free(psd);
+}
+
+void* init_pid_statistic()
+{
+	struct pid_stat* pps = (struct pid_stat*)malloc(sizeof(struct pid_stat));
+	if( pps == NULL )
+		return NULL;
+
+	pps->psd_root = RB_ROOT;
+	return pps;
+}
+
+void travel_pid_statistic(void* part, struct dio_nugget* pdng){
+	struct pid_stat* pps = (struct pid_stat*)part;
+	struct pid_stat_data* ppsd = rb_search_psd(&pps->psd_root, pdng->pid);
+	if( ppsd == NULL ){
+		ppsd = (struct pid_stat_data*)malloc(sizeof(struct pid_stat_data));
+		ppsd->pid = pdng->pid;
+		hist_init(&ppsd->hist_read);
+		hist_init(&ppsd->hist_write);
+		rb_insert_psd(&pps->psd_root, ppsd);
+	}
+	
+	uint64_t tmpt = pdng->times[pdng->elemidx-1] - pdng->times[0];
+	if( pdng->category & BLK_TC_READ )
+		hist_add(&ppsd->hist_read, tmpt);
+	else if( pdng->category & BLK_TC_WRITE )
+		hist_add(&ppsd->hist_write, tmpt);
+}
+
+void merge_pid_statistic(void* dst, void* src){
+	struct pid_stat* pdst = (struct pid_stat*)dst;
+	struct pid_stat* psrc = (struct pid_stat*)src;
+	struct pid_stat_data* ppsd = NULL;
+	struct pid_stat_data* pdst_psd = NULL;
+	struct rb_node* node = NULL;
+
+	for(node = rb_first(&psrc->psd_root); node != NULL; node = rb_next(node)){
+		ppsd = rb_entry(node, struct pid_stat_data, link);
+		pdst_psd = rb_search_psd(&pdst->psd_root, ppsd->pid);
+		if( pdst_psd == NULL ){
+			pdst_psd = (struct pid_stat_data*)malloc(sizeof(struct pid_stat_data));
+			if( pdst_psd == NULL ){
+				perror("failed to merge pid statistic");
+				break;
+			}
+			memcpy(pdst_psd, ppsd, sizeof(struct pid_stat_data));
+			rb_insert_psd(&pdst->psd_root, pdst_psd);
+			continue;
+		}
+
+		hist_merge(&pdst_psd->hist_read, &ppsd->hist_read);
+		hist_merge(&pdst_psd->hist_write, &ppsd->hist_write);
+	}
+
+	if( psrc->psd_root.rb_node != NULL )
+		__clear_pid_stat(psrc->psd_root.rb_node);
+	free(psrc);
+}
+
+void process_pid_statistic(void* part, int ng_cnt){
+	struct pid_stat* pps = (struct pid_stat*)part;
+	struct rb_node* node = NULL;
+
+	if(out_format != EMIT_TEXT)
+	{
+		emit_table(&emitter, "pid", pid_cols, PID_COL_CNT);
+	}
+	else if(is_graphic)
+	{
+		chart_pid_statistic(pps);
+	}
+	else
+	{
+		fprintf(output,"%10s %6s ", "pid", "Type");
+		print_hist_header(output);
+	}
+	node = rb_first(&pps->psd_root);
+	if(out_format == EMIT_TEXT && is_graphic)
+	{
+		node = NULL;
+	}
+	while( node != NULL ){
+		struct pid_stat_data* ppsd = NULL;
+		ppsd = rb_entry(node, struct pid_stat_data, link);
+
+		//printing
+		if(out_format != EMIT_TEXT)
+		{
+			emit_pid_statistic(ppsd);
+		}
+		else
+		{
+			print_pid_statistic_text(ppsd);
+		}
+		node = rb_next(node);
+	}
+
+	//clear all pid tree
+	struct rb_node* parent = pps->psd_root.rb_node;
+	if( parent != NULL )
+		__clear_pid_stat(parent);
+	free(pps);
+}
+
+void emit_pid_statistic(struct pid_stat_data* ppsd)
+{
+	emit_row(&emitter);
+	emit_u64(&emitter, ppsd->pid);
+	emit_str(&emitter, "R");
+	emit_hist(&ppsd->hist_read);
+	emit_row_end(&emitter);
+
+	emit_row(&emitter);
+	emit_u64(&emitter, ppsd->pid);
+	emit_str(&emitter, "W");
+	emit_hist(&ppsd->hist_write);
+	emit_row_end(&emitter);
+}
+
+void chart_pid_statistic(struct pid_stat* pps)
+{
+	struct chart_series series[2];
+	struct rb_node* node = NULL;
+	const char** labels = NULL;
+	char (*pids)[12] = NULL;
+	double* counts = NULL;
+	char path[MAX_FILEPATH_LEN];
+	size_t n = 0, cnt = 0;
+
+	for(node = rb_first(&pps->psd_root); node != NULL; node = rb_next(node))
+		cnt++;
+
+	labels = (const char**)malloc(sizeof(char*) * (cnt + 1));
+	pids = (char (*)[12])malloc(sizeof(*pids) * (cnt + 1));
+	counts = (double*)malloc(sizeof(double) * (cnt + 1) * 2);
+	if(labels == NULL || pids == NULL || counts == NULL)
+	{
+		perror("failed to allocate memory");
+		goto out;
+	}
+
+	for(node = rb_first(&pps->psd_root); node != NULL; node = rb_next(node))
+	{
+		struct pid_stat_data* ppsd = rb_entry(node, struct pid_stat_data, link);
+		snprintf(pids[n], sizeof(pids[n]), "%"PRIu32, ppsd->pid);
+		labels[n] = pids[n];
+		counts[n] = ppsd->hist_read.count;
+		counts[cnt + n] = ppsd->hist_write.count;
+		n++;
+	}
+
+	set_rw_series(series, counts, counts + cnt);
+	chart_file(path, "pid");
+	if(!chart_bars(path, "I/O statistics per pid", "PID", "No. of I/O", labels, n, series, 2))
+	{
+		perror("failed to write chart");
+	}
+out:
+	free(labels);
+	free(pids);
+	free(counts);
+}
+
+void print_pid_statistic_text(struct pid_stat_data* ppsd)
+{
+	fprintf(output, "%10"PRIu32" %6s ", ppsd->pid, "Read");
+	print_hist_statistic(output, &ppsd->hist_read);
+	fprintf(output, " \n");
+
+	fprintf(output, "%10s %6s ", " ", "Write");
+	print_hist_statistic(output, &ppsd->hist_write);
+	fprintf(output, " \n");
+	fprintf(output, "\n");
+}
+
+
+//------------------- stage statistics ------------------------------//
+// like btt, a nugget is broken into the time between its actions.
+// Q2G, G2I and I2D are spent in the block layer and the scheduler,
+// D2C is spent in the device, and Q2C is the whole.
+static const char stage_actions[STAGE_CNT][2] = {
+	{'Q', 'G'}, {'G', 'I'}, {'I', 'D'}, {'D', 'C'}, {'Q', 'C'}
+};
+static const char* stage_names[STAGE_CNT] = {
+	"Q2G", "G2I", "I2D", "D2C", "Q2C"
+};
+
+// time from the first 'from' action to the first 'to' action after it.
+// -1 if the nugget didn't pass the stage
+int64_t find_stage_time(struct dio_nugget* pdng, int stage){
+	int i = 0, from = -1;
+
+	for(i=0; i<pdng->elemidx && i<MAX_ELEMENT_SIZE; i++){
+		if( from < 0 ){
+			if( pdng->states[i] == stage_actions[stage][0] )
+				from = i;
+		}
+		else if( pdng->states[i] == stage_actions[stage][1] )
+			return (int64_t)(pdng->times[i] - pdng->times[from]);
+	}
+	return -1;
+}
+
+// the smallest power of 2 which is not less than the size
+static uint64_t size_class(int size){
+	uint64_t class = 512;
+
+	while( class < (uint64_t)size )
+		class <<= 1;
+	return class;
+}
+
+struct stage_group* get_stage_group(struct rb_root* root, uint64_t key){
+	struct rb_node** p = &root->rb_node;
+	struct rb_node* parent = NULL;
+	struct stage_group* psg = NULL;
+	int i = 0;
+
+	while(*p){
+		parent = *p;
+		psg = rb_entry(parent, struct stage_group, link);
+
+		if( key < psg->key )
+			p = &(*p)->rb_left;
+		else if( key > psg->key )
+			p = &(*p)->rb_right;
+		else
+			return psg;
+	}
+
+	psg = (struct stage_group*)malloc(sizeof(struct stage_group));
+	if( psg == NULL )
+		return NULL;
+	psg->key = key;
+	for(i=0; i<STAGE_CNT; i++)
+		hist_init(&psg->hists[i]);
+
+	rb_link_node(&psg->link, parent, p);
+	rb_insert_color(&psg->link, root);
+	return psg;
+}
+
+static void __clear_stage_group(struct rb_node* p){
+	if( p == NULL )
+		return;
+	__clear_stage_group(p->rb_left);
+	__clear_stage_group(p->rb_right);
+	free(rb_entry(p, struct stage_group, link));
+}
+
+void* init_stage_statistic(){
+	struct stage_stat* pss = (struct stage_stat*)malloc(sizeof(struct stage_stat));
+	int i = 0;
+
+	if( pss == NULL )
+		return NULL;
+	for(i=0; i<STAGE_CNT; i++)
+		hist_init(&pss->all[i]);
+	pss->pid_root = RB_ROOT;
+	pss->dev_root = RB_ROOT;
+	pss->size_root = RB_ROOT;
+	return pss;
+}
+
+void travel_stage_statistic(void* part, struct dio_nugget* pdng){
+	struct stage_stat* pss = (struct stage_stat*)part;
+	struct stage_group* pgroups[3];
+	int64_t stage_time = 0;
+	int i = 0, j = 0;
+
+	pgroups[0] = NULL;
+	for(i=0; i<STAGE_CNT; i++){
+		stage_time = find_stage_time(pdng, i);
+		if( stage_time < 0 )
+			continue;
+
+		//the groups are made only for the nuggets which passed a stage
+		if( pgroups[0] == NULL ){
+			pgroups[0] = get_stage_group(&pss->pid_root, pdng->pid);
+			pgroups[1] = get_stage_group(&pss->dev_root, pdng->device);
+			pgroups[2] = get_stage_group(&pss->size_root, size_class(pdng->size));
+		}
+
+		hist_add(&pss->all[i], stage_time);
+		for(j=0; j<3; j++){
+			if( pgroups[j] != NULL )
+				hist_add(&pgroups[j]->hists[i], stage_time);
+		}
+	}
+}
+
+static void merge_stage_groups(struct rb_root* pdst, struct rb_root* psrc){
+	struct rb_node* node = NULL;
+	struct stage_group* psg = NULL;
+	struct stage_group* pdst_sg = NULL;
+	int i = 0;
+
+	for(node = rb_first(psrc); node != NULL; node = rb_next(node)){
+		psg = rb_entry(node, struct stage_group, link);
+		pdst_sg = get_stage_group(pdst, psg->key);
+		if( pdst_sg == NULL ){
+			perror("failed to merge stage statistic");
+			break;
+		}
+		for(i=0; i<STAGE_CNT; i++)
+			hist_merge(&pdst_sg->hists[i], &psg->hists[i]);
+	}
+	__clear_stage_group(psrc->rb_node);
+}
+
+void merge_stage_statistic(void* dst, void* src){
+	struct stage_stat* pdst = (struct stage_stat*)dst;
+	struct stage_stat* psrc = (struct stage_stat*)src;
+	int i = 0;
+
+	for(i=0; i<STAGE_CNT; i++)
+		hist_merge(&pdst->all[i], &psrc->all[i]);
+	merge_stage_groups(&pdst->pid_root, &psrc->pid_root);
+	merge_stage_groups(&pdst->dev_root, &psrc->dev_root);
+	merge_stage_groups(&pdst->size_root, &psrc->size_root);
+	free(psrc);
+}
+
+#define STAGE_COL_CNT	10
+static const struct emit_col stage_cols[STAGE_COL_CNT] = {
+	{ "group", EMIT_STR }, { "stage", EMIT_STR }, EMIT_HIST_COLS
+};
+
+static void print_stage_hists(struct dio_hist* phists, const char* group){
+	int i = 0;
+
+	if( out_format != EMIT_TEXT ){
+		for(i=0; i<STAGE_CNT; i++){
+			emit_row(&emitter);
+			emit_str(&emitter, group);
+			emit_str(&emitter, stage_names[i]);
+			emit_hist(&phists[i]);
+			emit_row_end(&emitter);
+		}
+		return;
+	}
+
+	for(i=0; i<STAGE_CNT; i++){
+		fprintf(output, "%12s %6s ", i == 0 ? group : " ", stage_names[i]);
+		print_hist_statistic(output, &phists[i]);
+		fprintf(output, "\n");
+	}
+	fprintf(output, "\n");
+}
+
+void process_stage_statistic(void* part, int ng_cnt){
+	struct stage_stat* pss = (struct stage_stat*)part;
+	struct rb_node* node = NULL;
+	struct stage_group* psg = NULL;
+	char group[32];
+
+	if( out_format != EMIT_TEXT )
+		emit_table(&emitter, "stage", stage_cols, STAGE_COL_CNT);
+	else{
+		fprintf(output, "%12s %6s ", "Group", "Stage");
+		print_hist_header(output);
+	}
+	print_stage_hists(pss->all, "All");
+
+	for(node = rb_first(&pss->dev_root); node != NULL; node = rb_next(node)){
+		psg = rb_entry(node, struct stage_group, link);
+		snprintf(group, sizeof(group), "dev %u,%u",
+			(unsigned int)(psg->key >> 20), (unsigned int)(psg->key & ((1 << 20) - 1)));
+		print_stage_hists(psg->hists, group);
+	}
+	for(node = rb_first(&pss->pid_root); node != NULL; node = rb_next(node)){
+		psg = rb_entry(node, struct stage_group, link);
+		snprintf(group, sizeof(group), "pid %llu", (unsigned long long)psg->key);
+		print_stage_hists(psg->hists, group);
+	}
+	for(node = rb_first(&pss->size_root); node != NULL; node = rb_next(node)){
+		psg = rb_entry(node, struct stage_group, link);
+		snprintf(group, sizeof(group), "<=%lluK", (unsigned long long)(psg->key / 1024));
+		if( psg->key < 1024 )
+			snprintf(group, sizeof(group), "<=%lluB", (unsigned long long)psg->key);
+		print_stage_hists(psg->hists, group);
+	}
+
+	__clear_stage_group(pss->pid_root.rb_node);
+	__clear_stage_group(pss->dev_root.rb_node);
+	__clear_stage_group(pss->size_root.rb_node);
+	free(pss);
+}
+
+//------------------- timeline statistics ------------------------------//
+// the completed nuggets are put in the bucket of their completion time.
+// buckets are an array from the time of the first bit, so a long trace
+// costs only a longer array.
+
+// parse the bucket width like "10ms". 0 is returned for a wrong width
+uint64_t parse_time_width(const char* str){
+	char* unit = NULL;
+	unsigned long long width = strtoull(str, &unit, 10);
+
+	if( unit == str )
+		return 0;
+	if( !strcmp(unit, "ns") )
+		return width;
+	if( !strcmp(unit, "us") )
+		return width * 1000;
+	if( !strcmp(unit, "ms") || *unit == '\0' )
+		return width * 1000000;
+	if( !strcmp(unit, "s") )
+		return width * 1000000000;
+	return 0;
+}
+
+// make the bucket 'idx' usable
+static bool grow_timeline(struct timeline_stat* pts, size_t idx){
+	struct timeline_bucket* newbkts = NULL;
+	size_t newmax = pts->bkt_max ? pts->bkt_max : 1024;
+
+	if( idx < pts->bkt_cnt )
+		return true;
+
+	while( newmax <= idx )
+		newmax *= 2;
+	if( newmax != pts->bkt_max ){
+		newbkts = (struct timeline_bucket*)realloc(pts->bkts, sizeof(struct timeline_bucket) * newmax);
+		if( newbkts == NULL )
+			return false;
+		pts->bkts = newbkts;
+		pts->bkt_max = newmax;
+	}
+	memset(pts->bkts + pts->bkt_cnt, 0, sizeof(struct timeline_bucket) * (idx + 1 - pts->bkt_cnt));
+	pts->bkt_cnt = idx + 1;
+	return true;
+}
+
+static bool add_timeline_lat(struct timeline_stat* pts, uint64_t lat, uint32_t bkt){
+	struct timeline_lat* newlats = NULL;
+
+	if( pts->lat_cnt == pts->lat_max ){
+		pts->lat_max = pts->lat_max ? pts->lat_max * 2 : 4096;
+		newlats = (struct timeline_lat*)realloc(pts->lats, sizeof(struct timeline_lat) * pts->lat_max);
+		if( newlats == NULL )
+			return false;
+		pts->lats = newlats;
+	}
+	pts->lats[pts->lat_cnt].lat = lat;
+	pts->lats[pts->lat_cnt].bkt = bkt;
+	pts->lat_cnt++;
+	return true;
+}
+
+static struct timeline_stat* new_timeline_stat(uint64_t width){
+	struct timeline_stat* pts = (struct timeline_stat*)calloc(1, sizeof(struct timeline_stat));
+
+	if( pts == NULL )
+		return NULL;
+	pts->width = width;
+	if( time_bit_cnt > 0 )
+		pts->base = time_bits[0]->time / width * width;
+	return pts;
+}
+
+void* init_timeline_statistic(){
+	return new_timeline_stat(timeline_width);
+}
+
+void travel_timeline_statistic(void* part, struct dio_nugget* pdng){
+	struct timeline_stat* pts = (struct timeline_stat*)part;
+	struct timeline_bucket* pbkt = NULL;
+	int64_t q2c = 0, d2c = 0;
+	uint64_t ctime = 0, dtime = 0, from = 0, to = 0;
+	size_t idx = 0, i = 0;
+	int cidx = 0;
+
+	//completed nuggets only
+	for(cidx=0; cidx<pdng->elemidx && cidx<MAX_ELEMENT_SIZE; cidx++){
+		if( pdng->states[cidx] == 'C' )
+			break;
+	}
+	if( cidx == pdng->elemidx || cidx == MAX_ELEMENT_SIZE )
+		return;
+
+	ctime = pdng->times[cidx];
+	if( ctime < pts->base )
+		return;
+	idx = (ctime - pts->base) / pts->width;
+	if( !grow_timeline(pts, idx) )
+		return;
+
+	pbkt = &pts->bkts[idx];
+	if( pdng->category & BLK_TC_READ ){
+		pbkt->r_cnt++;
+		pbkt->r_bytes += pdng->size;
+	}
+	else if( pdng->category & BLK_TC_WRITE ){
+		pbkt->w_cnt++;
+		pbkt->w_bytes += pdng->size;
+	}
+
+	q2c = find_stage_time(pdng, STAGE_Q2C);
+	if( q2c < 0 )
+		q2c = ctime - pdng->times[0];
+	//a bucket counts only the latencies which are kept for its quantiles
+	if( add_timeline_lat(pts, q2c, idx) ){
+		pbkt->lat_cnt++;
+		pbkt->lat_total += q2c;
+	}
+
+	//the nugget is in the device from D to C
+	d2c = find_stage_time(pdng, STAGE_D2C);
+	if( d2c < 0 )
+		return;
+	dtime = ctime - d2c;
+	if( dtime < pts->base )
+		dtime = pts->base;
+	for(i=(dtime - pts->base) / pts->width; i<=idx; i++){
+		from = pts->base + i * pts->width;
+		to = from + pts->width;
+		if( from < dtime )
+			from = dtime;
+		if( to > ctime )
+			to = ctime;
+		pts->bkts[i].depth_time += to - from;
+	}
+}
+
+void merge_timeline_statistic(void* dst, void* src){
+	struct timeline_stat* pdst = (struct timeline_stat*)dst;
+	struct timeline_stat* psrc = (struct timeline_stat*)src;
+	size_t i = 0;
+
+	if( psrc->bkt_cnt > 0 && grow_timeline(pdst, psrc->bkt_cnt - 1) ){
+		for(i=0; i<psrc->bkt_cnt; i++){
+			pdst->bkts[i].r_cnt += psrc->bkts[i].r_cnt;
+			pdst->bkts[i].w_cnt += psrc->bkts[i].w_cnt;
+			pdst->bkts[i].r_bytes += psrc->bkts[i].r_bytes;
+			pdst->bkts[i].w_bytes += psrc->bkts[i].w_bytes;
+			pdst->bkts[i].depth_time += psrc->bkts[i].depth_time;
+		}
+		for(i=0; i<psrc->lat_cnt; i++){
+			if( !add_timeline_lat(pdst, psrc->lats[i].lat, psrc->lats[i].bkt) ){
+				perror("failed to merge timeline statistic");
+				break;
+			}
+			pdst->bkts[psrc->lats[i].bkt].lat_cnt++;
+			pdst->bkts[psrc->lats[i].bkt].lat_total += psrc->lats[i].lat;
+		}
+	}
+
+	free(psrc->bkts);
+	free(psrc->lats);
+	free(psrc);
+}
+
+// the k-th smallest of 'a' (k from 0). 'a' is reordered
+static uint64_t select_kth(uint64_t* a, size_t n, size_t k){
+	size_t lo = 0, hi = n - 1, i = 0, j = 0;
+	uint64_t pivot = 0, tmp = 0;
+
+	while( lo < hi ){
+		pivot = a[lo + (hi - lo) / 2];
+		i = lo;
+		j = hi;
+		while( i <= j ){
+			while( a[i] < pivot )
+				i++;
+			while( a[j] > pivot )
+				j--;
+			if( i <= j ){
+				tmp = a[i]; a[i] = a[j]; a[j] = tmp;
+				i++;
+				if( j == 0 )
+					break;
+				j--;
+			}
+		}
+		if( k <= j )
+			hi = j;
+		else if( k >= i )
+			lo = i;
 		else
-		{
-			fprintf(output, " %2.2f%%", 0.0);
+			break;
+	}
+	return a[k];
+}
+
+static const struct emit_col timeline_cols[] = {
+	{ "time_ns", EMIT_U64 }, { "r_iops", EMIT_F64 }, { "w_iops", EMIT_F64 }, { "r_mbps", EMIT_F64 },
+	{ "w_mbps", EMIT_F64 }, { "avg_lat_ns", EMIT_U64 }, { "p99_lat_ns", EMIT_U64 }, { "depth", EMIT_F64 }
+};
+
+// latencies of bucket i are put in [offs[i], offs[i+1]) of 'sorted'
+static bool group_timeline_lats(struct timeline_stat* pts, uint64_t** psorted, size_t** poffs){
+	uint64_t* sorted = (uint64_t*)malloc(sizeof(uint64_t) * (pts->lat_cnt + 1));
+	size_t* offs = (size_t*)malloc(sizeof(size_t) * (pts->bkt_cnt + 2));
+	size_t i = 0;
+
+	*psorted = sorted;
+	*poffs = offs;
+	if( sorted == NULL || offs == NULL )
+		return false;
+
+	//offs[i+1] is the start of bucket i while the latencies are put
+	offs[0] = offs[1] = 0;
+	for(i=1; i<pts->bkt_cnt; i++)
+		offs[i+1] = offs[i] + pts->bkts[i-1].lat_cnt;
+	for(i=0; i<pts->lat_cnt; i++)
+		sorted[offs[pts->lats[i].bkt + 1]++] = pts->lats[i].lat;
+	return true;
+}
+
+// IOPS and latency lines, and the heatmap of latencies over time.
+// 'lines' has time, R_IOPS, W_IOPS, AvgLat and p99Lat of all buckets in turn
+#define TIMELINE_LINE_CNT	5
+#define HEATMAP_MAX_COLS	600
+#define HEATMAP_ROWS		24	//row r has latencies in [2^r, 2^(r+1)) us
+static void chart_timeline(struct timeline_stat* pts, const double* lines){
+	struct chart_series series[2];
+	char path[MAX_FILEPATH_LEN];
+	char names[HEATMAP_ROWS][16];
+	const char* row_labels[HEATMAP_ROWS];
+	double* cells = NULL;
+	size_t n = pts->bkt_cnt, i = 0, cols = 0, group = 0;
+	uint64_t us = 0;
+	int r = 0;
+
+	series[0].name = "read";
+	series[0].color = "darkblue";
+	series[0].vals = lines + n;
+	series[1].name = "write";
+	series[1].color = "forestgreen";
+	series[1].vals = lines + n * 2;
+	chart_file(path, "timeline");
+	if( !chart_lines(path, "IOPS over time", "Time (s)", "IOPS", lines, n, series, 2) )
+		perror("failed to write chart");
+
+	series[0].name = "average";
+	series[0].vals = lines + n * 3;
+	series[1].name = "p99";
+	series[1].color = "firebrick";
+	series[1].vals = lines + n * 4;
+	chart_file(path, "latency");
+	if( !chart_lines(path, "Latency over time", "Time (s)", "Latency (ms)", lines, n, series, 2) )
+		perror("failed to write chart");
+
+	//a long trace has its buckets grouped in columns
+	group = (n + HEATMAP_MAX_COLS - 1) / HEATMAP_MAX_COLS;
+	if( group == 0 )
+		group = 1;
+	cols = (n + group - 1) / group;
+	cells = (double*)calloc(cols * HEATMAP_ROWS + 1, sizeof(double));
+	if( cells == NULL ){
+		perror("failed to allocate memory");
+		return;
+	}
+	for(i=0; i<pts->lat_cnt; i++){
+		us = pts->lats[i].lat / 1000;
+		r = us > 0 ? 63 - __builtin_clzll(us) : 0;
+		if( r >= HEATMAP_ROWS )
+			r = HEATMAP_ROWS - 1;
+		cells[pts->lats[i].bkt / group * HEATMAP_ROWS + r]++;
+	}
+	for(r=0; r<HEATMAP_ROWS; r++){
+		us = 1ULL << r;
+		if( us < 1000 )
+			snprintf(names[r], sizeof(names[r]), "%lluus", (unsigned long long)us);
+		else if( us < 1000000 )
+			snprintf(names[r], sizeof(names[r]), "%.3gms", us / 1000.0);
+		else
+			snprintf(names[r], sizeof(names[r]), "%.3gs", us / 1000000.0);
+		row_labels[r] = names[r];
+	}
+
+	chart_file(path, "heatmap");
+	if( !chart_heatmap(path, "Latency heatmap", "Time (s)", "Latency", cells, cols, HEATMAP_ROWS,
+			pts->base / 1000000000.0, group * pts->width / 1000000000.0, row_labels) )
+		perror("failed to write chart");
+	free(cells);
+}
+
+void process_timeline_statistic(void* part, int ng_cnt){
+	struct timeline_stat* pts = (struct timeline_stat*)part;
+	struct timeline_bucket* pbkt = NULL;
+	uint64_t* sorted = NULL;
+	size_t* offs = NULL;
+	double* lines = NULL;
+	size_t i = 0, n = pts->bkt_cnt;
+	uint64_t start = 0, avg = 0, p99 = 0;
+	double sec = pts->width / 1000000000.0;
+
+	//latencies are grouped by bucket in O(n), then each bucket finds its p99
+	if( out_format == EMIT_TEXT && is_graphic )
+		lines = (double*)malloc(sizeof(double) * (n + 1) * TIMELINE_LINE_CNT);
+	if( !group_timeline_lats(pts, &sorted, &offs) || (out_format == EMIT_TEXT && is_graphic && lines == NULL) ){
+		perror("failed to process timeline");
+		goto out;
+	}
+
+	if( out_format != EMIT_TEXT )
+		emit_table(&emitter, "timeline", timeline_cols, 8);
+	else if( lines == NULL )
+		fprintf(output, "%15s %9s %9s %9s %9s %12s %12s %7s\n",
+			"Time", "R_IOPS", "W_IOPS", "R_MB/s", "W_MB/s", "AvgLat", "p99Lat", "Depth");
+	for(i=0; i<pts->bkt_cnt; i++){
+		pbkt = &pts->bkts[i];
+		avg = p99 = 0;
+		if( pbkt->lat_cnt > 0 ){
+			avg = pbkt->lat_total / pbkt->lat_cnt;
+			p99 = select_kth(sorted + offs[i], pbkt->lat_cnt, (pbkt->lat_cnt * 99 + 99) / 100 - 1);
+		}
+
+		start = pts->base + i * pts->width;
+		if( out_format != EMIT_TEXT ){
+			emit_row(&emitter);
+			emit_u64(&emitter, start);
+			emit_f64(&emitter, pbkt->r_cnt / sec);
+			emit_f64(&emitter, pbkt->w_cnt / sec);
+			emit_f64(&emitter, pbkt->r_bytes / sec / (1024*1024));
+			emit_f64(&emitter, pbkt->w_bytes / sec / (1024*1024));
+			emit_u64(&emitter, avg);
+			emit_u64(&emitter, p99);
+			emit_f64(&emitter, (double)pbkt->depth_time / pts->width);
+			emit_row_end(&emitter);
+			continue;
+		}
+		if( lines != NULL ){
+			lines[i] = start / 1000000000.0;
+			lines[n + i] = pbkt->r_cnt / sec;
+			lines[n * 2 + i] = pbkt->w_cnt / sec;
+			lines[n * 3 + i] = avg / 1000000.0;
+			lines[n * 4 + i] = p99 / 1000000.0;
+			continue;
+		}
+		fprintf(output, "%5d.%09lu %9.0f %9.0f %9.2f %9.2f %2llu.%.9llu %2llu.%.9llu %7.2f\n",
+			(int)SECONDS(start), (unsigned long)NANO_SECONDS(start),
+			pbkt->r_cnt / sec, pbkt->w_cnt / sec,
+			pbkt->r_bytes / sec / (1024*1024), pbkt->w_bytes / sec / (1024*1024),
+			SECONDS(avg), NANO_SECONDS(avg), SECONDS(p99), NANO_SECONDS(p99),
+			(double)pbkt->depth_time / pts->width);
+	}
+	if( lines != NULL )
+		chart_timeline(pts, lines);
+	else if( out_format == EMIT_TEXT )
+		fprintf(output, "\n");
+
+out:
+	free(sorted);
+	free(offs);
+	free(lines);
+	free(pts->bkts);
+	free(pts->lats);
+	free(pts);
+}
+
+//------------------- timeline pyramid ------------------------------//
+// the timeline is built in 1ms buckets, and a bucket of each level above
+// covers 10 buckets of the level below. the latencies of a bucket at any
+// level are a contiguous range of the grouped latencies, so the quantiles
+// are exact at every level without keeping the latencies of each level.
+
+// the end of the time the pyramid covers
+static uint64_t pyramid_end(struct timeline_stat* pts){
+	return time_bit_cnt > 0 ? time_bits[time_bit_cnt-1]->time : pts->base;
+}
+
+void* init_pyramid_statistic(){
+	return new_timeline_stat(PYRAMID_BASE_WIDTH);
+}
+
+// bucket 'b' of the level whose buckets cover 'f' buckets of the timeline
+static void fill_pyramid_bucket(struct timeline_stat* pts, uint64_t* sorted, size_t* offs,
+		size_t b, size_t f, struct pyr_bucket* ppb){
+	size_t from = b * f, to = from + f, n = 0, i = 0;
+	uint64_t lat_total = 0, depth_time = 0;
+	uint64_t start = pts->base + from * pts->width, end = start + f * pts->width;
+
+	if( to > pts->bkt_cnt )
+		to = pts->bkt_cnt;
+	memset(ppb, 0, sizeof(struct pyr_bucket));
+	for(i=from; i<to; i++){
+		ppb->r_cnt += pts->bkts[i].r_cnt;
+		ppb->w_cnt += pts->bkts[i].w_cnt;
+		ppb->r_bytes += pts->bkts[i].r_bytes;
+		ppb->w_bytes += pts->bkts[i].w_bytes;
+		lat_total += pts->bkts[i].lat_total;
+		depth_time += pts->bkts[i].depth_time;
+	}
+	//the last bucket covers only up to the last bit
+	if( end > pyramid_end(pts) )
+		end = pyramid_end(pts);
+	if( end > start )
+		ppb->depth = (double)depth_time / (end - start);
+
+	n = offs[to] - offs[from];
+	if( n == 0 )
+		return;
+	ppb->avg_lat = lat_total / n;
+	ppb->p50_lat = select_kth(sorted + offs[from], n, (n * 50 + 99) / 100 - 1);
+	ppb->p99_lat = select_kth(sorted + offs[from], n, (n * 99 + 99) / 100 - 1);
+	ppb->max_lat = select_kth(sorted + offs[from], n, n - 1);
+}
+
+void process_pyramid_statistic(void* part, int ng_cnt){
+	struct timeline_stat* pts = (struct timeline_stat*)part;
+	struct pyr_level levels[PYR_MAX_LEVEL];
+	char viewpath[MAX_FILEPATH_LEN + sizeof(DIO_PYRAMID_VIEWER)];
+	struct pyr_level* plv = NULL;
+	uint64_t* sorted = NULL;
+	size_t* offs = NULL;
+	size_t f = 1, b = 0;
+	int level_cnt = 0, l = 0;
+
+	memset(levels, 0, sizeof(levels));
+	if( !group_timeline_lats(pts, &sorted, &offs) ){
+		perror("failed to process pyramid");
+		goto out;
+	}
+
+	//levels are made up to the one which has a bucket for the whole trace
+	do{
+		plv = &levels[level_cnt++];
+		plv->width = pts->width * f;
+		plv->cnt = (pts->bkt_cnt + f - 1) / f;
+		plv->bkts = (struct pyr_bucket*)malloc(sizeof(struct pyr_bucket) * (plv->cnt + 1));
+		if( plv->bkts == NULL ){
+			perror("failed to process pyramid");
+			goto out;
+		}
+		for(b=0; b<plv->cnt; b++)
+			fill_pyramid_bucket(pts, sorted, offs, b, f, &plv->bkts[b]);
+		f *= PYRAMID_FACTOR;
+	}while( plv->cnt > 1 && level_cnt < PYR_MAX_LEVEL );
+
+	snprintf(viewpath, sizeof(viewpath), "%s%s", pyrpath, DIO_PYRAMID_VIEWER);
+	if( !pyramid_write(pyrpath, pts->base, pyramid_end(pts), levels, level_cnt) || !pyramid_write_viewer(viewpath) )
+		perror("failed to write pyramid");
+
+out:
+	for(l=0; l<level_cnt; l++)
+		free(levels[l].bkts);
+	free(sorted);
+	free(offs);
+	free(pts->bkts);
+	free(pts->lats);
+	free(pts);
+}
+
+//------------------- queue depth statistics ------------------------------//
+// a nugget is in flight from D to C at the device, and from Q to C
+// in the block layer. the edges of all the nuggets are sorted and swept,
+// so the depth is known at any time without walking the nuggets again.
+static const char* depth_kind_names[DEPTH_KIND_CNT] = { "D2C", "Q2C" };
+
+// first time of the action 'act', 0 if the nugget doesn't have it
+static uint64_t find_action_time(struct dio_nugget* pdng, char act){
+	int i = 0;
+
+	for(i=0; i<pdng->elemidx && i<MAX_ELEMENT_SIZE; i++){
+		if( pdng->states[i] == act )
+			return pdng->times[i];
+	}
+	return 0;
+}
+
+static bool add_depth_edge(struct depth_stat* pds, uint32_t device, uint8_t kind, uint64_t time, int8_t delta){
+	struct depth_edge* newedges = NULL;
+
+	if( pds->edge_cnt == pds->edge_max ){
+		pds->edge_max = pds->edge_max ? pds->edge_max * 2 : 4096;
+		newedges = (struct depth_edge*)realloc(pds->edges, sizeof(struct depth_edge) * pds->edge_max);
+		if( newedges == NULL )
+			return false;
+		pds->edges = newedges;
+	}
+	pds->edges[pds->edge_cnt].time = time;
+	pds->edges[pds->edge_cnt].device = device;
+	pds->edges[pds->edge_cnt].kind = kind;
+	pds->edges[pds->edge_cnt].delta = delta;
+	pds->edge_cnt++;
+	return true;
+}
+
+void* init_depth_statistic(){
+	return calloc(1, sizeof(struct depth_stat));
+}
+
+void travel_depth_statistic(void* part, struct dio_nugget* pdng){
+	struct depth_stat* pds = (struct depth_stat*)part;
+	uint64_t from[DEPTH_KIND_CNT], ctime = 0;
+	int k = 0;
+
+	ctime = find_action_time(pdng, 'C');
+	if( ctime == 0 )
+		return;
+	from[DEPTH_D2C] = find_action_time(pdng, 'D');
+	from[DEPTH_Q2C] = find_action_time(pdng, 'Q');
+
+	for(k=0; k<DEPTH_KIND_CNT; k++){
+		//an empty interval never adds depth
+		if( from[k] == 0 || from[k] >= ctime )
+			continue;
+		add_depth_edge(pds, pdng->device, k, from[k], 1);
+		add_depth_edge(pds, pdng->device, k, ctime, -1);
+	}
+}
+
+void merge_depth_statistic(void* dst, void* src){
+	struct depth_stat* pdst = (struct depth_stat*)dst;
+	struct depth_stat* psrc = (struct depth_stat*)src;
+	size_t i = 0;
+
+	for(i=0; i<psrc->edge_cnt; i++){
+		if( !add_depth_edge(pdst, psrc->edges[i].device, psrc->edges[i].kind,
+					psrc->edges[i].time, psrc->edges[i].delta) )
+			break;
+	}
+	free(psrc->edges);
+	free(psrc);
+}
+
+// by device, kind and time. a completion goes before an issue of the same time
+static int cmp_depth_edge(const void* a, const void* b){
+	const struct depth_edge* pa = (const struct depth_edge*)a;
+	const struct depth_edge* pb = (const struct depth_edge*)b;
+
+	if( pa->device != pb->device )
+		return (pa->device < pb->device) ? -1 : 1;
+	if( pa->kind != pb->kind )
+		return (pa->kind < pb->kind) ? -1 : 1;
+	if( pa->time != pb->time )
+		return (pa->time < pb->time) ? -1 : 1;
+	return pa->delta - pb->delta;
+}
+
+// sweep the sorted edges of one (device, kind) in [start, end)
+static bool sweep_depth(struct depth_edge* edges, size_t start, size_t end, struct depth_sweep* psw){
+	uint64_t* newtimes = NULL;
+	uint64_t prev = edges[start].time, span = 0;
+	int depth = 0, newmax = 0;
+	size_t i = 0;
+
+	for(i=start; i<end; i++){
+		span = edges[i].time - prev;
+		if( depth >= psw->time_max ){
+			newmax = psw->time_max ? psw->time_max : 64;
+			while( newmax <= depth )
+				newmax *= 2;
+			newtimes = (uint64_t*)realloc(psw->time_at, sizeof(uint64_t) * newmax);
+			if( newtimes == NULL )
+				return false;
+			memset(newtimes + psw->time_max, 0, sizeof(uint64_t) * (newmax - psw->time_max));
+			psw->time_at = newtimes;
+			psw->time_max = newmax;
+		}
+		psw->time_at[depth] += span;
+		psw->area += span * depth;
+		if( depth > 0 )
+			psw->busy += span;
+
+		depth += edges[i].delta;
+		if( depth > psw->max_depth )
+			psw->max_depth = depth;
+		prev = edges[i].time;
+	}
+	return true;
+}
+
+static void print_depth_device(uint32_t device, struct depth_sweep* psws, uint64_t total){
+	int k = 0, d = 0, max_depth = 0;
+	char group[32];
+
+	snprintf(group, sizeof(group), "dev %u,%u",
+		(unsigned int)(device >> 20), (unsigned int)(device & ((1 << 20) - 1)));
+	for(k=0; k<DEPTH_KIND_CNT; k++){
+		fprintf(output, "%12s %6s %8d %8.2f %8.2f\n",
+			k == 0 ? group : " ", depth_kind_names[k], psws[k].max_depth,
+			(double)psws[k].area / total, (double)psws[k].busy * 100 / total);
+		if( psws[k].max_depth > max_depth )
+			max_depth = psws[k].max_depth;
+	}
+
+	//time share of each depth. the time out of the edges is depth 0
+	fprintf(output, "%12s %6s", " ", "Depth");
+	for(k=0; k<DEPTH_KIND_CNT; k++)
+		fprintf(output, " %7s%%", depth_kind_names[k]);
+	fprintf(output, "\n");
+	for(d=0; d<=max_depth; d++){
+		for(k=0; k<DEPTH_KIND_CNT; k++){
+			if( d < psws[k].time_max && psws[k].time_at[d] > 0 )
+				break;
+		}
+		if( k == DEPTH_KIND_CNT && d > 0 )
+			continue;
+
+		fprintf(output, "%12s %6d", " ", d);
+		for(k=0; k<DEPTH_KIND_CNT; k++){
+			uint64_t t = (d < psws[k].time_max) ? psws[k].time_at[d] : 0;
+			if( d == 0 )
+				t = total - psws[k].busy;
+			fprintf(output, " %8.2f", (double)t * 100 / total);
+		}
+		fprintf(output, "\n");
+	}
+	fprintf(output, "\n");
+}
+
+// sweep the sorted edges and give the sweeps of each device to 'fn'
+static bool sweep_devices(struct depth_stat* pds, uint64_t total,
+			void (*fn)(uint32_t, struct depth_sweep*, uint64_t)){
+	struct depth_sweep sweeps[DEPTH_KIND_CNT];
+	size_t i = 0, start = 0;
+	bool ok = true;
+	int k = 0;
+
+	memset(sweeps, 0, sizeof(sweeps));
+	for(i=1; i<=pds->edge_cnt; i++){
+		if( i < pds->edge_cnt && pds->edges[i].device == pds->edges[start].device &&
+			pds->edges[i].kind == pds->edges[start].kind )
+			continue;
+
+		if( !sweep_depth(pds->edges, start, i, &sweeps[pds->edges[start].kind]) ){
+			perror("failed to process queue depth");
+			ok = false;
+			break;
+		}
+		if( i == pds->edge_cnt || pds->edges[i].device != pds->edges[start].device ){
+			fn(pds->edges[start].device, sweeps, total);
+			for(k=0; k<DEPTH_KIND_CNT; k++)
+				free(sweeps[k].time_at);
+			memset(sweeps, 0, sizeof(sweeps));
+		}
+		start = i;
+	}
+	for(k=0; k<DEPTH_KIND_CNT; k++)
+		free(sweeps[k].time_at);
+	return ok;
+}
+
+static const struct emit_col depth_cols[] = {
+	{ "device", EMIT_STR }, { "kind", EMIT_STR }, { "max_depth", EMIT_U64 },
+	{ "avg_depth", EMIT_F64 }, { "busy_percent", EMIT_F64 }
+};
+
+static const struct emit_col depth_share_cols[] = {
+	{ "device", EMIT_STR }, { "kind", EMIT_STR }, { "depth", EMIT_U64 }, { "share_percent", EMIT_F64 }
+};
+
+static void emit_depth_device(uint32_t device, struct depth_sweep* psws, uint64_t total){
+	char dev[32];
+	int k = 0;
+
+	snprintf(dev, sizeof(dev), "%u,%u", (unsigned int)(device >> 20), (unsigned int)(device & ((1 << 20) - 1)));
+	for(k=0; k<DEPTH_KIND_CNT; k++){
+		emit_row(&emitter);
+		emit_str(&emitter, dev);
+		emit_str(&emitter, depth_kind_names[k]);
+		emit_u64(&emitter, psws[k].max_depth);
+		emit_f64(&emitter, (double)psws[k].area / total);
+		emit_f64(&emitter, (double)psws[k].busy * 100 / total);
+		emit_row_end(&emitter);
+	}
+}
+
+// only the depths which have time, like print_depth_device
+static void emit_depth_share(uint32_t device, struct depth_sweep* psws, uint64_t total){
+	char dev[32];
+	uint64_t t = 0;
+	int k = 0, d = 0;
+
+	snprintf(dev, sizeof(dev), "%u,%u", (unsigned int)(device >> 20), (unsigned int)(device & ((1 << 20) - 1)));
+	for(k=0; k<DEPTH_KIND_CNT; k++){
+		for(d=0; d<=psws[k].max_depth; d++){
+			t = (d < psws[k].time_max) ? psws[k].time_at[d] : 0;
+			if( d == 0 )
+				t = total - psws[k].busy;
+			else if( t == 0 )
+				continue;
+
+			emit_row(&emitter);
+			emit_str(&emitter, dev);
+			emit_str(&emitter, depth_kind_names[k]);
+			emit_u64(&emitter, d);
+			emit_f64(&emitter, (double)t * 100 / total);
+			emit_row_end(&emitter);
+		}
+	}
+}
+
+void process_depth_statistic(void* part, int ng_cnt){
+	struct depth_stat* pds = (struct depth_stat*)part;
+	uint64_t total = 0;
+
+	if( pds->edge_cnt == 0 || time_bit_cnt == 0 )
+		goto out;
+
+	//depth and busy time are the share of the whole trace
+	total = time_bits[time_bit_cnt-1]->time - time_bits[0]->time;
+	if( total == 0 )
+		goto out;
+
+	qsort(pds->edges, pds->edge_cnt, sizeof(struct depth_edge), cmp_depth_edge);
+
+	//the emitted tables are streamed one after another, so the edges are swept for each
+	if( out_format != EMIT_TEXT ){
+		emit_table(&emitter, "depth", depth_cols, 5);
+		if( sweep_devices(pds, total, emit_depth_device) ){
+			emit_table(&emitter, "depth_share", depth_share_cols, 4);
+			sweep_devices(pds, total, emit_depth_share);
+		}
+		goto out;
+	}
+
+	fprintf(output, "%12s %6s %8s %8s %8s\n", "Device", "Kind", "MaxDepth", "AvgDepth", "Busy%");
+	sweep_devices(pds, total, print_depth_device);
+
+out:
+	free(pds->edges);
+	free(pds);
+}
+
+//------------------- top statistics ------------------------------//
+// the slowest nuggets by Q2C are kept in a min-heap of top_cnt entries,
+// so a nugget only has to beat the fastest of them to get in.
+// ties are broken by sector and time to give the same nuggets for any -j.
+
+static bool top_less(struct top_entry* a, struct top_entry* b){
+	if( a->lat != b->lat )
+		return a->lat < b->lat;
+	if( a->pdng->sector != b->pdng->sector )
+		return a->pdng->sector > b->pdng->sector;
+	return a->pdng->times[0] > b->pdng->times[0];
+}
+
+static void top_sift_down(struct top_stat* ptop, size_t i){
+	struct top_entry tmp;
+	size_t child = 0;
+
+	while( (child = i * 2 + 1) < ptop->cnt ){
+		if( child + 1 < ptop->cnt && top_less(&ptop->heap[child + 1], &ptop->heap[child]) )
+			child++;
+		if( !top_less(&ptop->heap[child], &ptop->heap[i]) )
+			break;
+		tmp = ptop->heap[i];
+		ptop->heap[i] = ptop->heap[child];
+		ptop->heap[child] = tmp;
+		i = child;
+	}
+}
+
+static void top_push(struct top_stat* ptop, struct top_entry* pent){
+	struct top_entry tmp;
+	size_t i = 0, parent = 0;
+
+	if( ptop->cnt == top_cnt ){
+		if( !top_less(&ptop->heap[0], pent) )
+			return;
+		ptop->heap[0] = *pent;
+		top_sift_down(ptop, 0);
+		return;
+	}
+
+	i = ptop->cnt++;
+	ptop->heap[i] = *pent;
+	while( i > 0 ){
+		parent = (i - 1) / 2;
+		if( !top_less(&ptop->heap[i], &ptop->heap[parent]) )
+			break;
+		tmp = ptop->heap[i];
+		ptop->heap[i] = ptop->heap[parent];
+		ptop->heap[parent] = tmp;
+		i = parent;
+	}
+}
+
+void* init_top_statistic(){
+	struct top_stat* ptop = (struct top_stat*)calloc(1, sizeof(struct top_stat));
+
+	if( ptop == NULL )
+		return NULL;
+	ptop->heap = (struct top_entry*)malloc(sizeof(struct top_entry) * top_cnt);
+	if( ptop->heap == NULL ){
+		free(ptop);
+		return NULL;
+	}
+	return ptop;
+}
+
+void travel_top_statistic(void* part, struct dio_nugget* pdng){
+	struct top_entry ent;
+	int64_t q2c = find_stage_time(pdng, STAGE_Q2C);
+
+	if( q2c < 0 )
+		return;
+	ent.lat = q2c;
+	ent.pdng = pdng;
+	top_push((struct top_stat*)part, &ent);
+}
+
+void merge_top_statistic(void* dst, void* src){
+	struct top_stat* psrc = (struct top_stat*)src;
+	size_t i = 0;
+
+	for(i=0; i<psrc->cnt; i++)
+		top_push((struct top_stat*)dst, &psrc->heap[i]);
+	free(psrc->heap);
+	free(psrc);
+}
+
+// the slowest first
+static int cmp_top_entry(const void* a, const void* b){
+	struct top_entry* pa = (struct top_entry*)a;
+	struct top_entry* pb = (struct top_entry*)b;
+
+	if( top_less(pa, pb) )
+		return 1;
+	if( top_less(pb, pa) )
+		return -1;
+	return 0;
+}
+
+// actions of the nugget like "Q>G>I>D>C"
+static void format_state_path(struct dio_nugget* pdng, char* buf, size_t len){
+	size_t n = 0;
+	int i = 0;
+
+	for(i=0; i<pdng->elemidx && i<MAX_ELEMENT_SIZE && n + 2 < len; i++){
+		if( i > 0 )
+			buf[n++] = '>';
+		buf[n++] = pdng->states[i];
+	}
+	buf[n] = '\0';
+}
+
+#define TOP_COL_CNT	14
+static const struct emit_col top_cols[TOP_COL_CNT] = {
+	{ "rank", EMIT_U64 }, { "time_ns", EMIT_U64 }, { "latency_ns", EMIT_U64 }, { "sector", EMIT_U64 },
+	{ "size", EMIT_U64 }, { "pid", EMIT_U64 }, { "cpu", EMIT_U64 }, { "device", EMIT_STR },
+	{ "rw", EMIT_STR }, { "path", EMIT_STR }, { "q2g_ns", EMIT_U64 }, { "g2i_ns", EMIT_U64 },
+	{ "i2d_ns", EMIT_U64 }, { "d2c_ns", EMIT_U64 }
+};
+
+void process_top_statistic(void* part, int ng_cnt){
+	struct top_stat* ptop = (struct top_stat*)part;
+	struct dio_nugget* pdng = NULL;
+	char path[MAX_ELEMENT_SIZE * 2 + 1];
+	char dev[24];
+	const char* rw = NULL;
+	int64_t stage_time = 0;
+	size_t i = 0;
+	int s = 0;
+
+	qsort(ptop->heap, ptop->cnt, sizeof(struct top_entry), cmp_top_entry);
+
+	if( out_format != EMIT_TEXT )
+		emit_table(&emitter, "top", top_cols, TOP_COL_CNT);
+	else
+		fprintf(output, "%5s %15s %12s %12s %7s %7s %4s %9s %2s %12s %12s %12s %12s %s\n",
+			"Rank", "Time", "Latency", "Sector", "Size", "Pid", "CPU", "Device", "RW",
+			"Q2G", "G2I", "I2D", "D2C", "Path");
+	for(i=0; i<ptop->cnt; i++){
+		pdng = ptop->heap[i].pdng;
+		format_state_path(pdng, path, sizeof(path));
+		snprintf(dev, sizeof(dev), "%u,%u", pdng->device >> 20, pdng->device & ((1 << 20) - 1));
+		rw = pdng->category & BLK_TC_READ ? "R" : pdng->category & BLK_TC_WRITE ? "W" : "-";
+
+		if( out_format != EMIT_TEXT ){
+			emit_row(&emitter);
+			emit_u64(&emitter, i + 1);
+			emit_u64(&emitter, pdng->times[0]);
+			emit_u64(&emitter, ptop->heap[i].lat);
+			emit_u64(&emitter, pdng->sector);
+			emit_u64(&emitter, pdng->size);
+			emit_u64(&emitter, pdng->pid);
+			emit_u64(&emitter, pdng->idxCPU);
+			emit_str(&emitter, dev);
+			emit_str(&emitter, rw);
+			emit_str(&emitter, path);
+			//a stage which the nugget didn't pass is 0
+			for(s=0; s<STAGE_Q2C; s++){
+				stage_time = find_stage_time(pdng, s);
+				emit_u64(&emitter, stage_time < 0 ? 0 : stage_time);
+			}
+			emit_row_end(&emitter);
+			continue;
+		}
+
+		fprintf(output, "%5zu %5d.%09lu %2llu.%.9llu %12llu %7d %7u %4d %9s %2s ", i + 1,
+			(int)SECONDS(pdng->times[0]), (unsigned long)NANO_SECONDS(pdng->times[0]),
+			SECONDS(ptop->heap[i].lat), NANO_SECONDS(ptop->heap[i].lat),
+			(unsigned long long)pdng->sector, pdng->size, pdng->pid, pdng->idxCPU, dev, rw);
+		for(s=0; s<STAGE_Q2C; s++){
+			stage_time = find_stage_time(pdng, s);
+			if( stage_time < 0 )
+				fprintf(output, "%12s ", "-");
+			else
+				fprintf(output, "%2llu.%.9llu ", SECONDS(stage_time), NANO_SECONDS(stage_time));
 		}
+		fprintf(output, "%s\n", path);
+	}
+	if( out_format == EMIT_TEXT )
 		fprintf(output, "\n");
 
-		fprintf(output, "%20s %6s ", " ", "Write");
-		print_data_time_statistic(output, &pnugget_path->data_time_interval_write[i]);
-		if(pnugget_path->data_time_write.average_time != 0)
-		{
-			fprintf(output, " %2.2f%%", ((double)pnugget_path->data_time_interval_write[i].average_time / pnugget_path->data_time_write.average_time) * 100);
-		}
-		else
-		{
-			fprintf(output, " %2.2f%%", 0.0);
+	free(ptop->heap);
+	free(ptop);
+}
+
+//------------------- hotspot statistics ------------------------------//
+// the disk is cut in extents and the I/Os and bytes of each extent are
+// counted in count-min sketches, while Space-Saving keeps the extents
+// which may be the hottest. the truth of a reported extent is between
+// the lower bound of Space-Saving and the smaller of the two estimates,
+// both of which never count less than the truth.
+
+// parse the size like "64K". 0 is returned for a wrong size
+uint64_t parse_byte_size(const char* str){
+	char* unit = NULL;
+	unsigned long long size = strtoull(str, &unit, 10);
+
+	if( unit == str )
+		return 0;
+	if( *unit == '\0' || !strcmp(unit, "B") )
+		return size;
+	if( !strcmp(unit, "K") || !strcmp(unit, "k") )
+		return size * 1024;
+	if( !strcmp(unit, "M") || !strcmp(unit, "m") )
+		return size * 1024 * 1024;
+	if( !strcmp(unit, "G") || !strcmp(unit, "g") )
+		return size * 1024 * 1024 * 1024;
+	return 0;
+}
+
+void* init_hotspot_statistic(){
+	struct hotspot_stat* phs = (struct hotspot_stat*)malloc(sizeof(struct hotspot_stat));
+
+	if( phs == NULL )
+		return NULL;
+	cms_init(&phs->cm_ios);
+	cms_init(&phs->cm_bytes);
+	ss_init(&phs->ss_ios);
+	ss_init(&phs->ss_bytes);
+	return phs;
+}
+
+// an I/O is counted in every extent it touches, with its bytes in each
+void travel_hotspot_statistic(void* part, struct dio_nugget* pdng){
+	struct hotspot_stat* phs = (struct hotspot_stat*)part;
+	uint64_t start = pdng->sector * 512, end = start + pdng->size;
+	uint64_t ext = 0, from = 0, to = 0, key = 0;
+
+	if( pdng->size <= 0 )
+		return;
+	for(ext = start / hotspot_extent; ext * hotspot_extent < end; ext++){
+		from = ext * hotspot_extent;
+		to = from + hotspot_extent;
+		if( from < start )
+			from = start;
+		if( to > end )
+			to = end;
+
+		key = dev_index_key(pdng->device, ext);
+		cms_add(&phs->cm_ios, key, 1);
+		cms_add(&phs->cm_bytes, key, to - from);
+		ss_add(&phs->ss_ios, key, 1);
+		ss_add(&phs->ss_bytes, key, to - from);
+	}
+}
+
+void merge_hotspot_statistic(void* dst, void* src){
+	struct hotspot_stat* pdst = (struct hotspot_stat*)dst;
+	struct hotspot_stat* psrc = (struct hotspot_stat*)src;
+
+	cms_merge(&pdst->cm_ios, &psrc->cm_ios);
+	cms_merge(&pdst->cm_bytes, &psrc->cm_bytes);
+	ss_merge(&pdst->ss_ios, &psrc->ss_ios);
+	ss_merge(&pdst->ss_bytes, &psrc->ss_bytes);
+	free(psrc);
+}
+
+// a candidate extent with its bounds
+struct hotspot{
+	uint64_t key;
+	uint64_t upper;
+	uint64_t lower;
+};
+
+static int cmp_hotspot(const void* a, const void* b){
+	const struct hotspot* pa = (const struct hotspot*)a;
+	const struct hotspot* pb = (const struct hotspot*)b;
+
+	if( pa->upper != pb->upper )
+		return pa->upper < pb->upper ? 1 : -1;
+	if( pa->key != pb->key )
+		return pa->key > pb->key ? 1 : -1;
+	return 0;
+}
+
+#define HOTSPOT_COL_CNT	9
+static const struct emit_col hotspot_cols[HOTSPOT_COL_CNT] = {
+	{ "by", EMIT_STR }, { "rank", EMIT_U64 }, { "device", EMIT_STR }, { "sector_start", EMIT_U64 },
+	{ "sector_end", EMIT_U64 }, { "estimate", EMIT_U64 }, { "lower", EMIT_U64 }, { "error", EMIT_U64 },
+	{ "rate", EMIT_F64 }
+};
+
+static void print_hotspots(const char* by, struct count_min* pcm, struct space_saving* pss, double sec){
+	struct hotspot spots[SS_CAPACITY];
+	uint64_t est = 0, sector = 0, err = cms_error(pcm);
+	char dev[24];
+	double rate = 0;
+	int i = 0;
+
+	for(i=0; i<pss->cnt; i++){
+		spots[i].key = pss->ents[i].key;
+		spots[i].upper = pss->ents[i].count;
+		spots[i].lower = pss->ents[i].count - pss->ents[i].err;
+		est = cms_estimate(pcm, spots[i].key);
+		if( est < spots[i].upper )
+			spots[i].upper = est;
+	}
+	qsort(spots, pss->cnt, sizeof(struct hotspot), cmp_hotspot);
+
+	if( out_format == EMIT_TEXT ){
+		fprintf(output, "Hottest extents of %llu bytes by %s (estimates are over by at most %llu with %.1f%% probability)\n",
+			(unsigned long long)hotspot_extent, by, (unsigned long long)err, CMS_CONFIDENCE);
+		fprintf(output, "%5s %9s %25s %14s %14s %12s\n", "Rank", "Device", "Sectors",
+			"Estimate", "Lower", !strcmp(by, "ios") ? "IOPS" : "MB/s");
+	}
+	for(i=0; i<pss->cnt && i<HOTSPOT_TOP_CNT; i++){
+		snprintf(dev, sizeof(dev), "%u,%u", (unsigned int)(spots[i].key >> (DEV_KEY_INDEX_BITS + 20)),
+			(unsigned int)((spots[i].key >> DEV_KEY_INDEX_BITS) & ((1 << 20) - 1)));
+		//the range of sectors is inclusive, as the -S filter is
+		sector = (spots[i].key & ((1ULL << DEV_KEY_INDEX_BITS) - 1)) * (hotspot_extent / 512);
+		rate = sec > 0 ? spots[i].upper / sec : 0;
+		if( strcmp(by, "ios") )
+			rate /= 1024 * 1024;
+
+		if( out_format != EMIT_TEXT ){
+			emit_row(&emitter);
+			emit_str(&emitter, by);
+			emit_u64(&emitter, i + 1);
+			emit_str(&emitter, dev);
+			emit_u64(&emitter, sector);
+			emit_u64(&emitter, sector + hotspot_extent / 512 - 1);
+			emit_u64(&emitter, spots[i].upper);
+			emit_u64(&emitter, spots[i].lower);
+			emit_u64(&emitter, err);
+			emit_f64(&emitter, rate);
+			emit_row_end(&emitter);
+			continue;
 		}
-		fprintf(output, "\n");
+		fprintf(output, "%5d %9s %12llu-%-12llu %14llu %14llu %12.2f\n", i + 1, dev,
+			(unsigned long long)sector, (unsigned long long)(sector + hotspot_extent / 512 - 1),
+			(unsigned long long)spots[i].upper, (unsigned long long)spots[i].lower, rate);
 	}
-	fprintf(output, "\n");
+	if( out_format == EMIT_TEXT )
+		fprintf(output, "\n");
 }
 
-void print_data_time_statistic(FILE* stream, struct data_time* pdata_time)
-{
-	fprintf(stream, "%6d %2llu.%.9llu %2llu.%.9llu %2llu.%.9llu", pdata_time->count,
-			SECONDS(pdata_time->average_time), NANO_SECONDS(pdata_time->average_time),
-			SECONDS(pdata_time->max_time), NANO_SECONDS(pdata_time->max_time),
-			SECONDS(pdata_time->min_time), NANO_SECONDS(pdata_time->min_time)
-	       );
+void process_hotspot_statistic(void* part, int ng_cnt){
+	struct hotspot_stat* phs = (struct hotspot_stat*)part;
+	double sec = 0;
+
+	if( time_bit_cnt > 1 )
+		sec = (time_bits[time_bit_cnt - 1]->time - time_bits[0]->time) / 1000000000.0;
+
+	if( out_format != EMIT_TEXT )
+		emit_table(&emitter, "hotspots", hotspot_cols, HOTSPOT_COL_CNT);
+	print_hotspots("ios", &phs->cm_ios, &phs->ss_ios, sec);
+	print_hotspots("bytes", &phs->cm_bytes, &phs->ss_bytes, sec);
+	free(phs);
 }
 
-//---------------------------------------- pid statistic -------------------------------------------------//
-//function for handling data structure for pid statistic
-struct pid_stat_data* rb_search_psd(uint32_t pid){
-	struct rb_node* n = psd_root.rb_node;
-	struct pid_stat_data* ppsd = NULL;
-	
-	while(n){
-		ppsd = rb_entry(n, struct pid_stat_data, link);
+//------------------- working set statistics ------------------------------//
+// the 4KB blocks touched by reads and writes are put in HyperLogLog
+// sketches of their time window and their pid. a sketch is a few KB
+// for any number of blocks, and the working set of several windows,
+// of reads and writes together or of the whole trace is the estimate
+// of the merged sketches.
 
-		if( pid < ppsd->pid )
-			n = n->rb_left;
-		else if( pid > ppsd->pid )
-			n = n->rb_right;
-		else 
-			return ppsd;
-	}
-	return NULL;
+static struct ws_sketch* new_ws_sketch(uint64_t key){
+	struct ws_sketch* pws = (struct ws_sketch*)malloc(sizeof(struct ws_sketch));
+	int i = 0;
+
+	if( pws == NULL )
+		return NULL;
+	pws->key = key;
+	for(i=0; i<WS_RW_CNT; i++)
+		hll_init(&pws->hlls[i]);
+	return pws;
 }
 
-struct pid_stat_data* __rb_insert_psd(struct pid_stat_data* newpsd){
-	struct pid_stat_data* ret;
-	struct rb_node** p = &(psd_root.rb_node);
+static struct ws_sketch* get_ws_pid(struct rb_root* root, uint64_t pid){
+	struct rb_node** p = &root->rb_node;
 	struct rb_node* parent = NULL;
-	
+	struct ws_sketch* pws = NULL;
+
 	while(*p){
 		parent = *p;
-		ret = rb_entry(parent, struct pid_stat_data, link);
+		pws = rb_entry(parent, struct ws_sketch, link);
 
-		if( newpsd->pid < ret->pid )
+		if( pid < pws->key )
 			p = &(*p)->rb_left;
-		else if( newpsd->pid > ret->pid )
+		else if( pid > pws->key )
 			p = &(*p)->rb_right;
 		else
-			return ret;
+			return pws;
 	}
 
-	rb_link_node(&newpsd->link, parent, p);
-	return NULL;
+	pws = new_ws_sketch(pid);
+	if( pws == NULL )
+		return NULL;
+	rb_link_node(&pws->link, parent, p);
+	rb_insert_color(&pws->link, root);
+	return pws;
 }
 
-struct pid_stat_data* rb_insert_psd(struct pid_stat_data* newpsd){
-	struct pid_stat_data* ret = NULL;
-	if( (ret = __rb_insert_psd(newpsd) ) )
-		return ret;
-	rb_insert_color(&newpsd->link, &psd_root);
-	return ret;
+static void __clear_ws_pid(struct rb_node* p){
+	if( p == NULL )
+		return;
+	__clear_ws_pid(p->rb_left);
+	__clear_ws_pid(p->rb_right);
+	free(rb_entry(p, struct ws_sketch, link));
 }
 
-void __clear_pid_stat(struct rb_node* p){
-	if( p->rb_left != NULL )
-		__clear_pid_stat(p->rb_left);
-	if( p->rb_right != NULL )
-		__clear_pid_stat(p->rb_right);
-	
-	struct pid_stat_data* psd = rb_entry(p, struct pid_stat_data, link);
-	free(psd);
-}
+// the window 'idx' is made when it is touched first
+static struct ws_sketch* get_ws_window(struct ws_stat* pwst, size_t idx){
+	struct ws_sketch** newwins = NULL;
+	size_t newcnt = pwst->win_cnt ? pwst->win_cnt : 64;
 
-FILE* fPidData = NULL;
-void init_pid_statistic()
-{
-	if(is_graphic)
-	{
-		fPidData = fopen("dioparse.pid.dat", "wt");
-		if(!fPidData)
-		{
-			DBGOUT("dioparse.pid.dat open error \n");
-			return ;
-		}
+	if( idx >= pwst->win_cnt ){
+		while( newcnt <= idx )
+			newcnt *= 2;
+		newwins = (struct ws_sketch**)realloc(pwst->windows, sizeof(struct ws_sketch*) * newcnt);
+		if( newwins == NULL )
+			return NULL;
+		memset(newwins + pwst->win_cnt, 0, sizeof(struct ws_sketch*) * (newcnt - pwst->win_cnt));
+		pwst->windows = newwins;
+		pwst->win_cnt = newcnt;
 	}
+	if( pwst->windows[idx] == NULL )
+		pwst->windows[idx] = new_ws_sketch(pwst->base + idx * ws_width);
+	return pwst->windows[idx];
 }
 
-void travel_pid_statistic(struct dio_nugget* pdng){
-	struct pid_stat_data* ppsd = rb_search_psd(pdng->pid);
-	if( ppsd == NULL ){
-		ppsd = (struct pid_stat_data*)malloc(sizeof(struct pid_stat_data));
-		ppsd->pid = pdng->pid;
-		
-		ppsd->data_time_read.min_time = (unsigned int)(-1);
-		ppsd->data_time_read.max_time = 0;
-		ppsd->data_time_read.total_time = 0;
-		ppsd->data_time_read.count = 0;
-		ppsd->data_time_read.average_time = 0;
-
-		ppsd->data_time_write.min_time = (unsigned int)(-1);
-		ppsd->data_time_write.max_time = 0;
-		ppsd->data_time_write.total_time = 0;
-		ppsd->data_time_write.count = 0;
-		ppsd->data_time_write.average_time = 0;
-		
-		rb_insert_psd(ppsd);
-	}
-	
-	uint64_t tmpt = 0;
-	if( pdng->category & BLK_TC_READ ){
-		tmpt = pdng->times[pdng->elemidx-1] - pdng->times[0];
-		if( ppsd->data_time_read.min_time > tmpt )
-			ppsd->data_time_read.min_time = tmpt;
-		else if( ppsd->data_time_read.max_time < tmpt )
-			ppsd->data_time_read.max_time = tmpt;
-		ppsd->data_time_read.total_time += tmpt;
-		ppsd->data_time_read.count ++;
-	}
-	else if( pdng->category & BLK_TC_WRITE ){
-		tmpt = pdng->times[pdng->elemidx-1] - pdng->times[0];
-		if( ppsd->data_time_write.min_time > tmpt )
-			ppsd->data_time_write.min_time = tmpt;
-		else if( ppsd->data_time_write.max_time < tmpt )
-			ppsd->data_time_write.max_time = tmpt;
-		ppsd->data_time_write.total_time = tmpt;
-		ppsd->data_time_write.count ++;
+void* init_ws_statistic(){
+	struct ws_stat* pwst = (struct ws_stat*)calloc(1, sizeof(struct ws_stat));
+
+	if( pwst == NULL )
+		return NULL;
+	if( time_bit_cnt > 0 )
+		pwst->base = time_bits[0]->time / ws_width * ws_width;
+	pwst->pid_root = RB_ROOT;
+	return pwst;
+}
+
+void travel_ws_statistic(void* part, struct dio_nugget* pdng){
+	struct ws_stat* pwst = (struct ws_stat*)part;
+	struct ws_sketch* pwin = NULL;
+	struct ws_sketch* ppid = NULL;
+	uint64_t blk = 0, end = 0, key = 0;
+	int rw = 0;
+
+	if( pdng->size <= 0 || pdng->times[0] < pwst->base )
+		return;
+	if( pdng->category & BLK_TC_READ )
+		rw = WS_READ;
+	else if( pdng->category & BLK_TC_WRITE )
+		rw = WS_WRITE;
+	else
+		return;
+
+	pwin = get_ws_window(pwst, (pdng->times[0] - pwst->base) / ws_width);
+	ppid = get_ws_pid(&pwst->pid_root, pdng->pid);
+	if( pwin == NULL || ppid == NULL )
+		return;
+
+	end = (pdng->sector * 512 + pdng->size + WS_BLOCK_SIZE - 1) / WS_BLOCK_SIZE;
+	for(blk = pdng->sector * 512 / WS_BLOCK_SIZE; blk < end; blk++){
+		key = dev_index_key(pdng->device, blk);
+		hll_add(&pwin->hlls[rw], key);
+		hll_add(&ppid->hlls[rw], key);
 	}
 }
 
-void process_pid_statistic(int ng_cnt){
+static void merge_ws_sketch(struct ws_sketch* pdst, struct ws_sketch* psrc){
+	int i = 0;
+
+	for(i=0; i<WS_RW_CNT; i++)
+		hll_merge(&pdst->hlls[i], &psrc->hlls[i]);
+}
+
+void merge_ws_statistic(void* dst, void* src){
+	struct ws_stat* pdst = (struct ws_stat*)dst;
+	struct ws_stat* psrc = (struct ws_stat*)src;
+	struct ws_sketch* pws = NULL;
 	struct rb_node* node = NULL;
+	size_t i = 0;
 
-	if(is_graphic)
-	{
-		fprintf(fPidData, "%s %s %s\n", "pid", "read", "write");
+	for(i=0; i<psrc->win_cnt; i++){
+		if( psrc->windows[i] == NULL )
+			continue;
+		pws = get_ws_window(pdst, i);
+		if( pws != NULL )
+			merge_ws_sketch(pws, psrc->windows[i]);
+		free(psrc->windows[i]);
 	}
-	else
-	{
-		fprintf(output,"%10s %6s %6s %12s %12s %12s \n", "pid", "Type", "No", "AverageTime", "MaxTime", "MinTime");
+	for(node = rb_first(&psrc->pid_root); node != NULL; node = rb_next(node)){
+		pws = get_ws_pid(&pdst->pid_root, rb_entry(node, struct ws_sketch, link)->key);
+		if( pws != NULL )
+			merge_ws_sketch(pws, rb_entry(node, struct ws_sketch, link));
 	}
-	node = rb_first(&psd_root);
-	do{
-		struct pid_stat_data* ppsd = NULL;
-		ppsd = rb_entry(node, struct pid_stat_data, link);
-		
-		if( ppsd->data_time_read.count != 0 ){
-			ppsd->data_time_read.average_time = 
-				ppsd->data_time_read.total_time / ppsd->data_time_read.count;
-		}
-		if( ppsd->data_time_write.count != 0 ){
-			ppsd->data_time_write.average_time = 
-				ppsd->data_time_write.total_time / ppsd->data_time_write.count;
-		}
-
-		if( ppsd->data_time_read.min_time == (uint64_t)(-1) )
-			ppsd->data_time_read.min_time = 0;
-		if( ppsd->data_time_write.min_time == (uint64_t)(-1) )
-			ppsd->data_time_write.min_time = 0;
+	__clear_ws_pid(psrc->pid_root.rb_node);
+	free(psrc->windows);
+	free(psrc);
+}
 
-		//printing
-		if(is_graphic)
-		{
-			print_pid_statistic_graphic(ppsd);
-		}
-		else
-		{
-			print_pid_statistic_text(ppsd);
-		}
-	}while( (node = rb_next(node)) != NULL );
+#define WS_COL_CNT	8
+static const struct emit_col ws_cols[WS_COL_CNT] = {
+	{ "group", EMIT_STR }, { "key", EMIT_U64 }, { "r_blocks", EMIT_U64 }, { "w_blocks", EMIT_U64 },
+	{ "blocks", EMIT_U64 }, { "r_bytes", EMIT_U64 }, { "w_bytes", EMIT_U64 }, { "bytes", EMIT_U64 }
+};
 
-	//clear all pid tree
-	struct rb_node* parent = psd_root.rb_node;
-	__clear_pid_stat(parent);
+// estimates of reads, writes and both of a sketch
+static void print_ws_sketch(struct ws_sketch* pws, const char* group){
+	struct hyperloglog all = pws->hlls[WS_READ];
+	uint64_t blocks[WS_RW_CNT + 1];
+	int i = 0;
 
-	if(fPidData != NULL)
-	{
-		fclose(fPidData);
-		system("gnuplot pid.cmd -p");
+	hll_merge(&all, &pws->hlls[WS_WRITE]);
+	for(i=0; i<WS_RW_CNT; i++)
+		blocks[i] = (uint64_t)(hll_count(&pws->hlls[i]) + 0.5);
+	blocks[WS_RW_CNT] = (uint64_t)(hll_count(&all) + 0.5);
+
+	if( out_format != EMIT_TEXT ){
+		emit_row(&emitter);
+		emit_str(&emitter, group);
+		emit_u64(&emitter, pws->key);
+		for(i=0; i<=WS_RW_CNT; i++)
+			emit_u64(&emitter, blocks[i]);
+		for(i=0; i<=WS_RW_CNT; i++)
+			emit_u64(&emitter, blocks[i] * WS_BLOCK_SIZE);
+		emit_row_end(&emitter);
+		return;
 	}
+
+	if( !strcmp(group, "window") )
+		fprintf(output, "%5d.%09lu", (int)SECONDS(pws->key), (unsigned long)NANO_SECONDS(pws->key));
+	else if( !strcmp(group, "pid") )
+		fprintf(output, "%15llu", (unsigned long long)pws->key);
+	else
+		fprintf(output, "%15s", "Total");
+	for(i=0; i<=WS_RW_CNT; i++)
+		fprintf(output, " %12llu", (unsigned long long)blocks[i]);
+	for(i=0; i<=WS_RW_CNT; i++)
+		fprintf(output, " %12.2f", blocks[i] * WS_BLOCK_SIZE / (1024.0 * 1024));
+	fprintf(output, "\n");
 }
 
-void print_pid_statistic_graphic(struct pid_stat_data* ppsd)
-{
-	fprintf(fPidData, "%"PRIu32" %d %d\n", ppsd->pid, ppsd->data_time_read.count, ppsd->data_time_write.count);
+static void print_ws_header(const char* key){
+	fprintf(output, "%15s %12s %12s %12s %12s %12s %12s\n", key,
+		"R_Blocks", "W_Blocks", "Blocks", "R_MB", "W_MB", "MB");
 }
-void print_pid_statistic_text(struct pid_stat_data* ppsd)
-{
-	fprintf(output, "%10"PRIu32" %6s %6d %2llu.%.9llu %2llu.%.9llu %2llu.%.9llu \n", 
-			ppsd->pid, "Read", ppsd->data_time_read.count, 
-			SECONDS(ppsd->data_time_read.average_time), NANO_SECONDS(ppsd->data_time_read.average_time),
-			SECONDS(ppsd->data_time_read.max_time), NANO_SECONDS(ppsd->data_time_read.max_time),
-			SECONDS(ppsd->data_time_read.min_time), NANO_SECONDS(ppsd->data_time_read.min_time)
-	       );
-
-	fprintf(output, "%10s %6s %6d %2llu.%.9llu %2llu.%.9llu %2llu.%.9llu \n", 
-			" ", "Write", ppsd->data_time_write.count,
-			SECONDS(ppsd->data_time_write.average_time), NANO_SECONDS(ppsd->data_time_write.average_time),
-			SECONDS(ppsd->data_time_write.max_time), NANO_SECONDS(ppsd->data_time_write.max_time),
-			SECONDS(ppsd->data_time_write.min_time), NANO_SECONDS(ppsd->data_time_write.min_time)
-	       );
-	fprintf(output, "\n");
+
+void process_ws_statistic(void* part, int ng_cnt){
+	struct ws_stat* pwst = (struct ws_stat*)part;
+	struct ws_sketch* pws = NULL;
+	struct ws_sketch total;
+	struct rb_node* node = NULL;
+	size_t i = 0;
+
+	memset(&total, 0, sizeof(total));
+	if( out_format != EMIT_TEXT )
+		emit_table(&emitter, "workingset", ws_cols, WS_COL_CNT);
+	else{
+		fprintf(output, "Working set in %d byte blocks\n", WS_BLOCK_SIZE);
+		print_ws_header("Time");
+	}
+	for(i=0; i<pwst->win_cnt; i++){
+		if( pwst->windows[i] == NULL )
+			continue;
+		print_ws_sketch(pwst->windows[i], "window");
+		merge_ws_sketch(&total, pwst->windows[i]);
+		free(pwst->windows[i]);
+	}
+
+	if( out_format == EMIT_TEXT ){
+		fprintf(output, "\n");
+		print_ws_header("Pid");
+	}
+	for(node = rb_first(&pwst->pid_root); node != NULL; node = rb_next(node)){
+		pws = rb_entry(node, struct ws_sketch, link);
+		print_ws_sketch(pws, "pid");
+	}
+
+	if( out_format == EMIT_TEXT )
+		fprintf(output, "\n");
+	print_ws_sketch(&total, "total");
+	if( out_format == EMIT_TEXT )
+		fprintf(output, "\n");
+
+	__clear_ws_pid(pwst->pid_root.rb_node);
+	free(pwst->windows);
+	free(pwst);
 }
 
+//------------------- cache simulation ------------------------------//
+// completed reads and writes are replayed in the order of completion
+// through LRU and ARC caches of 4KB blocks. like SHARDS, only the blocks
+// in the sample of cache_rate are kept, and a cache of c blocks is
+// simulated as c * cache_rate blocks of the sample. LRU of all sizes
+// comes from the reuse distances in one pass, and ARC of each size is
+// a miniature simulation of the sample. the misses are divided by the
+// references expected in the sample rather than those in it (SHARDS_adj),
+// so a few hot blocks which fall in the sample or out of it don't skew
+// the whole curve.
+
+void* init_cache_statistic(){
+	return calloc(1, sizeof(struct cache_stat));
+}
+
+static bool add_cache_ref(struct cache_stat* pcs, uint64_t time, uint64_t block, uint8_t is_read){
+	struct cache_ref* newrefs = NULL;
+
+	if( pcs->cnt == pcs->max ){
+		pcs->max = pcs->max ? pcs->max * 2 : 4096;
+		newrefs = (struct cache_ref*)realloc(pcs->refs, sizeof(struct cache_ref) * pcs->max);
+		if( newrefs == NULL )
+			return false;
+		pcs->refs = newrefs;
+	}
+	pcs->refs[pcs->cnt].time = time;
+	pcs->refs[pcs->cnt].block = block;
+	pcs->refs[pcs->cnt].is_read = is_read;
+	pcs->cnt++;
+	return true;
+}
 
-//------------------- section statistics (for example)------------------------------//
-#define MAX_MON_SECTION 10
-static char mon_section[MAX_MON_SECTION][2];
-static uint64_t mon_sec_time[MAX_MON_SECTION];
-static int mon_sec_cnt[MAX_MON_SECTION];
-static int mon_cnt = 0;
+void travel_cache_statistic(void* part, struct dio_nugget* pdng){
+	struct cache_stat* pcs = (struct cache_stat*)part;
+	uint64_t blk = 0, end = 0, key = 0;
+	uint8_t is_read = 0;
+	int cidx = 0;
 
-void add_monitored_section(char section[2]){
-	if( mon_cnt+1 >= MAX_MON_SECTION )
+	//completed nuggets only
+	for(cidx=0; cidx<pdng->elemidx && cidx<MAX_ELEMENT_SIZE; cidx++){
+		if( pdng->states[cidx] == 'C' )
+			break;
+	}
+	if( cidx == pdng->elemidx || cidx == MAX_ELEMENT_SIZE || pdng->size <= 0 )
 		return;
-	
-	memcpy(mon_section[mon_cnt], section, 2);
-	mon_cnt++;
+	if( pdng->category & BLK_TC_READ )
+		is_read = 1;
+	else if( !(pdng->category & BLK_TC_WRITE) )
+		return;
+
+	end = (pdng->sector * 512 + pdng->size + CACHE_BLOCK_SIZE - 1) / CACHE_BLOCK_SIZE;
+	for(blk = pdng->sector * 512 / CACHE_BLOCK_SIZE; blk < end; blk++){
+		key = dev_index_key(pdng->device, blk);
+		pcs->all_cnt++;
+		pcs->all_reads += is_read;
+		if( shards_sampled(key, cache_rate) && !add_cache_ref(pcs, pdng->times[cidx], key, is_read) )
+			return;
+	}
 }
 
-int find_section(char* states, int mon_sec_num){
-	if( mon_sec_num >= mon_cnt )
-		return -1;
+void merge_cache_statistic(void* dst, void* src){
+	struct cache_stat* pdst = (struct cache_stat*)dst;
+	struct cache_stat* psrc = (struct cache_stat*)src;
+	size_t i = 0;
 
-	int i=0;
-	for(; i<MAX_ELEMENT_SIZE-1; i++){
-		if( states[i] == 0 )
+	pdst->all_cnt += psrc->all_cnt;
+	pdst->all_reads += psrc->all_reads;
+	for(i=0; i<psrc->cnt; i++){
+		if( !add_cache_ref(pdst, psrc->refs[i].time, psrc->refs[i].block, psrc->refs[i].is_read) )
 			break;
-		if( states[i] == mon_section[mon_sec_num][0] &&
-			states[i+1] == mon_section[mon_sec_num][1] )
-			return i;
 	}
-	return -1;
+	free(psrc->refs);
+	free(psrc);
 }
-			
-void init_section_statistic(){
-	memset(mon_section, 0, sizeof(char)*MAX_MON_SECTION*2);
-	memset(mon_sec_time, 0, sizeof(uint64_t)*MAX_MON_SECTION);
-	memset(mon_sec_cnt, 0, sizeof(mon_sec_cnt));
-	mon_cnt = 0;
+
+// in the order of completion. the blocks of a request are in order
+static int cmp_cache_ref(const void* a, const void* b){
+	const struct cache_ref* pa = (const struct cache_ref*)a;
+	const struct cache_ref* pb = (const struct cache_ref*)b;
+
+	if( pa->time != pb->time )
+		return pa->time < pb->time ? -1 : 1;
+	if( pa->block != pb->block )
+		return pa->block < pb->block ? -1 : 1;
+	return 0;
 }
 
-void travel_section_statistic(struct dio_nugget* pdng){
-	int i=0, pos=0;
-	for(; i<mon_cnt; i++){
-		pos = find_section(pdng->states, i);
-		if( i == -1 )
-			continue;
-		
-		mon_sec_time[i] += (pdng->times[pos+1] - pdng->times[pos]);
-		mon_sec_cnt[i] ++;
+#define CACHE_COL_CNT	5
+static const struct emit_col cache_cols[CACHE_COL_CNT] = {
+	{ "size_bytes", EMIT_U64 }, { "lru_miss", EMIT_F64 }, { "lru_read_miss", EMIT_F64 },
+	{ "arc_miss", EMIT_F64 }, { "arc_read_miss", EMIT_F64 }
+};
+
+void process_cache_statistic(void* part, int ng_cnt){
+	struct cache_stat* pcs = (struct cache_stat*)part;
+	struct cache_trace ct;
+	uint64_t* blocks = NULL;
+	uint8_t* reads = NULL;
+	uint64_t sizes[CACHE_MAX_SIZES], full[CACHE_MAX_SIZES];
+	uint64_t lru[CACHE_MAX_SIZES], lru_r[CACHE_MAX_SIZES];
+	uint64_t arc = 0, arc_r = 0, c = 0;
+	double miss[4], exp_refs = pcs->all_cnt * cache_rate, exp_reads = pcs->all_reads * cache_rate;
+	size_t i = 0;
+	int size_cnt = 0, j = 0;
+
+	memset(&ct, 0, sizeof(ct));
+	qsort(pcs->refs, pcs->cnt, sizeof(struct cache_ref), cmp_cache_ref);
+	blocks = (uint64_t*)malloc(sizeof(uint64_t) * (pcs->cnt + 1));
+	reads = (uint8_t*)malloc(pcs->cnt + 1);
+	if( blocks == NULL || reads == NULL ){
+		perror("failed to simulate cache");
+		goto out;
+	}
+	for(i=0; i<pcs->cnt; i++){
+		blocks[i] = pcs->refs[i].block;
+		reads[i] = pcs->refs[i].is_read;
+	}
+	if( !cache_trace_init(&ct, blocks, reads, pcs->cnt) ){
+		perror("failed to simulate cache");
+		goto out;
 	}
-}
 
-void process_section_statistic(int ng_cnt){
-	int i=0;
-	for(; i<mon_cnt; i++){
-		//calculate the average spending time for each section
-		mon_sec_time[i] /= mon_sec_cnt[i];
+	//caches from 1MB doubled up to the one which holds all the blocks.
+	//the sample must have at least a block for the smallest one
+	c = CACHE_MIN_SIZE;
+	while( c * cache_rate < 1 )
+		c *= 2;
+	for(; size_cnt < CACHE_MAX_SIZES; c *= 2){
+		full[size_cnt] = c;
+		sizes[size_cnt++] = (uint64_t)(c * cache_rate + 0.5);
+		if( c * cache_rate >= ct.block_cnt )
+			break;
+	}
+	if( !cache_lru_misses(&ct, sizes, size_cnt, lru, lru_r) ){
+		perror("failed to simulate cache");
+		goto out;
+	}
 
-		//print data
+	if( out_format != EMIT_TEXT )
+		emit_table(&emitter, "cache", cache_cols, CACHE_COL_CNT);
+	else{
+		fprintf(output, "Miss ratio of caches of %d byte blocks (%.2f%% of blocks sampled, %llu of %llu references)\n",
+			CACHE_BLOCK_SIZE, cache_rate * 100, (unsigned long long)pcs->cnt, (unsigned long long)pcs->all_cnt);
+		fprintf(output, "%12s %9s %9s %9s %9s\n", "Size", "LRU", "LRU_R", "ARC", "ARC_R");
 	}
+	for(j=0; j<size_cnt && ct.cnt > 0; j++){
+		if( !cache_arc_misses(&ct, sizes[j], &arc, &arc_r) ){
+			perror("failed to simulate cache");
+			break;
+		}
+		miss[0] = lru[j] / exp_refs;
+		miss[1] = exp_reads > 0 ? lru_r[j] / exp_reads : 0;
+		miss[2] = arc / exp_refs;
+		miss[3] = exp_reads > 0 ? arc_r / exp_reads : 0;
+		for(i=0; i<4; i++){
+			if( miss[i] > 1 )
+				miss[i] = 1;
+		}
 
-	//clear data
+		if( out_format != EMIT_TEXT ){
+			emit_row(&emitter);
+			emit_u64(&emitter, full[j] * CACHE_BLOCK_SIZE);
+			for(i=0; i<4; i++)
+				emit_f64(&emitter, miss[i]);
+			emit_row_end(&emitter);
+			continue;
+		}
+		fprintf(output, "%10lluMB %8.2f%% %8.2f%% %8.2f%% %8.2f%%\n",
+			(unsigned long long)(full[j] * CACHE_BLOCK_SIZE / (1024 * 1024)),
+			miss[0] * 100, miss[1] * 100, miss[2] * 100, miss[3] * 100);
+	}
+	if( out_format == EMIT_TEXT )
+		fprintf(output, "\n");
+
+out:
+	cache_trace_free(&ct);
+	free(blocks);
+	free(reads);
+	free(pcs->refs);
+	free(pcs);
 }
 
 //------------------- cpu statistics ------------------------------//
 
 #define INIT_NUM_CPU 4
-FILE* fCpuData = NULL;
-struct dio_cpu *diocpu;
-int maxCPU = 0;
 
-void create_diocpu(void)
+void create_diocpu(struct cpu_stat* pcs)
 {
-	int i;
-
 	// Create diocpu
-	if(diocpu == NULL)
+	if(pcs->diocpu == NULL)
 	{
-		diocpu = (struct dio_cpu*)malloc(sizeof(struct dio_cpu) * INIT_NUM_CPU);
+		pcs->diocpu = (struct dio_cpu*)malloc(sizeof(struct dio_cpu) * INIT_NUM_CPU);
 	}
 	else
 	{
-		diocpu = (struct dio_cpu*)realloc(diocpu, sizeof(struct dio_cpu) * (maxCPU + INIT_NUM_CPU));
+		pcs->diocpu = (struct dio_cpu*)realloc(pcs->diocpu, sizeof(struct dio_cpu) * (pcs->maxCPU + INIT_NUM_CPU));
 	}
 
 	// Init members
-	memset(diocpu + maxCPU, 0, sizeof(struct dio_cpu) * INIT_NUM_CPU);
-	maxCPU += INIT_NUM_CPU;
+	memset(pcs->diocpu + pcs->maxCPU, 0, sizeof(struct dio_cpu) * INIT_NUM_CPU);
+	pcs->maxCPU += INIT_NUM_CPU;
 }
 
-void init_cpu_statistic(void)
+void* init_cpu_statistic(void)
 {
-	if(is_graphic)
+	struct cpu_stat* pcs = (struct cpu_stat*)calloc(1, sizeof(struct cpu_stat));
+	if(pcs == NULL)
 	{
-		fCpuData = fopen("dioparse.cpu.dat", "wt");
-		if(!fCpuData)
-		{
-			DBGOUT("dioparse.cpu.dat open error \n");
-		}
+		return NULL;
 	}
 
-	create_diocpu();
+	create_diocpu(pcs);
+	return pcs;
 }
 
-void itr_cpu_statistic(struct blk_io_trace* pbit)
+void itr_cpu_statistic(void* part, struct blk_io_trace* pbit)
 {
+	struct cpu_stat* pcs = (struct cpu_stat*)part;
 	uint32_t category = pbit->action >> BLK_TC_SHIFT;
 
 	// Is enough diocpu?
@@ -1559,66 +5723,142 @@ void itr_cpu_statistic(struct blk_io_trace* pbit)
 		return ;
 	}
 
-	while(maxCPU <= pbit->cpu)
+	while(pcs->maxCPU <= pbit->cpu)
 	{
-		create_diocpu();
+		create_diocpu(pcs);
 	}
 	if(category & BLK_TC_READ)
 	{
-		diocpu[pbit->cpu].r_cnt++;
+		pcs->diocpu[pbit->cpu].r_cnt++;
 	}
 	else if(category & BLK_TC_WRITE)
 	{
-		diocpu[pbit->cpu].w_cnt++;
+		pcs->diocpu[pbit->cpu].w_cnt++;
 	}
 }
 
-void process_cpu_statistic(int bit_cnt)
+void merge_cpu_statistic(void* dst, void* src)
 {
-	if(is_graphic)
+	struct cpu_stat* pdst = (struct cpu_stat*)dst;
+	struct cpu_stat* psrc = (struct cpu_stat*)src;
+	int i;
+
+	while(pdst->maxCPU < psrc->maxCPU)
+	{
+		create_diocpu(pdst);
+	}
+	for(i=0 ; i<psrc->maxCPU ; i++)
+	{
+		pdst->diocpu[i].r_cnt += psrc->diocpu[i].r_cnt;
+		pdst->diocpu[i].w_cnt += psrc->diocpu[i].w_cnt;
+	}
+
+	free(psrc->diocpu);
+	free(psrc);
+}
+
+void process_cpu_statistic(void* part, int bit_cnt)
+{
+	struct cpu_stat* pcs = (struct cpu_stat*)part;
+
+	if(out_format != EMIT_TEXT)
+	{
+		emit_cpu_statistic(pcs, bit_cnt);
+	}
+	else if(is_graphic)
 	{
-		print_cpu_statistic_graphic();
+		chart_cpu_statistic(pcs);
 	}
 	else
 	{
-		print_cpu_statistic_text(bit_cnt);
+		print_cpu_statistic_text(pcs, bit_cnt);
 	}
 
 	//clear data
-	free(diocpu);
-	if(fCpuData != NULL)
+	free(pcs->diocpu);
+	free(pcs);
+}
+
+static const struct emit_col cpu_cols[] = {
+	{ "cpu", EMIT_U64 }, { "rw", EMIT_STR }, { "count", EMIT_U64 }, { "percent", EMIT_F64 }
+};
+
+void emit_cpu_statistic(struct cpu_stat* pcs, int bit_cnt)
+{
+	int i;
+
+	emit_table(&emitter, "cpu", cpu_cols, 4);
+	for(i=0 ; i<pcs->maxCPU ; i++)
 	{
-		fclose(fCpuData);
-		system("gnuplot cpu.cmd -p");
+		emit_row(&emitter);
+		emit_u64(&emitter, i);
+		emit_str(&emitter, "R");
+		emit_u64(&emitter, pcs->diocpu[i].r_cnt);
+		emit_f64(&emitter, pcs->diocpu[i].r_cnt/(double)bit_cnt*100);
+		emit_row_end(&emitter);
+
+		emit_row(&emitter);
+		emit_u64(&emitter, i);
+		emit_str(&emitter, "W");
+		emit_u64(&emitter, pcs->diocpu[i].w_cnt);
+		emit_f64(&emitter, pcs->diocpu[i].w_cnt/(double)bit_cnt*100);
+		emit_row_end(&emitter);
 	}
 }
 
-void print_cpu_statistic_graphic(void)
+void chart_cpu_statistic(struct cpu_stat* pcs)
 {
+	struct chart_series series[2];
+	const char** labels = NULL;
+	char (*cpus)[12] = NULL;
+	double* counts = NULL;
+	char path[MAX_FILEPATH_LEN];
 	int i;
 
-	fprintf(fCpuData, "%s %s %s\n", "cpu", "read", "write");
-	for(i=0 ; i<maxCPU ; i++)
+	labels = (const char**)malloc(sizeof(char*) * (pcs->maxCPU + 1));
+	cpus = (char (*)[12])malloc(sizeof(*cpus) * (pcs->maxCPU + 1));
+	counts = (double*)malloc(sizeof(double) * (pcs->maxCPU + 1) * 2);
+	if(labels == NULL || cpus == NULL || counts == NULL)
+	{
+		perror("failed to allocate memory");
+		goto out;
+	}
+
+	for(i=0 ; i<pcs->maxCPU ; i++)
+	{
+		snprintf(cpus[i], sizeof(cpus[i]), "%d", i);
+		labels[i] = cpus[i];
+		counts[i] = pcs->diocpu[i].r_cnt;
+		counts[pcs->maxCPU + i] = pcs->diocpu[i].w_cnt;
+	}
+
+	set_rw_series(series, counts, counts + pcs->maxCPU);
+	chart_file(path, "cpu");
+	if(!chart_bars(path, "I/O statistics per cpu", "CPU", "No. of I/O", labels, pcs->maxCPU, series, 2))
 	{
-		fprintf(fCpuData, "%d %d %d\n", i, diocpu[i].r_cnt, diocpu[i].w_cnt);
+		perror("failed to write chart");
 	}
+out:
+	free(labels);
+	free(cpus);
+	free(counts);
 }
 
-void print_cpu_statistic_text(int bit_cnt)
+void print_cpu_statistic_text(struct cpu_stat* pcs, int bit_cnt)
 {
 	int i, tot;
 	fprintf(output,"%4s %7s %8s %8s\n", "CPU", "Type", "COUNT", "RATE");
 
-	for(i=0 ; i<maxCPU ; i++)
+	for(i=0 ; i<pcs->maxCPU ; i++)
 	{
 		fprintf(output,"%4d %7s %8d %8f\n",
-			i, "R", diocpu[i].r_cnt, diocpu[i].r_cnt/(double)bit_cnt*100);
+			i, "R", pcs->diocpu[i].r_cnt, pcs->diocpu[i].r_cnt/(double)bit_cnt*100);
 		fprintf(output,"%4s %7s %8d %8f\n",
-			" ","W",diocpu[i].w_cnt, diocpu[i].w_cnt/(double)bit_cnt*100);
+			" ","W",pcs->diocpu[i].w_cnt, pcs->diocpu[i].w_cnt/(double)bit_cnt*100);
 		//fprintf(output,"%4s %7s %8d %8f\n",
 			//" ","unknown",diocpu[i].x_cnt, diocpu[i].x_cnt/(double)bit_cnt*100);
 
-		tot = diocpu[i].r_cnt + diocpu[i].w_cnt;
+		tot = pcs->diocpu[i].r_cnt + pcs->diocpu[i].w_cnt;
 		fprintf(output,"%4s %7s %8d %8f\n",
 			" ","Total :",tot, tot/(double)bit_cnt*100);
 		fprintf(output,"\n");
@@ -1626,131 +5866,123 @@ void print_cpu_statistic_text(int bit_cnt)
 
 }
 
-#if 0	// Replace other source
-//------------------- cpu statistics ------------------------------//
-
-#define INIT_NUM_CPU 4
-struct dio_cpu *diocpu;
-int maxCPU = 0;
-
-void create_diocpu(void)
+//------------------- cpu latency statistics ------------------------------//
+void* init_cpu_latency_statistic(void)
 {
-	int i;
-
-	// Create diocpu
-	if(diocpu == NULL)
-	{
-		diocpu = (struct dio_cpu*)malloc(sizeof(struct dio_cpu) * INIT_NUM_CPU);
-	}
-	else
-	{
-		diocpu = (struct dio_cpu*)realloc(diocpu, sizeof(struct dio_cpu) * (maxCPU + INIT_NUM_CPU));
-	}
-
-	// Init members
-	memset(diocpu + maxCPU, 0, sizeof(struct dio_cpu) * INIT_NUM_CPU);
-	for(i=0 ; i<INIT_NUM_CPU ; i++)
-	{
-		diocpu[maxCPU + i].data_time_read.min_time = -1;
-		diocpu[maxCPU + i].data_time_write.min_time = -1;
-	}
-	maxCPU += INIT_NUM_CPU;
+	return calloc(1, sizeof(struct cpu_lat_stat));
 }
 
-void init_cpu_statistic(void)
+static struct dio_hist* get_cpu_hist(struct dio_hist** phists, int cpu)
 {
-	create_diocpu();
+	if(phists[cpu] == NULL)
+	{
+		phists[cpu] = (struct dio_hist*)malloc(sizeof(struct dio_hist));
+		if(phists[cpu] == NULL)
+		{
+			return NULL;
+		}
+		hist_init(phists[cpu]);
+	}
+	return phists[cpu];
 }
 
-void travel_cpu_statistic(struct dio_nugget* pdng)
+void travel_cpu_latency_statistic(void* part, struct dio_nugget* pdng)
 {
-	unsigned int nugget_time;
-	struct data_time *pdata_time;
+	struct cpu_lat_stat* pcls = (struct cpu_lat_stat*)part;
+	struct dio_hist* phist = NULL;
 
-	// Is enough diocpu?
-	while(maxCPU < pdng->idxCPU)
+	if(pdng->idxCPU < 0 || pdng->idxCPU >= MAX_CPU_NUM)
 	{
-		create_diocpu();
+		return ;
 	}
-	
+
 	// Distribute read/write data and point that.
 	if(pdng->category & BLK_TC_READ)
 	{
-		pdata_time = &diocpu[pdng->idxCPU].data_time_read;
+		phist = get_cpu_hist(pcls->hist_read, pdng->idxCPU);
 	}
 	else if(pdng->category & BLK_TC_WRITE)
 	{
-		pdata_time = &diocpu[pdng->idxCPU].data_time_write;
-	}
-	else
-	{
-		return ;
-	}
-	
-	// Process datas.
-	nugget_time = pdng->times[pdng->elemidx] - pdng->times[0];
-	pdata_time->count++;
-	pdata_time->total_time += nugget_time;
-	if(pdata_time->max_time < nugget_time)
-	{
-		pdata_time->max_time = nugget_time; 
+		phist = get_cpu_hist(pcls->hist_write, pdng->idxCPU);
 	}
-	if(pdata_time->min_time > nugget_time)
+
+	if(phist != NULL)
 	{
-		pdata_time->min_time = nugget_time; 
+		hist_add(phist, pdng->times[pdng->elemidx-1] - pdng->times[0]);
 	}
 }
 
-void process_cpu_statistic(int ng_cnt)
+void merge_cpu_latency_statistic(void* dst, void* src)
 {
+	struct cpu_lat_stat* pdst = (struct cpu_lat_stat*)dst;
+	struct cpu_lat_stat* psrc = (struct cpu_lat_stat*)src;
+	struct dio_hist* phist = NULL;
 	int i;
 
-	// Calculate average time.
-	for(i=0 ; i<maxCPU ; i++)
+	for(i=0 ; i<MAX_CPU_NUM ; i++)
 	{
-		if(diocpu[i].data_time_read.count != 0)
-		{
-			diocpu[i].data_time_read.average_time = diocpu[i].data_time_read.total_time / diocpu[i].data_time_read.count;
-		}
-		if(diocpu[i].data_time_write.count != 0)
+		if(psrc->hist_read[i] != NULL && (phist = get_cpu_hist(pdst->hist_read, i)) != NULL)
 		{
-			diocpu[i].data_time_write.average_time = diocpu[i].data_time_write.total_time / diocpu[i].data_time_write.count;
+			hist_merge(phist, psrc->hist_read[i]);
 		}
-		// if min_time is -1 that initializing value for calculating min_time, change that to 0.
-		if(diocpu[i].data_time_read.min_time == -1)
+		if(psrc->hist_write[i] != NULL && (phist = get_cpu_hist(pdst->hist_write, i)) != NULL)
 		{
-			diocpu[i].data_time_read.min_time = 0;
-		}
-		if(diocpu[i].data_time_write.min_time == -1)
-		{
-			diocpu[i].data_time_write.min_time = 0;
+			hist_merge(phist, psrc->hist_write[i]);
 		}
+		free(psrc->hist_read[i]);
+		free(psrc->hist_write[i]);
 	}
+	free(psrc);
 }
 
-void print_cpu_statistic(void)
+#define CPU_LATENCY_COL_CNT	10
+static const struct emit_col cpu_latency_cols[CPU_LATENCY_COL_CNT] = {
+	{ "cpu", EMIT_U64 }, { "rw", EMIT_STR }, EMIT_HIST_COLS
+};
+
+void process_cpu_latency_statistic(void* part, int ng_cnt)
 {
+	struct cpu_lat_stat* pcls = (struct cpu_lat_stat*)part;
+	struct dio_hist empty;
 	int i;
 
-	printf("%4s %6s %6s %12s %12s %12s \n", "CPU", "Type", "No", "AverageTime", "MaxTime", "MinTime");
-	for(i=0 ; i<maxCPU ; i++)
-	{
-		fprintf(output, "%4d %6s %6d %2llu.%.9llu %2llu.%.9llu %2llu.%.9llu \n", i, "Read", diocpu[i].data_time_read.count,
-			SECONDS(diocpu[i].data_time_read.average_time), NANO_SECONDS(diocpu[i].data_time_read.average_time),
-			SECONDS(diocpu[i].data_time_read.max_time), NANO_SECONDS(diocpu[i].data_time_read.max_time),
-			SECONDS(diocpu[i].data_time_read.min_time), NANO_SECONDS(diocpu[i].data_time_read.min_time)
-		);
-		fprintf(output, "%4s %6s %6d %2llu.%.9llu %2llu.%.9llu %2llu.%.9llu \n", " ", "Write", diocpu[i].data_time_write.count,
-			SECONDS(diocpu[i].data_time_write.average_time), NANO_SECONDS(diocpu[i].data_time_write.average_time),
-			SECONDS(diocpu[i].data_time_write.max_time), NANO_SECONDS(diocpu[i].data_time_write.max_time),
-			SECONDS(diocpu[i].data_time_write.min_time), NANO_SECONDS(diocpu[i].data_time_write.min_time)
-		);
-		fprintf(output, "\n");
+	hist_init(&empty);
+	if(out_format != EMIT_TEXT)
+	{
+		emit_table(&emitter, "cpu_latency", cpu_latency_cols, CPU_LATENCY_COL_CNT);
+	}
+	else if(!is_graphic)
+	{
+		fprintf(output, "%4s %6s ", "CPU", "Type");
+		print_hist_header(output);
 	}
-}
 
-void clear_cpu_statistic(void)
-{
-	free(diocpu);
+	for(i=0 ; i<MAX_CPU_NUM ; i++)
+	{
+		if(out_format != EMIT_TEXT && (pcls->hist_read[i] != NULL || pcls->hist_write[i] != NULL))
+		{
+			emit_row(&emitter);
+			emit_u64(&emitter, i);
+			emit_str(&emitter, "R");
+			emit_hist(pcls->hist_read[i] ? pcls->hist_read[i] : &empty);
+			emit_row_end(&emitter);
+			emit_row(&emitter);
+			emit_u64(&emitter, i);
+			emit_str(&emitter, "W");
+			emit_hist(pcls->hist_write[i] ? pcls->hist_write[i] : &empty);
+			emit_row_end(&emitter);
+		}
+		else if(!is_graphic && (pcls->hist_read[i] != NULL || pcls->hist_write[i] != NULL))
+		{
+			fprintf(output, "%4d %6s ", i, "Read");
+			print_hist_statistic(output, pcls->hist_read[i] ? pcls->hist_read[i] : &empty);
+			fprintf(output, "\n");
+			fprintf(output, "%4s %6s ", " ", "Write");
+			print_hist_statistic(output, pcls->hist_write[i] ? pcls->hist_write[i] : &empty);
+			fprintf(output, "\n\n");
+		}
+		free(pcls->hist_read[i]);
+		free(pcls->hist_write[i]);
+	}
+	free(pcls);
 }
-#endif
@@ -0,0 +1,216 @@
+/*
+	dio_pyramid.c
+	multi-resolution timeline of a trace for zooming
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dio_pyramid.h"
+
+#define PYR_HEADER_SIZE	32
+#define PYR_LEVEL_SIZE	24
+
+static unsigned char* put_le(unsigned char* p, uint64_t v, int len){
+	int i = 0;
+
+	for(i=0; i<len; i++)
+		p[i] = (unsigned char)(v >> (i * 8));
+	return p + len;
+}
+
+static void encode_bucket(unsigned char* p, const struct pyr_bucket* pbkt){
+	uint64_t depth = 0;
+
+	memcpy(&depth, &pbkt->depth, sizeof(depth));
+	p = put_le(p, pbkt->r_bytes, 8);
+	p = put_le(p, pbkt->w_bytes, 8);
+	p = put_le(p, pbkt->avg_lat, 8);
+	p = put_le(p, pbkt->p50_lat, 8);
+	p = put_le(p, pbkt->p99_lat, 8);
+	p = put_le(p, pbkt->max_lat, 8);
+	p = put_le(p, pbkt->r_cnt, 4);
+	p = put_le(p, pbkt->w_cnt, 4);
+	put_le(p, depth, 8);
+}
+
+bool pyramid_write(const char* path, uint64_t base, uint64_t end, const struct pyr_level* levels, int level_cnt){
+	unsigned char buf[PYR_BUCKET_SIZE * 64];
+	unsigned char* p = buf;
+	uint64_t off = PYR_HEADER_SIZE + PYR_LEVEL_SIZE * level_cnt;
+	size_t i = 0, n = 0;
+	FILE* fp = NULL;
+	bool ok = true;
+	int l = 0;
+
+	fp = fopen(path, "wb");
+	if( fp == NULL )
+		return false;
+
+	memcpy(p, DIO_PYRAMID_MAGIC, 8);
+	p = put_le(p + 8, level_cnt, 4);
+	p = put_le(p, PYR_TILE_BUCKETS, 4);
+	p = put_le(p, base, 8);
+	p = put_le(p, end, 8);
+	fwrite(buf, 1, p - buf, fp);
+
+	for(l=0; l<level_cnt; l++){
+		p = put_le(buf, levels[l].width, 8);
+		p = put_le(p, levels[l].cnt, 8);
+		p = put_le(p, off, 8);
+		fwrite(buf, 1, p - buf, fp);
+		off += (uint64_t)levels[l].cnt * PYR_BUCKET_SIZE;
+	}
+
+	//buckets are encoded in batches of the buffer
+	for(l=0; l<level_cnt; l++){
+		for(i=0; i<levels[l].cnt; i+=n){
+			for(n=0; n < sizeof(buf) / PYR_BUCKET_SIZE && i + n < levels[l].cnt; n++)
+				encode_bucket(buf + n * PYR_BUCKET_SIZE, &levels[l].bkts[i + n]);
+			fwrite(buf, PYR_BUCKET_SIZE, n, fp);
+		}
+	}
+
+	if( ferror(fp) )
+		ok = false;
+	if( fclose(fp) != 0 )
+		ok = false;
+	return ok;
+}
+
+// the viewer reads the header and the levels first, then for each view
+// it picks the level which has no more buckets than pixels and reads
+// only the tiles in the view with Blob.slice or http Range requests
+static const char* viewer_html[] = {
+	"<!DOCTYPE html>",
+	"<html><head><meta charset='utf-8'><title>dioparse timeline</title>",
+	"<style>",
+	"body{font-family:sans-serif;font-size:13px;margin:12px}",
+	"canvas{border:1px solid #999;display:block;margin-top:8px;cursor:grab}",
+	"</style></head><body>",
+	"<input type='file' id='file'> <span id='info'>Open a pyramid file, or give it as ?src=&lt;url&gt;</span>",
+	"<div>Drag to pan, wheel to zoom, double click to reset.</div>",
+	"<div id='charts'></div>",
+	"<script>",
+	"'use strict';",
+	"var W=1200,H=180,PAD=60,BSIZE=64;",
+	"var charts=[",
+	" {name:'IOPS',lines:[['read','darkblue',function(b,s){return b.rc/s;}],['write','forestgreen',function(b,s){return b.wc/s;}]]},",
+	" {name:'MB/s',lines:[['read','darkblue',function(b,s){return b.rb/s/1048576;}],['write','forestgreen',function(b,s){return b.wb/s/1048576;}]]},",
+	" {name:'Latency (ms)',lines:[['p50','darkblue',function(b){return b.p50/1e6;}],['p99','firebrick',function(b){return b.p99/1e6;}],['max','orange',function(b){return b.max/1e6;}]]},",
+	" {name:'Depth',lines:[['depth','purple',function(b){return b.depth;}]]}",
+	"];",
+	"var src=null,levels=[],base=0,end=0,tile=1024,cache=new Map(),view=null,drag=null;",
+	"charts.forEach(function(c){",
+	" c.cv=document.createElement('canvas');c.cv.width=W;c.cv.height=H;",
+	" document.getElementById('charts').appendChild(c.cv);",
+	" c.cv.addEventListener('wheel',wheel);c.cv.addEventListener('mousedown',down);",
+	" c.cv.addEventListener('dblclick',function(){reset();draw();});",
+	"});",
+	"window.addEventListener('mousemove',move);window.addEventListener('mouseup',function(){drag=null;});",
+	"function u64(dv,o){return dv.getUint32(o,true)+dv.getUint32(o+4,true)*4294967296;}",
+	"function openBlob(b){src=function(o,l){return b.slice(o,o+l).arrayBuffer();};load();}",
+	"function openUrl(u){src=function(o,l){",
+	" return fetch(u,{headers:{Range:'bytes='+o+'-'+(o+l-1)}}).then(function(r){",
+	"  return r.arrayBuffer().then(function(a){return r.status==206?a:a.slice(o,o+l);});});};load();}",
+	"function load(){",
+	" cache.clear();",
+	" src(0,32).then(function(a){",
+	"  var dv=new DataView(a),m=new TextDecoder().decode(new Uint8Array(a,0,8));",
+	"  if(m!='DIOPYR01'){document.getElementById('info').textContent='not a pyramid file';return;}",
+	"  var n=dv.getUint32(8,true);tile=dv.getUint32(12,true);base=u64(dv,16);end=u64(dv,24);",
+	"  return src(32,24*n).then(function(a){",
+	"   var dv=new DataView(a);levels=[];",
+	"   for(var i=0;i<n;i++)levels.push({w:u64(dv,i*24),cnt:u64(dv,i*24+8),off:u64(dv,i*24+16)});",
+	"   reset();draw();});",
+	" });",
+	"}",
+	"function reset(){if(levels.length)view={s:base,e:base+levels[0].w*levels[0].cnt};}",
+	"function decode(a){",
+	" var dv=new DataView(a),r=[];",
+	" for(var o=0;o+BSIZE<=a.byteLength;o+=BSIZE)",
+	"  r.push({rb:u64(dv,o),wb:u64(dv,o+8),avg:u64(dv,o+16),p50:u64(dv,o+24),p99:u64(dv,o+32),max:u64(dv,o+40),",
+	"   rc:dv.getUint32(o+48,true),wc:dv.getUint32(o+52,true),depth:dv.getFloat64(o+56,true)});",
+	" return r;",
+	"}",
+	"function getTile(l,t){",
+	" var k=l+':'+t,lv=levels[l];",
+	" if(cache.has(k))return cache.get(k);",
+	" cache.set(k,null);",
+	" var n=Math.min(tile,lv.cnt-t*tile);",
+	" src(lv.off+t*tile*BSIZE,n*BSIZE).then(function(a){cache.set(k,decode(a));draw();});",
+	" return null;",
+	"}",
+	"function draw(){",
+	" if(!view)return;",
+	" var span=view.e-view.s,l=0;",
+	" while(l<levels.length-1&&span/levels[l].w>W-PAD)l++;",
+	" var lv=levels[l],i0=Math.max(0,Math.floor((view.s-base)/lv.w)),i1=Math.min(lv.cnt-1,Math.ceil((view.e-base)/lv.w));",
+	" var pts=[],loaded=0,tiles=0;",
+	" for(var t=Math.floor(i0/tile);t<=Math.floor(i1/tile);t++){",
+	"  var bk=getTile(l,t);tiles++;",
+	"  if(!bk)continue;",
+	"  loaded++;",
+	"  for(var j=0;j<bk.length;j++){var i=t*tile+j;if(i>=i0&&i<=i1)pts.push([base+i*lv.w,bk[j],span(base+i*lv.w,lv.w)]);}",
+	" }",
+	" document.getElementById('info').textContent='level '+fmtT(lv.w)+' buckets, '+loaded+'/'+tiles+' tiles, '+",
+	"  ((view.s-base)/1e9).toFixed(3)+'s - '+((view.e-base)/1e9).toFixed(3)+'s';",
+	" charts.forEach(function(c){plot(c,pts,lv.w);});",
+	"}",
+	"// the last bucket covers only up to the end of trace",
+	"function span(s,w){var e=Math.min(s+w,end);return (e>s?e-s:w)/1e9;}",
+	"function fmtT(ns){return ns>=1e9?ns/1e9+'s':ns>=1e6?ns/1e6+'ms':ns>=1e3?ns/1e3+'us':ns+'ns';}",
+	"function plot(c,pts,w){",
+	" var g=c.cv.getContext('2d'),span=view.e-view.s,max=0;",
+	" g.fillStyle='white';g.fillRect(0,0,W,H);",
+	" c.lines.forEach(function(ln){pts.forEach(function(p){max=Math.max(max,ln[2](p[1],p[2]));});});",
+	" if(max<=0)max=1;",
+	" g.strokeStyle='#ddd';g.fillStyle='black';g.font='11px sans-serif';",
+	" for(var k=0;k<=4;k++){var y=H-20-(H-40)*k/4;g.beginPath();g.moveTo(PAD,y);g.lineTo(W,y);g.stroke();",
+	"  g.fillText((max*k/4).toPrecision(3),4,y+4);}",
+	" for(var k=0;k<=5;k++){var x=PAD+(W-PAD)*k/5;g.fillText(((view.s+span*k/5-base)/1e9).toFixed(3)+'s',x-20,H-4);}",
+	" g.fillText(c.name,PAD+4,12);",
+	" c.lines.forEach(function(ln,n){",
+	"  g.strokeStyle=ln[1];g.fillStyle=ln[1];g.beginPath();",
+	"  pts.forEach(function(p,i){var x=PAD+(p[0]+w/2-view.s)/span*(W-PAD),y=H-20-(H-40)*ln[2](p[1],p[2])/max;",
+	"   if(i)g.lineTo(x,y);else g.moveTo(x,y);});",
+	"  g.stroke();g.fillText(ln[0],W-70,14+n*13);",
+	" });",
+	"}",
+	"function wheel(ev){",
+	" if(!view)return;ev.preventDefault();",
+	" var f=ev.deltaY>0?1.25:0.8,span=view.e-view.s,at=view.s+span*Math.max(0,ev.offsetX-PAD)/(W-PAD);",
+	" var ns=Math.max(levels[0].w*10,Math.min(span*f,levels[0].w*levels[0].cnt));",
+	" view.s=at-(at-view.s)*ns/span;view.e=view.s+ns;draw();",
+	"}",
+	"function down(ev){if(view)drag={x:ev.clientX,s:view.s,e:view.e};}",
+	"function move(ev){",
+	" if(!drag)return;",
+	" var d=(ev.clientX-drag.x)/(W-PAD)*(drag.e-drag.s);",
+	" view.s=drag.s-d;view.e=drag.e-d;draw();",
+	"}",
+	"document.getElementById('file').addEventListener('change',function(ev){if(ev.target.files.length)openBlob(ev.target.files[0]);});",
+	"var q=new URLSearchParams(location.search).get('src');",
+	"if(q)openUrl(q);",
+	"</script></body></html>",
+	NULL
+};
+
+bool pyramid_write_viewer(const char* path){
+	FILE* fp = NULL;
+	bool ok = true;
+	int i = 0;
+
+	fp = fopen(path, "w");
+	if( fp == NULL )
+		return false;
+
+	for(i=0; viewer_html[i] != NULL; i++)
+		fprintf(fp, "%s\n", viewer_html[i]);
+
+	if( ferror(fp) )
+		ok = false;
+	if( fclose(fp) != 0 )
+		ok = false;
+	return ok;
+}
@@ -0,0 +1,52 @@
+/*
+	dio_pyramid.h
+	multi-resolution timeline of a trace for zooming
+
+	The timeline is kept at levels of 1ms, 10ms, 100ms, 1s, ... up to
+	the level whose one bucket covers the whole trace, so a viewer reads
+	only about as many buckets as it has pixels at any zoom.
+	The file is little endian.
+	  header : "DIOPYR01", u32 level_cnt, u32 tile_buckets, u64 base (ns), u64 end (ns)
+	  levels : u64 width (ns), u64 bucket_cnt, u64 offset of buckets
+	  buckets: PYR_BUCKET_SIZE bytes each, in the fields order of pyr_bucket
+	Buckets of a level are read in tiles of tile_buckets buckets. The last
+	bucket of a level covers only up to the end of trace.
+*/
+
+#ifndef DIO_PYRAMID_H
+#define DIO_PYRAMID_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define DIO_PYRAMID_MAGIC	"DIOPYR01"
+#define DIO_PYRAMID_VIEWER	".html"		//suffix of the viewer of a pyramid file
+#define PYR_MAX_LEVEL		16
+#define PYR_TILE_BUCKETS	1024
+#define PYR_BUCKET_SIZE		64
+
+struct pyr_bucket{
+	uint64_t r_bytes;
+	uint64_t w_bytes;
+	uint64_t avg_lat;	//latencies in ns
+	uint64_t p50_lat;
+	uint64_t p99_lat;
+	uint64_t max_lat;
+	uint32_t r_cnt;
+	uint32_t w_cnt;
+	double depth;		//average number of requests in the device
+};
+
+struct pyr_level{
+	uint64_t width;
+	struct pyr_bucket* bkts;
+	size_t cnt;
+};
+
+bool pyramid_write(const char* path, uint64_t base, uint64_t end, const struct pyr_level* levels, int level_cnt);
+
+// write the standalone html viewer which opens a pyramid file
+bool pyramid_write_viewer(const char* path);
+
+#endif
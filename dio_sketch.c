@@ -0,0 +1,256 @@
+/*
+	dio_sketch.c
+	fixed size summaries of a stream of keys
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "dio_sketch.h"
+
+// rows of count-min use different seeds
+static inline uint32_t cms_col(uint64_t key, int row){
+	return (uint32_t)(sketch_hash(key + 0x9e3779b97f4a7c15ULL * (row + 1)) % CMS_WIDTH);
+}
+
+void cms_init(struct count_min* pcm){
+	memset(pcm, 0, sizeof(struct count_min));
+}
+
+void cms_add(struct count_min* pcm, uint64_t key, uint64_t weight){
+	int r = 0;
+
+	for(r=0; r<CMS_DEPTH; r++)
+		pcm->cells[r][cms_col(key, r)] += weight;
+	pcm->total += weight;
+}
+
+uint64_t cms_estimate(const struct count_min* pcm, uint64_t key){
+	uint64_t est = (uint64_t)(-1), v = 0;
+	int r = 0;
+
+	for(r=0; r<CMS_DEPTH; r++){
+		v = pcm->cells[r][cms_col(key, r)];
+		if( v < est )
+			est = v;
+	}
+	return est;
+}
+
+void cms_merge(struct count_min* pdst, const struct count_min* psrc){
+	int r = 0, c = 0;
+
+	for(r=0; r<CMS_DEPTH; r++){
+		for(c=0; c<CMS_WIDTH; c++)
+			pdst->cells[r][c] += psrc->cells[r][c];
+	}
+	pdst->total += psrc->total;
+}
+
+uint64_t cms_error(const struct count_min* pcm){
+	//e / CMS_WIDTH of the total, rounded up
+	return (uint64_t)(pcm->total * 2.718281828459045 / CMS_WIDTH) + 1;
+}
+
+//------------------- space saving ------------------------------//
+static inline int ss_home(uint64_t key){
+	return (int)(sketch_hash(key) % SS_SLOTS);
+}
+
+static int ss_find_slot(const struct space_saving* pss, uint64_t key){
+	int s = ss_home(key);
+
+	while( pss->slots[s] >= 0 && pss->ents[pss->slots[s]].key != key )
+		s = (s + 1) % SS_SLOTS;
+	return s;
+}
+
+// the slots after a removed one are shifted back, so there is no tombstone
+static void ss_remove_slot(struct space_saving* pss, int s){
+	int next = 0, home = 0;
+
+	pss->slots[s] = -1;
+	for(next = (s + 1) % SS_SLOTS; pss->slots[next] >= 0; next = (next + 1) % SS_SLOTS){
+		home = ss_home(pss->ents[pss->slots[next]].key);
+		//the entry at 'next' can move to 's' if 's' is on its probe path
+		if( (next > s && (home <= s || home > next)) || (next < s && home <= s && home > next) ){
+			pss->slots[s] = pss->slots[next];
+			pss->slots[next] = -1;
+			s = next;
+		}
+	}
+}
+
+static void ss_swap(struct space_saving* pss, int a, int b){
+	int tmp = pss->heap[a];
+
+	pss->heap[a] = pss->heap[b];
+	pss->heap[b] = tmp;
+	pss->ents[pss->heap[a]].pos = a;
+	pss->ents[pss->heap[b]].pos = b;
+}
+
+// counts only grow, so an entry only goes down the heap. a merge builds
+// the heap from the bottom with it too
+static void ss_sift_down(struct space_saving* pss, int i){
+	int child = 0;
+
+	while( (child = i * 2 + 1) < pss->cnt ){
+		if( child + 1 < pss->cnt && pss->ents[pss->heap[child + 1]].count < pss->ents[pss->heap[child]].count )
+			child++;
+		if( pss->ents[pss->heap[child]].count >= pss->ents[pss->heap[i]].count )
+			break;
+		ss_swap(pss, i, child);
+		i = child;
+	}
+}
+
+static void ss_sift_up(struct space_saving* pss, int i){
+	int parent = 0;
+
+	while( i > 0 ){
+		parent = (i - 1) / 2;
+		if( pss->ents[pss->heap[parent]].count <= pss->ents[pss->heap[i]].count )
+			break;
+		ss_swap(pss, i, parent);
+		i = parent;
+	}
+}
+
+void ss_init(struct space_saving* pss){
+	memset(pss->slots, 0xff, sizeof(pss->slots));
+	pss->cnt = 0;
+}
+
+void ss_add(struct space_saving* pss, uint64_t key, uint64_t weight){
+	struct ss_entry* pent = NULL;
+	int s = ss_find_slot(pss, key);
+	int e = 0;
+
+	if( pss->slots[s] >= 0 ){
+		pent = &pss->ents[pss->slots[s]];
+		pent->count += weight;
+		ss_sift_down(pss, pent->pos);
+		return;
+	}
+
+	if( pss->cnt < SS_CAPACITY ){
+		e = pss->cnt++;
+		pent = &pss->ents[e];
+		pent->key = key;
+		pent->count = weight;
+		pent->err = 0;
+		pent->pos = e;
+		pss->heap[e] = e;
+		pss->slots[s] = e;
+		ss_sift_up(pss, e);
+		return;
+	}
+
+	//the key takes the place of the smallest one
+	e = pss->heap[0];
+	pent = &pss->ents[e];
+	ss_remove_slot(pss, ss_find_slot(pss, pent->key));
+	pss->slots[ss_find_slot(pss, key)] = e;
+	pent->key = key;
+	pent->err = pent->count;
+	pent->count += weight;
+	ss_sift_down(pss, 0);
+}
+
+// larger counts first
+static int cmp_ss_count(const void* a, const void* b){
+	const struct ss_entry* pa = (const struct ss_entry*)a;
+	const struct ss_entry* pb = (const struct ss_entry*)b;
+
+	if( pa->count != pb->count )
+		return pa->count < pb->count ? 1 : -1;
+	return pa->key < pb->key ? -1 : (pa->key > pb->key);
+}
+
+// mergeable Space-Saving (Agarwal et al.). a key which is not monitored
+// by one summary may have up to its smallest count there, so that count
+// is added to both the count and the err of the key. the SS_CAPACITY
+// largest of the union are kept, and the truth of a key stays in
+// [count - err, count]
+void ss_merge(struct space_saving* pdst, const struct space_saving* psrc){
+	struct ss_entry ents[SS_CAPACITY * 2];
+	uint64_t dst_min = ss_min(pdst), src_min = ss_min(psrc);
+	int cnt = pdst->cnt, s = 0, i = 0;
+
+	for(i=0; i<pdst->cnt; i++){
+		ents[i] = pdst->ents[i];
+		ents[i].count += src_min;
+		ents[i].err += src_min;
+	}
+	for(i=0; i<psrc->cnt; i++){
+		s = ss_find_slot(pdst, psrc->ents[i].key);
+		if( pdst->slots[s] >= 0 ){
+			ents[pdst->slots[s]].count += psrc->ents[i].count - src_min;
+			ents[pdst->slots[s]].err += psrc->ents[i].err - src_min;
+			continue;
+		}
+		ents[cnt] = psrc->ents[i];
+		ents[cnt].count += dst_min;
+		ents[cnt].err += dst_min;
+		cnt++;
+	}
+	if( cnt > SS_CAPACITY ){
+		qsort(ents, cnt, sizeof(struct ss_entry), cmp_ss_count);
+		cnt = SS_CAPACITY;
+	}
+
+	//the heap and the slots are built again
+	ss_init(pdst);
+	for(i=0; i<cnt; i++){
+		pdst->ents[i] = ents[i];
+		pdst->ents[i].pos = i;
+		pdst->heap[i] = i;
+		pdst->slots[ss_find_slot(pdst, ents[i].key)] = i;
+	}
+	pdst->cnt = cnt;
+	for(i=cnt/2-1; i>=0; i--)
+		ss_sift_down(pdst, i);
+}
+
+//------------------- hyperloglog ------------------------------//
+void hll_init(struct hyperloglog* phll){
+	memset(phll->regs, 0, sizeof(phll->regs));
+}
+
+// the top HLL_BITS of the hash pick the register, and the rest give the rank
+void hll_add(struct hyperloglog* phll, uint64_t key){
+	uint64_t h = sketch_hash(key);
+	uint32_t idx = (uint32_t)(h >> (64 - HLL_BITS));
+	uint8_t rank = (uint8_t)(__builtin_clzll((h << HLL_BITS) | (1ULL << (HLL_BITS - 1))) + 1);
+
+	if( phll->regs[idx] < rank )
+		phll->regs[idx] = rank;
+}
+
+void hll_merge(struct hyperloglog* pdst, const struct hyperloglog* psrc){
+	int i = 0;
+
+	for(i=0; i<HLL_REGS; i++){
+		if( pdst->regs[i] < psrc->regs[i] )
+			pdst->regs[i] = psrc->regs[i];
+	}
+}
+
+double hll_count(const struct hyperloglog* phll){
+	double m = HLL_REGS, sum = 0, est = 0;
+	int i = 0, zeros = 0;
+
+	for(i=0; i<HLL_REGS; i++){
+		sum += ldexp(1.0, -phll->regs[i]);
+		if( phll->regs[i] == 0 )
+			zeros++;
+	}
+	est = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+
+	//small counts are better estimated by the empty registers
+	if( est <= 2.5 * m && zeros > 0 )
+		est = m * log(m / zeros);
+	return est;
+}
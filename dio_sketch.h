@@ -0,0 +1,89 @@
+/*
+	dio_sketch.h
+	fixed size summaries of a stream of keys
+
+	Count-min keeps CMS_DEPTH rows of CMS_WIDTH counters. A key adds its
+	weight to one counter of each row and its estimate is the smallest of
+	them, which is never under the truth and is over it by at most
+	e / CMS_WIDTH of the total weight with probability 1 - e^-CMS_DEPTH.
+	Space-Saving monitors SS_CAPACITY keys. A new key takes the place of
+	the key with the smallest count and inherits the count as its error,
+	so the truth of a key is in [count - err, count], and a key which is
+	not monitored has no more than the smallest count. Two of them are
+	merged by taking the smallest count of one for the keys it does not
+	monitor, and keeping the SS_CAPACITY largest of the union.
+	HyperLogLog estimates the number of distinct keys from the longest
+	run of leading zeros of the hashes in each of HLL_REGS registers,
+	with a standard error of 1.04 / sqrt(HLL_REGS).
+	All of them are merged, so each thread keeps its own.
+*/
+
+#ifndef DIO_SKETCH_H
+#define DIO_SKETCH_H
+
+#include <stdint.h>
+
+#define CMS_DEPTH	4
+#define CMS_WIDTH	4096
+#define CMS_CONFIDENCE	98.1	//percent, 1 - e^-CMS_DEPTH
+#define SS_CAPACITY	512
+#define SS_SLOTS	(SS_CAPACITY * 2)
+#define HLL_BITS	12
+#define HLL_REGS	(1 << HLL_BITS)
+
+struct count_min{
+	uint64_t total;
+	uint64_t cells[CMS_DEPTH][CMS_WIDTH];
+};
+
+struct ss_entry{
+	uint64_t key;
+	uint64_t count;
+	uint64_t err;
+	int pos;		//in the heap
+};
+
+struct space_saving{
+	struct ss_entry ents[SS_CAPACITY];
+	int heap[SS_CAPACITY];	//min-heap of the entries by count
+	int slots[SS_SLOTS];	//open addressing index of the keys to the entries, -1 for empty
+	int cnt;
+};
+
+struct hyperloglog{
+	uint8_t regs[HLL_REGS];
+};
+
+// splitmix64 finalizer
+static inline uint64_t sketch_hash(uint64_t x){
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+void cms_init(struct count_min* pcm);
+void cms_add(struct count_min* pcm, uint64_t key, uint64_t weight);
+uint64_t cms_estimate(const struct count_min* pcm, uint64_t key);
+void cms_merge(struct count_min* pdst, const struct count_min* psrc);
+
+// the most an estimate is over, with CMS_CONFIDENCE
+uint64_t cms_error(const struct count_min* pcm);
+
+void ss_init(struct space_saving* pss);
+void ss_add(struct space_saving* pss, uint64_t key, uint64_t weight);
+void ss_merge(struct space_saving* pdst, const struct space_saving* psrc);
+
+// the most a key which is not monitored can have
+static inline uint64_t ss_min(const struct space_saving* pss){
+	return pss->cnt < SS_CAPACITY ? 0 : pss->ents[pss->heap[0]].count;
+}
+
+void hll_init(struct hyperloglog* phll);
+void hll_add(struct hyperloglog* phll, uint64_t key);
+void hll_merge(struct hyperloglog* pdst, const struct hyperloglog* psrc);
+double hll_count(const struct hyperloglog* phll);
+
+#endif
@@ -0,0 +1,92 @@
+/*
+	histogram.c
+	log-linear histogram of 64bit values
+*/
+
+#include <string.h>
+
+#include "histogram.h"
+
+static inline int bucket_of(uint64_t value){
+	int msb = 0, shift = 0;
+
+	if( value < HIST_SUB_CNT )
+		return (int)value;
+
+	msb = 63 - __builtin_clzll(value);
+	if( msb >= HIST_MAX_BITS )
+		return HIST_BUCKETS - 1;
+
+	//(value >> shift) is in [HIST_SUB_CNT, 2*HIST_SUB_CNT)
+	shift = msb - HIST_SUB_BITS;
+	return shift * HIST_SUB_CNT + (int)(value >> shift);
+}
+
+// the highest value which goes in the bucket
+static inline uint64_t bucket_high(int idx){
+	int shift = 0;
+
+	if( idx < 2*HIST_SUB_CNT )
+		return (uint64_t)idx;
+
+	shift = idx / HIST_SUB_CNT - 1;
+	return (((uint64_t)(idx - shift * HIST_SUB_CNT)) << shift) + ((uint64_t)1 << shift) - 1;
+}
+
+void hist_init(struct dio_hist* phist){
+	memset(phist, 0, sizeof(struct dio_hist));
+	phist->min = (uint64_t)(-1);
+}
+
+void hist_add(struct dio_hist* phist, uint64_t value){
+	phist->buckets[bucket_of(value)]++;
+	phist->count++;
+	phist->total += value;
+	if( phist->min > value )
+		phist->min = value;
+	if( phist->max < value )
+		phist->max = value;
+}
+
+void hist_merge(struct dio_hist* pdst, const struct dio_hist* psrc){
+	int i = 0;
+
+	if( psrc->count == 0 )
+		return;
+
+	for(i=0; i<HIST_BUCKETS; i++)
+		pdst->buckets[i] += psrc->buckets[i];
+	pdst->count += psrc->count;
+	pdst->total += psrc->total;
+	if( pdst->min > psrc->min )
+		pdst->min = psrc->min;
+	if( pdst->max < psrc->max )
+		pdst->max = psrc->max;
+}
+
+uint64_t hist_percentile(const struct dio_hist* phist, double pct){
+	uint64_t rank = 0, sum = 0, value = 0;
+	int i = 0;
+
+	if( phist->count == 0 )
+		return 0;
+
+	rank = (uint64_t)(pct / 100.0 * phist->count + 0.5);
+	if( rank < 1 )
+		rank = 1;
+	if( rank >= phist->count )
+		return phist->max;
+
+	for(i=0; i<HIST_BUCKETS; i++){
+		sum += phist->buckets[i];
+		if( sum >= rank )
+			break;
+	}
+
+	value = bucket_high(i);
+	if( value > phist->max )
+		value = phist->max;
+	if( value < phist->min )
+		value = phist->min;
+	return value;
+}
@@ -0,0 +1,48 @@
+/*
+	histogram.h
+	log-linear histogram of 64bit values
+
+	Values are counted in buckets whose width grows with the value,
+	like HDR histogram. Each power of 2 range is cut in HIST_SUB_CNT
+	linear buckets, so a value read back from the histogram is off by
+	less than 1/HIST_SUB_CNT of itself. The memory is fixed and two
+	histograms are merged by adding their buckets.
+*/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+#define HIST_SUB_BITS	6
+#define HIST_SUB_CNT	(1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS	40	//values from 2^40 (about 18 minutes in ns) go in the last bucket
+#define HIST_BUCKETS	(HIST_SUB_CNT * (HIST_MAX_BITS - HIST_SUB_BITS + 1))
+
+struct dio_hist{
+	uint64_t count;
+	uint64_t total;
+	uint64_t min;
+	uint64_t max;
+	uint64_t buckets[HIST_BUCKETS];
+};
+
+void hist_init(struct dio_hist* phist);
+void hist_add(struct dio_hist* phist, uint64_t value);
+
+// add the counts of 'psrc' into 'pdst'
+void hist_merge(struct dio_hist* pdst, const struct dio_hist* psrc);
+
+// the value which 'pct' percent of the values are not bigger than.
+// it is the highest value of its bucket but never over the max
+uint64_t hist_percentile(const struct dio_hist* phist, double pct);
+
+static inline uint64_t hist_mean(const struct dio_hist* phist){
+	return phist->count ? phist->total / phist->count : 0;
+}
+
+static inline uint64_t hist_min(const struct dio_hist* phist){
+	return phist->count ? phist->min : 0;
+}
+
+#endif